@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+#include <atscppapi/AccessLog.h>
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/Logger.h>
+#include <atscppapi/PluginInit.h>
+
+using namespace atscppapi;
+
+/*
+ * This example writes a line to access_log_example.log for every transaction. The format is
+ * compiled once in TSPluginInit() and each line is built straight from the transaction's headers.
+ */
+
+namespace {
+Logger log;
+AccessLog access_log;
+}
+
+class AccessLogPlugin : public GlobalPlugin {
+public:
+  AccessLogPlugin() {
+    registerHook(HOOK_SEND_RESPONSE_HEADERS);
+  }
+
+  virtual void handleSendResponseHeaders(Transaction &transaction) {
+    access_log.log(transaction);
+    transaction.resume();
+  }
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  log.init("access_log_example");
+  if (access_log.init("%{chi} \"%{cqhm} %{cqu}\" %{pssc} %{crc} \"%{cqh:Referer}\" \"%{cqh:User-Agent}\"", log)) {
+    GlobalPlugin *instance = new AccessLogPlugin();
+  }
+}
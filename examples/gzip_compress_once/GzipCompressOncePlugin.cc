@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+#include <list>
+#include <string>
+#include <strings.h>
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/TransactionPlugin.h>
+#include <atscppapi/GzipDeflateTransformation.h>
+#include <atscppapi/PluginInit.h>
+#include <atscppapi/Logger.h>
+#include <atscppapi/Stat.h>
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+
+#define TAG "gzip_compress_once"
+
+/*
+ * This example compresses each object once and serves the compressed copy from cache afterwards.
+ *
+ * Clients that accept gzip are given their own cache key, the compressed output of the
+ * GzipDeflateTransformation is written to cache under that key instead of the response from the
+ * origin, so every later hit for a gzip client is served compressed straight from cache without
+ * running the compressor. Clients that don't accept gzip use the normal cache key and get the
+ * uncompressed object. Vary: Accept-Encoding is only added to the compressed response sent to the client so
+ * downstream caches also keep the variants apart, our own cache already does through the cache key.
+ */
+
+namespace {
+Stat compressions_stat;
+Stat compressions_avoided_stat;
+
+/**
+ * Adds Accept-Encoding to the Vary header while keeping whatever the origin varies on. Nothing is added if
+ * it's already listed or if the origin sent Vary: *, which already covers every header.
+ */
+void addVaryAcceptEncoding(Headers &headers) {
+  string vary = headers.getJoinedValues("Vary");
+  string::size_type start = 0;
+  while (start < vary.length()) {
+    string::size_type end = vary.find(',', start);
+    if (end == string::npos) {
+      end = vary.length();
+    }
+    string::size_type first = vary.find_first_not_of(" \t", start);
+    string::size_type last = vary.find_last_not_of(" \t", end - 1);
+    if (first < end && last != string::npos && last >= first) {
+      string field = vary.substr(first, last - first + 1);
+      if (field == "*" || strcasecmp(field.c_str(), "Accept-Encoding") == 0) {
+        return;
+      }
+    }
+    start = end + 1;
+  }
+  headers.append("Vary", "Accept-Encoding");
+}
+}
+
+class CompressOncePlugin : public TransactionPlugin {
+public:
+  CompressOncePlugin(Transaction &transaction) : TransactionPlugin(transaction), compressing_(false) {
+    registerHook(HOOK_SEND_REQUEST_HEADERS);
+    registerHook(HOOK_READ_RESPONSE_HEADERS);
+    registerHook(HOOK_SEND_RESPONSE_HEADERS);
+
+    // Keep the compressed variant apart from the uncompressed one in cache.
+    string url = transaction.getEffectiveUrl();
+    url += (url.find('?') == string::npos) ? "?" : "&";
+    url += "atscppapi-content-encoding=gzip";
+    transaction.setCacheUrl(url);
+    TS_DEBUG(TAG, "Using cache url %s", url.c_str());
+  }
+
+  void handleSendRequestHeaders(Transaction &transaction) {
+    // We only get here on a cache miss, ask the origin for content we can compress.
+    transaction.getServerRequest().getHeaders().set("Accept-Encoding", "identity");
+    transaction.resume();
+  }
+
+  void handleReadResponseHeaders(Transaction &transaction) {
+    Headers &headers = transaction.getServerResponse().getHeaders();
+    string content_encoding = headers.getJoinedValues("Content-Encoding");
+    if (transaction.getServerResponse().getStatusCode() == HTTP_STATUS_OK &&
+        (content_encoding.empty() || content_encoding == "identity") &&
+        headers.getJoinedValues("Content-Type").find("text/") == 0) {
+      TS_DEBUG(TAG, "Compressing the response and caching the compressed copy");
+      compressing_ = true;
+      compressions_stat.increment();
+
+      // The headers of the transformed response are copied from the server response after this hook,
+      // so these are the headers that are cached along with the compressed content.
+      headers.set("Content-Encoding", "gzip");
+      transaction.setTransformedResponseCached(true);
+      transaction.setUntransformedResponseCached(false);
+      transaction.addPlugin(new GzipDeflateTransformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION));
+    }
+    transaction.resume();
+  }
+
+  void handleSendResponseHeaders(Transaction &transaction) {
+    Headers &headers = transaction.getClientResponse().getHeaders();
+    if (headers.getJoinedValues("Content-Encoding") == "gzip") {
+      addVaryAcceptEncoding(headers);
+      if (!compressing_ && transaction.getCacheStatus() == Transaction::CACHE_LOOKUP_HIT_FRESH) {
+        TS_DEBUG(TAG, "Served the compressed copy from cache");
+        compressions_avoided_stat.increment();
+      }
+    }
+    transaction.resume();
+  }
+
+private:
+  bool compressing_;
+};
+
+class GlobalHookPlugin : public GlobalPlugin {
+public:
+  GlobalHookPlugin() {
+    registerHook(HOOK_READ_REQUEST_HEADERS_POST_REMAP);
+  }
+
+  virtual void handleReadRequestHeadersPostRemap(Transaction &transaction) {
+    std::list<string> supported;
+    supported.push_back("gzip");
+    if (transaction.getClientRequest().getHeaders().negotiateAcceptEncoding(supported) == "gzip") {
+      transaction.addPlugin(new CompressOncePlugin(transaction));
+    }
+    transaction.resume();
+  }
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  TS_DEBUG(TAG, "TSPluginInit");
+  compressions_stat.init("gzip_compress_once.compressions");
+  compressions_avoided_stat.init("gzip_compress_once.compressions_avoided");
+  GlobalPlugin *instance = new GlobalHookPlugin();
+}
@@ -18,6 +18,7 @@
 #include <atscppapi/GzipDeflateTransformation.h>
 #include <atscppapi/PluginInit.h>
 #include <atscppapi/Logger.h>
+#include <atscppapi/Stat.h>
 
 using namespace atscppapi;
 using namespace atscppapi::transformations;
@@ -25,6 +26,10 @@ using std::string;
 
 #define TAG "gzip_transformation"
 
+namespace {
+Stat inflate_aborted_stat;
+}
+
 /*
  * Note, the GzipInflateTransformation and GzipDeflateTransformation do not
  * check headers to determine if the content was gziped and it doesn't check
@@ -43,7 +48,10 @@ using std::string;
 class Helpers {
 public:
   static bool clientAcceptsGzip(Transaction &transaction) {
-    return transaction.getClientRequest().getHeaders().getJoinedValues("Accept-Encoding").find("gzip") != string::npos;
+    // The parsed Accept-Encoding header is cached so this is cheap to call from several hooks.
+    std::list<string> supported;
+    supported.push_back("gzip");
+    return transaction.getClientRequest().getHeaders().negotiateAcceptEncoding(supported) == "gzip";
   }
 
   static bool serverReturnedGzip(Transaction &transaction) {
@@ -127,8 +135,12 @@ public:
     if (Helpers::serverReturnedGzip(transaction)) {
       // If the returned content was gziped we will inflate it so we can transform it.
       TS_DEBUG(TAG,"Creating Inflate Transformation because the server returned gziped content");
+      // Don't let a compression bomb from the origin use up our memory.
+      GzipInflateTransformation::Options options;
+      options.max_expansion_ratio_ = 100;
+      options.aborted_stat_ = &inflate_aborted_stat;
       transaction.addPlugin(new GzipInflateTransformation(transaction,
-                                                          TransformationPlugin::RESPONSE_TRANSFORMATION));
+                                                          TransformationPlugin::RESPONSE_TRANSFORMATION, options));
     }
 
     transaction.addPlugin(new SomeTransformationPlugin(transaction));
@@ -136,8 +148,14 @@ public:
     // Even if the server didn't return gziped content, if the user supports it we will gzip it.
     if (Helpers::clientAcceptsGzip(transaction)) {
       TS_DEBUG(TAG,"The client supports gzip so we will deflate the content on the way out.");
+
+      // Text compresses well so it's worth the CPU of the best level, anything else gets a fast level.
+      // In both cases the level is lowered when the server is too busy to keep up.
+      GzipDeflateTransformation::Options options;
+      options.level_ = (Helpers::getContentType(transaction) == Helpers::UNKNOWN) ? 1 : 9;
+      options.adaptive_ = true;
       transaction.addPlugin(new GzipDeflateTransformation(transaction,
-                                                          TransformationPlugin::RESPONSE_TRANSFORMATION));
+                                                          TransformationPlugin::RESPONSE_TRANSFORMATION, options));
     }
     transaction.resume();
   }
@@ -160,5 +178,6 @@ public:
 
 void TSPluginInit(int argc, const char *argv[]) {
   TS_DEBUG(TAG, "TSPluginInit");
+  inflate_aborted_stat.init("gzip_transformation.inflate_aborted");
   GlobalPlugin *instance = new GlobalHookPlugin();
 }
@@ -80,6 +80,11 @@ public:
     // This should work though:
     LOG_INFO(log, "%s", big_buffer_6kb_);
 
+    // A call site that runs on every request can be sampled or rate limited so it can't flood the log,
+    // the number of suppressed messages is reported periodically.
+    LOG_INFO_EVERY_N(log, 100, "Sampled request for %s", transaction.getClientRequest().getUrl().getPath().c_str());
+    LOG_ERROR_RATE_LIMITED(log, 5, "At most five of these a second");
+
     transaction.resume();
   }
 private:
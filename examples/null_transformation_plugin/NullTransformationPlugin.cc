@@ -11,6 +11,7 @@
  */
 
 #include <iostream>
+#include <cstdlib>
 #include <atscppapi/GlobalPlugin.h>
 #include <atscppapi/TransactionPlugin.h>
 #include <atscppapi/TransformationPlugin.h>
@@ -30,6 +31,13 @@ public:
   NullTransformationPlugin(Transaction &transaction)
     : TransformationPlugin(transaction, RESPONSE_TRANSFORMATION) {
     registerHook(HOOK_SEND_RESPONSE_HEADERS);
+
+    // We don't change the content so if the origin told us how long it is our output has the same
+    // length, declaring it lets the response keep its Content-Length instead of being sent chunked.
+    string content_length = transaction.getServerResponse().getHeaders().getJoinedValues("Content-Length");
+    if (!content_length.empty()) {
+      setOutputLength(strtoll(content_length.c_str(), NULL, 10));
+    }
   }
 
   void handleSendResponseHeaders(Transaction &transaction) {
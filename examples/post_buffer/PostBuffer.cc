@@ -13,7 +13,7 @@
 #include <iostream>
 #include <atscppapi/GlobalPlugin.h>
 #include <atscppapi/TransactionPlugin.h>
-#include <atscppapi/TransformationPlugin.h>
+#include <atscppapi/BufferingTransformation.h>
 #include <atscppapi/PluginInit.h>
 
 using namespace atscppapi;
@@ -21,27 +21,27 @@ using std::cerr;
 using std::endl;
 using std::string;
 
-class PostBufferTransformationPlugin : public TransformationPlugin {
+/*
+ * BufferingTransformation keeps up to 64KB of the body in memory, larger
+ * bodies are moved to an unlinked temporary file so a few large uploads
+ * cannot exhaust memory.
+ */
+class PostBufferTransformationPlugin : public BufferingTransformation {
 public:
   PostBufferTransformationPlugin(Transaction &transaction)
-    : TransformationPlugin(transaction, REQUEST_TRANSFORMATION), transaction_(transaction) {
-    buffer_.reserve(1024); // not required, this is an optimization to start the buffer at a slightly higher value.
-  }
-
-  void consume(const string &data) {
-    buffer_.append(data);
+    : BufferingTransformation(transaction, REQUEST_TRANSFORMATION, 64 * 1024), transaction_(transaction) {
   }
 
-  void handleInputComplete() {
-    produce(buffer_);
-    setOutputComplete();
+  void handleBufferedInput(const char *data, size_t length) {
+    cerr << "Buffered a POST body of " << length << " bytes" << (isSpilledToDisk() ? " on disk" : " in memory") << endl;
+    // The body is sent on a piece at a time as the origin reads it rather than copied into memory in one go.
+    produceBufferedInput();
   }
 
   virtual ~PostBufferTransformationPlugin() { }
 
 private:
   Transaction &transaction_;
-  string buffer_;
 };
 
 class GlobalHookPlugin : public GlobalPlugin {
@@ -63,6 +63,7 @@ public:
 };
 
 void TSPluginInit(int argc, const char *argv[]) {
+  BufferingTransformation::initStats("post_buffer");
   GlobalPlugin *instance = new GlobalHookPlugin();
 }
 
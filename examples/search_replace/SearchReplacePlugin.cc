@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+#include <map>
+#include <string>
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/SearchReplaceTransformation.h>
+#include <atscppapi/PluginInit.h>
+#include <atscppapi/Logger.h>
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+
+#define TAG "search_replace"
+
+/*
+ * Rewrites every occurrence of the origin hostnames in text/html responses. The patterns
+ * are compiled once in TSPluginInit and shared by every transaction.
+ *
+ * Usage: SearchReplacePlugin.so pattern1 replacement1 [pattern2 replacement2 ...]
+ */
+
+class GlobalHookPlugin : public GlobalPlugin {
+public:
+  GlobalHookPlugin(shared_ptr<SearchReplacePatterns> patterns) : patterns_(patterns) {
+    registerHook(HOOK_SEND_REQUEST_HEADERS);
+    registerHook(HOOK_READ_RESPONSE_HEADERS);
+  }
+
+  virtual void handleSendRequestHeaders(Transaction &transaction) {
+    // We can only rewrite content we can read, so make sure the origin doesn't compress it.
+    transaction.getServerRequest().getHeaders().erase("Accept-Encoding");
+    transaction.resume();
+  }
+
+  virtual void handleReadResponseHeaders(Transaction &transaction) {
+    if (transaction.getServerResponse().getHeaders().getJoinedValues("Content-Type").find("text/html") != string::npos) {
+      TS_DEBUG(TAG, "Adding search and replace transformation");
+      transaction.addPlugin(new SearchReplaceTransformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION,
+                                                            patterns_));
+    }
+    transaction.resume();
+  }
+private:
+  shared_ptr<SearchReplacePatterns> patterns_;
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  std::map<string, string> replacements;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    TS_DEBUG(TAG, "Will replace '%s' with '%s'", argv[i], argv[i + 1]);
+    replacements[argv[i]] = argv[i + 1];
+  }
+  shared_ptr<SearchReplacePatterns> patterns(new SearchReplacePatterns(replacements));
+  GlobalPlugin *instance = new GlobalHookPlugin(patterns);
+}
@@ -31,6 +31,15 @@ const string STAT_NAME = "stat_example";
 // This is the stat we'll be using, you can view it's value
 // using traffic_line -r stat_example
 Stat stat;
+
+// A counter of the bytes of every request url, it's sharded per thread since every transaction
+// updates it, you can view it using traffic_line -r stat_example.url_bytes
+Stat url_bytes_stat;
+
+// A count of the slashes in url paths, it's incremented through the Transaction so all of a request's slashes
+// are added to the stat in one go when the transaction closes, view it using
+// traffic_line -r stat_example.path_slashes
+Stat path_slashes_stat;
 }
 
 /*
@@ -47,6 +56,13 @@ public:
   virtual void handleReadRequestHeadersPostRemap(Transaction &transaction) {
     TS_DEBUG(TAG, "Received a request, incrementing the counter.");
     stat.increment();
+    url_bytes_stat.increment(transaction.getClientRequest().getUrl().getUrlString().length());
+    const string &path = transaction.getClientRequest().getUrl().getPath();
+    for (string::size_type i = 0; i < path.length(); ++i) {
+      if (path[i] == '/') {
+        transaction.incrementStat(path_slashes_stat);
+      }
+    }
     TS_DEBUG(TAG, "Stat '%s' value = %lld", STAT_NAME.c_str(), stat.get());
     transaction.resume();
   }
@@ -58,6 +74,8 @@ void TSPluginInit(int argc, const char *argv[]) {
   // Since this stat is not persistent it will be initialized to 0.
   stat.init(STAT_NAME, Stat::SYNC_COUNT, true);
   stat.set(0);
+  url_bytes_stat.initSharded(STAT_NAME + ".url_bytes");
+  path_slashes_stat.init(STAT_NAME + ".path_slashes", Stat::SYNC_SUM);
 
   GlobalPlugin *instance = new GlobalHookPlugin();
 }
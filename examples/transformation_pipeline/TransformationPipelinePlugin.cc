@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+#include <iostream>
+#include <map>
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/TransformationPipeline.h>
+#include <atscppapi/SearchReplaceTransformation.h>
+#include <atscppapi/GzipDeflateTransformation.h>
+#include <atscppapi/PluginInit.h>
+#include <atscppapi/Logger.h>
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+
+#define TAG "transformation_pipeline"
+
+/*
+ * This example filters, rewrites and compresses html responses inside a single transformation:
+ * the first stage strips carriage returns from the body, the second stage is the SearchReplaceTransformation
+ * that rewrites links to the origin into links to the cdn and the last stage is the GzipDeflateTransformation.
+ * Compared to adding three TransformationPlugins to the transaction the data moves from one stage to the next
+ * without another trip through Traffic Server.
+ */
+
+namespace {
+shared_ptr<SearchReplacePatterns> patterns;
+}
+
+class StripCarriageReturnStage : public TransformationPipeline::Stage {
+public:
+  void consume(const string &data) {
+    string output;
+    output.reserve(data.length());
+    for (string::const_iterator iter = data.begin(), end = data.end(); iter != end; ++iter) {
+      if (*iter != '\r') {
+        output += *iter;
+      }
+    }
+    produce(output);
+  }
+
+  void handleInputComplete() {
+    size_t bytes = setOutputComplete();
+    TS_DEBUG(TAG, "StripCarriageReturnStage produced %lu bytes", bytes);
+  }
+};
+
+class Helpers {
+public:
+  static bool shouldTransform(Transaction &transaction) {
+    return transaction.getServerResponse().getHeaders().getJoinedValues("Content-Type").find("text/html") != string::npos;
+  }
+
+  static bool clientAcceptsGzip(Transaction &transaction) {
+    std::list<string> supported;
+    supported.push_back("gzip");
+    return transaction.getClientRequest().getHeaders().negotiateAcceptEncoding(supported) == "gzip";
+  }
+};
+
+class GlobalHookPlugin : public GlobalPlugin {
+public:
+  GlobalHookPlugin() {
+    registerHook(HOOK_SEND_REQUEST_HEADERS);
+    registerHook(HOOK_READ_RESPONSE_HEADERS);
+    registerHook(HOOK_SEND_RESPONSE_HEADERS);
+  }
+
+  virtual void handleSendRequestHeaders(Transaction &transaction) {
+    // The body can only be rewritten if the origin doesn't compress it.
+    transaction.getServerRequest().getHeaders().set("Accept-Encoding", "identity");
+    transaction.resume();
+  }
+
+  virtual void handleReadResponseHeaders(Transaction &transaction) {
+    if (Helpers::shouldTransform(transaction)) {
+      TransformationPipeline *pipeline = new TransformationPipeline(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION);
+      pipeline->addStage(new StripCarriageReturnStage());
+      pipeline->addStage(new SearchReplaceTransformation(transaction, TransformationPlugin::PIPELINE_STAGE, patterns));
+      if (Helpers::clientAcceptsGzip(transaction)) {
+        pipeline->addStage(new GzipDeflateTransformation(transaction, TransformationPlugin::PIPELINE_STAGE));
+      }
+      transaction.addPlugin(pipeline);
+    }
+    transaction.resume();
+  }
+
+  virtual void handleSendResponseHeaders(Transaction &transaction) {
+    if (Helpers::shouldTransform(transaction) && Helpers::clientAcceptsGzip(transaction)) {
+      transaction.getClientResponse().getHeaders().set("Content-Encoding", "gzip");
+      transaction.getClientResponse().getHeaders().append("Vary", "Accept-Encoding");
+    }
+    transaction.resume();
+  }
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  TS_DEBUG(TAG, "TSPluginInit");
+  std::map<string, string> replacements;
+  replacements["http://origin.example.com/"] = "http://cdn.example.com/";
+  patterns.reset(new SearchReplacePatterns(replacements));
+  GlobalPlugin *instance = new GlobalHookPlugin();
+}
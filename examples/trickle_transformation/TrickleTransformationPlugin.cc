@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+#include <cstdlib>
+#include <string>
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/TransformationPlugin.h>
+#include <atscppapi/PluginInit.h>
+#include <atscppapi/Logger.h>
+
+using namespace atscppapi;
+using std::string;
+
+#define TAG "trickle_transformation"
+
+/*
+ * This example sends each response body downstream at most chunk_bytes every delay_ms, using
+ * scheduleWakeup() to come back to the output it holds while no new input arrives:
+ *
+ *   TrickleTransformationPlugin.so [delay_ms] [chunk_bytes]
+ *
+ * It's also the way to exercise a transaction that closes while a wakeup is pending. With the default of
+ * 1KB every 1000ms, abort the download of any larger response before it finishes, for example with
+ * curl --max-time 2, the transformation is destroyed with its wakeup still scheduled.
+ */
+
+namespace {
+int delay_ms = 1000;
+size_t chunk_bytes = 1024;
+}
+
+class TrickleTransformationPlugin : public TransformationPlugin {
+public:
+  TrickleTransformationPlugin(Transaction &transaction)
+    : TransformationPlugin(transaction, RESPONSE_TRANSFORMATION), input_complete_(false) {
+  }
+
+  void consume(const string &data) {
+    held_.append(data);
+    scheduleWakeup(delay_ms);
+  }
+
+  void handleInputComplete() {
+    input_complete_ = true;
+    if (held_.empty()) {
+      setOutputComplete();
+    }
+  }
+
+  void handleWakeup() {
+    size_t length = (held_.length() < chunk_bytes) ? held_.length() : chunk_bytes;
+    TS_DEBUG(TAG, "Releasing %lu of %lu held bytes", static_cast<unsigned long>(length),
+             static_cast<unsigned long>(held_.length()));
+    produce(held_.data(), length);
+    held_.erase(0, length);
+    if (!held_.empty()) {
+      scheduleWakeup(delay_ms);
+    } else if (input_complete_) {
+      setOutputComplete();
+    }
+  }
+
+private:
+  string held_;
+  bool input_complete_;
+};
+
+class GlobalHookPlugin : public GlobalPlugin {
+public:
+  GlobalHookPlugin() {
+    registerHook(HOOK_READ_RESPONSE_HEADERS);
+  }
+
+  virtual void handleReadResponseHeaders(Transaction &transaction) {
+    transaction.addPlugin(new TrickleTransformationPlugin(transaction));
+    transaction.resume();
+  }
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  if (argc > 1) {
+    delay_ms = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    chunk_bytes = strtoul(argv[2], NULL, 10);
+  }
+  TS_DEBUG(TAG, "TSPluginInit delay_ms=%d chunk_bytes=%lu", delay_ms, static_cast<unsigned long>(chunk_bytes));
+  GlobalPlugin *instance = new GlobalHookPlugin();
+}
@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file AccessLog.cc
+ */
+
+#include "atscppapi/AccessLog.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <strings.h>
+#include <ts/ts.h>
+#include "atscppapi/Logger.h"
+#include "atscppapi/Transaction.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+namespace {
+
+/**
+ * The headers of a transaction that fields can read from, in the order of HEADER_GETTERS.
+ */
+enum HeaderSource {
+  CLIENT_REQUEST = 0,
+  PROXY_REQUEST,
+  SERVER_RESPONSE,
+  PROXY_RESPONSE,
+  NUM_HEADER_SOURCES
+};
+
+typedef TSReturnCode (*HeaderGetter)(TSHttpTxn, TSMBuffer *, TSMLoc *);
+
+const HeaderGetter HEADER_GETTERS[NUM_HEADER_SOURCES] = { TSHttpTxnClientReqGet, TSHttpTxnServerReqGet,
+                                                          TSHttpTxnServerRespGet, TSHttpTxnClientRespGet };
+
+enum Opcode {
+  OP_LITERAL = 0,
+  OP_HEADER,
+  OP_METHOD,
+  OP_URL,
+  OP_PATH,
+  OP_STATUS,
+  OP_CLIENT_IP,
+  OP_CACHE_STATUS
+};
+
+struct Instruction {
+  Opcode opcode_;
+  HeaderSource source_;
+  string text_; // the literal or the header name
+  Instruction(Opcode opcode, HeaderSource source = CLIENT_REQUEST, const string &text = string())
+      : opcode_(opcode), source_(source), text_(text) { }
+};
+
+/**
+ * The headers one log() call has fetched, each one is fetched the first time a field needs it.
+ */
+struct TransactionHeaders {
+  TSHttpTxn txn_;
+  bool fetched_[NUM_HEADER_SOURCES];
+  TSMBuffer hdr_buf_[NUM_HEADER_SOURCES];
+  TSMLoc hdr_loc_[NUM_HEADER_SOURCES];
+  TSMLoc url_loc_[NUM_HEADER_SOURCES];
+
+  TransactionHeaders(TSHttpTxn txn) : txn_(txn) {
+    memset(fetched_, 0, sizeof(fetched_));
+    memset(hdr_loc_, 0, sizeof(hdr_loc_));
+    memset(url_loc_, 0, sizeof(url_loc_));
+  }
+
+  ~TransactionHeaders() {
+    for (int i = 0; i < NUM_HEADER_SOURCES; ++i) {
+      if (url_loc_[i]) {
+        TSHandleMLocRelease(hdr_buf_[i], hdr_loc_[i], url_loc_[i]);
+      }
+      if (hdr_loc_[i]) {
+        TSMLoc null_parent_loc = NULL;
+        TSHandleMLocRelease(hdr_buf_[i], null_parent_loc, hdr_loc_[i]);
+      }
+    }
+  }
+
+  bool get(HeaderSource source) {
+    if (!fetched_[source]) {
+      fetched_[source] = true;
+      if (HEADER_GETTERS[source](txn_, &hdr_buf_[source], &hdr_loc_[source]) != TS_SUCCESS) {
+        hdr_loc_[source] = NULL;
+      }
+    }
+    return hdr_loc_[source] != NULL;
+  }
+
+  bool getUrl(HeaderSource source) {
+    if (!url_loc_[source] && get(source) &&
+        TSHttpHdrUrlGet(hdr_buf_[source], hdr_loc_[source], &url_loc_[source]) != TS_SUCCESS) {
+      url_loc_[source] = NULL;
+    }
+    return url_loc_[source] != NULL;
+  }
+};
+
+const char MISSING_VALUE[] = "-";
+
+pthread_once_t line_buffer_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t line_buffer_key;
+
+void deleteLineBuffer(void *buffer) {
+  delete static_cast<string *>(buffer);
+}
+
+void createLineBufferKey() {
+  pthread_key_create(&line_buffer_key, deleteLineBuffer);
+}
+
+/**
+ * @return the calling thread's line buffer, it keeps its capacity between lines.
+ */
+string &getLineBuffer() {
+  pthread_once(&line_buffer_key_once, createLineBufferKey);
+  string *buffer = static_cast<string *>(pthread_getspecific(line_buffer_key));
+  if (!buffer) {
+    buffer = new string();
+    buffer->reserve(1024);
+    pthread_setspecific(line_buffer_key, buffer);
+  }
+  return *buffer;
+}
+
+void appendValue(string &line, const char *value, int length) {
+  if (value && length > 0) {
+    line.append(value, length);
+  } else {
+    line.append(MISSING_VALUE, sizeof(MISSING_VALUE) - 1);
+  }
+}
+
+void appendHeader(string &line, TransactionHeaders &headers, HeaderSource source, const string &name) {
+  TSMLoc field_loc = NULL;
+  if (headers.get(source)) {
+    field_loc = TSMimeHdrFieldFind(headers.hdr_buf_[source], headers.hdr_loc_[source], name.c_str(), name.length());
+  }
+  if (!field_loc) {
+    line.append(MISSING_VALUE, sizeof(MISSING_VALUE) - 1);
+    return;
+  }
+
+  bool first = true;
+  while (field_loc) {
+    int length = 0;
+    // An index of -1 returns all of the field's values as they were received.
+    const char *value = TSMimeHdrFieldValueStringGet(headers.hdr_buf_[source], headers.hdr_loc_[source], field_loc,
+                                                     -1, &length);
+    if (!first) {
+      line.append(", ", 2);
+    }
+    if (value && length > 0) {
+      line.append(value, length);
+    }
+    first = false;
+    TSMLoc next_field_loc = TSMimeHdrFieldNextDup(headers.hdr_buf_[source], headers.hdr_loc_[source], field_loc);
+    TSHandleMLocRelease(headers.hdr_buf_[source], headers.hdr_loc_[source], field_loc);
+    field_loc = next_field_loc;
+  }
+}
+
+/**
+ * @return the port a url with this scheme uses when it doesn't name one, or -1 if it isn't known.
+ */
+int getDefaultPort(const char *scheme, int length) {
+  if (!scheme || length <= 0 || (length == 4 && strncasecmp(scheme, "http", 4) == 0) ||
+      (length == 2 && strncasecmp(scheme, "ws", 2) == 0)) {
+    return 80;
+  }
+  if ((length == 5 && strncasecmp(scheme, "https", 5) == 0) || (length == 3 && strncasecmp(scheme, "wss", 3) == 0)) {
+    return 443;
+  }
+  return -1;
+}
+
+void appendUrl(string &line, TransactionHeaders &headers, HeaderSource source, bool path_only) {
+  if (!headers.getUrl(source)) {
+    line.append(MISSING_VALUE, sizeof(MISSING_VALUE) - 1);
+    return;
+  }
+  TSMBuffer hdr_buf = headers.hdr_buf_[source];
+  TSMLoc url_loc = headers.url_loc_[source];
+  int length = 0;
+  const char *value;
+  if (!path_only) {
+    value = TSUrlHostGet(hdr_buf, url_loc, &length);
+    if (value && length > 0) {
+      int scheme_length = 0;
+      const char *scheme = TSUrlSchemeGet(hdr_buf, url_loc, &scheme_length);
+      if (scheme && scheme_length > 0) {
+        line.append(scheme, scheme_length);
+        line.append("://", 3);
+      }
+      line.append(value, length);
+      int port = TSUrlPortGet(hdr_buf, url_loc);
+      if (port != getDefaultPort(scheme, scheme_length)) {
+        char port_string[8];
+        line.append(port_string, snprintf(port_string, sizeof(port_string), ":%d", port));
+      }
+    }
+  }
+  line += '/';
+  value = TSUrlPathGet(hdr_buf, url_loc, &length);
+  if (value && length > 0) {
+    line.append(value, length);
+  }
+  if (!path_only) {
+    value = TSUrlHttpQueryGet(hdr_buf, url_loc, &length);
+    if (value && length > 0) {
+      line += '?';
+      line.append(value, length);
+    }
+  }
+}
+
+void appendClientIp(string &line, const sockaddr *address) {
+  char ip[INET6_ADDRSTRLEN];
+  const char *result = NULL;
+  if (address && address->sa_family == AF_INET) {
+    result = inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(address)->sin_addr, ip, sizeof(ip));
+  } else if (address && address->sa_family == AF_INET6) {
+    result = inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6 *>(address)->sin6_addr, ip, sizeof(ip));
+  }
+  appendValue(line, result, result ? strlen(result) : 0);
+}
+
+const char *CACHE_STATUS_STRINGS[] = { "NONE", "MISS", "HIT_STALE", "HIT_FRESH", "SKIPPED" };
+
+/**
+ * Compiles one %{...} field, field is the text between the braces.
+ */
+bool compileField(const string &field, vector<Instruction> &instructions) {
+  string name = field;
+  string argument;
+  string::size_type colon = field.find(':');
+  if (colon != string::npos) {
+    name = field.substr(0, colon);
+    argument = field.substr(colon + 1);
+  }
+
+  HeaderSource source = NUM_HEADER_SOURCES;
+  if (name.compare(0, 2, "cq") == 0) {
+    source = CLIENT_REQUEST;
+  } else if (name.compare(0, 2, "pq") == 0) {
+    source = PROXY_REQUEST;
+  } else if (name.compare(0, 2, "ss") == 0) {
+    source = SERVER_RESPONSE;
+  } else if (name.compare(0, 2, "ps") == 0) {
+    source = PROXY_RESPONSE;
+  }
+  string suffix = (name.length() > 2) ? name.substr(2) : string();
+  bool is_request = (source == CLIENT_REQUEST || source == PROXY_REQUEST);
+
+  if (suffix == "h" && source != NUM_HEADER_SOURCES) {
+    if (argument.empty()) {
+      return false;
+    }
+    instructions.push_back(Instruction(OP_HEADER, source, argument));
+    return true;
+  }
+  if (!argument.empty()) {
+    return false;
+  }
+  if (suffix == "hm" && is_request) {
+    instructions.push_back(Instruction(OP_METHOD, source));
+  } else if (suffix == "u" && is_request) {
+    instructions.push_back(Instruction(OP_URL, source));
+  } else if (suffix == "up" && is_request) {
+    instructions.push_back(Instruction(OP_PATH, source));
+  } else if (suffix == "sc" && (source == SERVER_RESPONSE || source == PROXY_RESPONSE)) {
+    instructions.push_back(Instruction(OP_STATUS, source));
+  } else if (name == "chi") {
+    instructions.push_back(Instruction(OP_CLIENT_IP));
+  } else if (name == "crc") {
+    instructions.push_back(Instruction(OP_CACHE_STATUS));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool compileFormat(const string &format, vector<Instruction> &instructions) {
+  string literal;
+  for (string::size_type i = 0; i < format.length(); ++i) {
+    if (format[i] != '%') {
+      literal += format[i];
+      continue;
+    }
+    if (i + 1 < format.length() && format[i + 1] == '%') {
+      literal += '%';
+      ++i;
+      continue;
+    }
+    string::size_type end = format.find('}', i);
+    if (i + 1 >= format.length() || format[i + 1] != '{' || end == string::npos) {
+      return false;
+    }
+    if (!literal.empty()) {
+      instructions.push_back(Instruction(OP_LITERAL, CLIENT_REQUEST, literal));
+      literal.clear();
+    }
+    if (!compileField(format.substr(i + 2, end - i - 2), instructions)) {
+      return false;
+    }
+    i = end;
+  }
+  if (!literal.empty()) {
+    instructions.push_back(Instruction(OP_LITERAL, CLIENT_REQUEST, literal));
+  }
+  return true;
+}
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::AccessLogState : noncopyable {
+  vector<Instruction> instructions_;
+  Logger *logger_;
+  AccessLogState() : logger_(NULL) { }
+};
+
+AccessLog::AccessLog() {
+  state_ = new AccessLogState();
+}
+
+AccessLog::~AccessLog() {
+  delete state_;
+}
+
+bool AccessLog::init(const string &format, Logger &logger) {
+  vector<Instruction> instructions;
+  if (!compileFormat(format, instructions)) {
+    LOG_ERROR("Unable to compile access log format '%s'", format.c_str());
+    return false;
+  }
+  state_->instructions_.swap(instructions);
+  state_->logger_ = &logger;
+  LOG_DEBUG("Compiled access log format '%s' into %d instructions", format.c_str(),
+            static_cast<int>(state_->instructions_.size()));
+  return true;
+}
+
+void AccessLog::log(Transaction &transaction) {
+  if (!state_->logger_) {
+    LOG_ERROR("Unable to log, the access log is not initialized.");
+    return;
+  }
+
+  TransactionHeaders headers(static_cast<TSHttpTxn>(transaction.getAtsHandle()));
+  string &line = getLineBuffer();
+  line.clear();
+  for (vector<Instruction>::const_iterator iter = state_->instructions_.begin(); iter != state_->instructions_.end();
+       ++iter) {
+    const Instruction &instruction = *iter;
+    switch (instruction.opcode_) {
+    case OP_LITERAL:
+      line.append(instruction.text_);
+      break;
+    case OP_HEADER:
+      appendHeader(line, headers, instruction.source_, instruction.text_);
+      break;
+    case OP_METHOD: {
+      int length = 0;
+      const char *method = headers.get(instruction.source_) ?
+          TSHttpHdrMethodGet(headers.hdr_buf_[instruction.source_], headers.hdr_loc_[instruction.source_], &length) :
+          NULL;
+      appendValue(line, method, length);
+      break;
+    }
+    case OP_URL:
+    case OP_PATH:
+      appendUrl(line, headers, instruction.source_, instruction.opcode_ == OP_PATH);
+      break;
+    case OP_STATUS:
+      if (headers.get(instruction.source_)) {
+        char status[8];
+        line.append(status, snprintf(status, sizeof(status), "%d", static_cast<int>(TSHttpHdrStatusGet(
+            headers.hdr_buf_[instruction.source_], headers.hdr_loc_[instruction.source_]))));
+      } else {
+        line.append(MISSING_VALUE, sizeof(MISSING_VALUE) - 1);
+      }
+      break;
+    case OP_CLIENT_IP:
+      appendClientIp(line, transaction.getClientAddress());
+      break;
+    case OP_CACHE_STATUS:
+      line.append(CACHE_STATUS_STRINGS[transaction.getCacheStatus()]);
+      break;
+    }
+  }
+  state_->logger_->logRaw(line.data(), line.length());
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BrotliDecodeTransformation.cc
+ */
+
+#include <string>
+#include <vector>
+#include <brotli/decode.h>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/BrotliDecodeTransformation.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+const size_t OUTPUT_BUFFER_SIZE = 32 * 1024;
+const int64_t EXPANSION_RATIO_MIN_OUTPUT = 1024 * 1024;
+}
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::BrotliDecodeTransformationState: noncopyable {
+  BrotliDecoderState *decoder_;
+  BrotliDecodeTransformation::Options options_;
+  vector<uint8_t> output_buffer_; // reused by every call to the decoder.
+  int64_t bytes_consumed_;
+  int64_t bytes_produced_;
+  bool finished_; // the decoder reached the end of the brotli stream.
+  bool aborted_;
+
+  BrotliDecodeTransformationState(const BrotliDecodeTransformation::Options &options) :
+        decoder_(BrotliDecoderCreateInstance(NULL, NULL, NULL)), options_(options),
+        output_buffer_(OUTPUT_BUFFER_SIZE), bytes_consumed_(0), bytes_produced_(0), finished_(false),
+        aborted_(false) {
+    if (!decoder_) {
+      LOG_ERROR("BrotliDecoderCreateInstance failed.");
+    }
+  };
+
+  ~BrotliDecodeTransformationState() {
+    if (decoder_) {
+      BrotliDecoderDestroyInstance(decoder_);
+    }
+  };
+};
+
+BrotliDecodeTransformation::BrotliDecodeTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                       const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new BrotliDecodeTransformationState(options);
+}
+
+BrotliDecodeTransformation::~BrotliDecodeTransformation() {
+  delete state_;
+}
+
+bool BrotliDecodeTransformation::isAborted() const {
+  return state_->aborted_;
+}
+
+void BrotliDecodeTransformation::consume(const string &data) {
+  if (data.size() == 0 || state_->aborted_) {
+    return;
+  }
+
+  if (!state_->decoder_) {
+    LOG_ERROR("Unable to decompress output because the brotli decoder was not created, aborting the output.");
+    state_->aborted_ = true;
+    abortOutput();
+    return;
+  }
+
+  if (state_->finished_) {
+    LOG_ERROR("Brotli stream was followed by %lu bytes of trailing data, aborting the output",
+              static_cast<unsigned long>(data.length()));
+    state_->aborted_ = true;
+    abortOutput();
+    return;
+  }
+
+  size_t avail_in = data.length();
+  const uint8_t *next_in = reinterpret_cast<const uint8_t *>(data.data());
+  state_->bytes_consumed_ += data.length();
+  BrotliDecoderResult result;
+  int iteration = 0;
+
+  do {
+    size_t avail_out = state_->output_buffer_.size();
+    uint8_t *next_out = &state_->output_buffer_[0];
+    LOG_DEBUG("Iteration %d: Brotli has %lu bytes to decompress", ++iteration, static_cast<unsigned long>(avail_in));
+
+    result = BrotliDecoderDecompressStream(state_->decoder_, &avail_in, &next_in, &avail_out, &next_out, NULL);
+    if (result == BROTLI_DECODER_RESULT_ERROR) {
+      LOG_ERROR("Iteration %d: Brotli failed to decompress with error '%s', aborting the output", iteration,
+                BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state_->decoder_)));
+      state_->aborted_ = true;
+      abortOutput();
+      return;
+    }
+
+    int64_t decoded_bytes = state_->output_buffer_.size() - avail_out;
+    int64_t total_decoded_bytes = state_->bytes_produced_ + decoded_bytes;
+    const Options &options = state_->options_;
+    if ((options.max_output_bytes_ > 0 && total_decoded_bytes > options.max_output_bytes_) ||
+        (options.max_expansion_ratio_ > 0 && total_decoded_bytes > EXPANSION_RATIO_MIN_OUTPUT &&
+         total_decoded_bytes > options.max_expansion_ratio_ * state_->bytes_consumed_)) {
+      LOG_ERROR("Aborting brotli decode after %lld compressed bytes decoded to %lld bytes, max output bytes=%lld "
+                "max expansion ratio=%d", static_cast<long long>(state_->bytes_consumed_),
+                static_cast<long long>(total_decoded_bytes), static_cast<long long>(options.max_output_bytes_),
+                options.max_expansion_ratio_);
+      state_->aborted_ = true;
+      if (options.aborted_stat_) {
+        options.aborted_stat_->increment();
+      }
+      abortOutput();
+      return;
+    }
+
+    produce(reinterpret_cast<char *>(&state_->output_buffer_[0]), decoded_bytes);
+    state_->bytes_produced_ += decoded_bytes;
+  } while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+
+  if (result == BROTLI_DECODER_RESULT_SUCCESS) {
+    state_->finished_ = true;
+    if (avail_in != 0) {
+      LOG_ERROR("Brotli stream finished with %lu bytes of trailing data, aborting the output",
+                static_cast<unsigned long>(avail_in));
+      state_->aborted_ = true;
+      abortOutput();
+    }
+  }
+}
+
+void BrotliDecodeTransformation::handleInputComplete() {
+  if (state_->aborted_) {
+    // The output was aborted, it must not be completed.
+    return;
+  }
+
+  // An empty body is passed through, anything else must have reached the end of the stream.
+  if (!state_->finished_ && state_->bytes_consumed_ > 0) {
+    LOG_ERROR("Brotli stream was truncated after %lld compressed bytes, aborting the output",
+              static_cast<long long>(state_->bytes_consumed_));
+    state_->aborted_ = true;
+    abortOutput();
+    return;
+  }
+
+  int64_t bytes_written = setOutputComplete();
+  if (state_->bytes_produced_ != bytes_written) {
+    LOG_ERROR("Brotli bytes produced sanity check failed, decoded bytes = %lld != written bytes = %lld",
+              static_cast<long long>(state_->bytes_produced_), static_cast<long long>(bytes_written));
+  }
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BrotliEncodeTransformation.cc
+ */
+
+#include <string>
+#include <vector>
+#include <brotli/encode.h>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/BrotliEncodeTransformation.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+const size_t OUTPUT_BUFFER_SIZE = 32 * 1024;
+}
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::BrotliEncodeTransformationState: noncopyable {
+  BrotliEncoderState *encoder_;
+  BrotliEncodeTransformation::Options options_;
+  vector<uint8_t> output_buffer_; // reused by every call to the encoder.
+  size_t bytes_since_flush_;
+  int64_t bytes_produced_;
+
+  BrotliEncodeTransformationState(const BrotliEncodeTransformation::Options &options) :
+        encoder_(BrotliEncoderCreateInstance(NULL, NULL, NULL)), options_(options),
+        output_buffer_(OUTPUT_BUFFER_SIZE), bytes_since_flush_(0), bytes_produced_(0) {
+    if (!encoder_) {
+      LOG_ERROR("BrotliEncoderCreateInstance failed.");
+      return;
+    }
+    BrotliEncoderSetParameter(encoder_, BROTLI_PARAM_QUALITY, options.quality_);
+    BrotliEncoderSetParameter(encoder_, BROTLI_PARAM_LGWIN, options.window_bits_);
+    BrotliEncoderSetParameter(encoder_, BROTLI_PARAM_MODE, options.text_ ? BROTLI_MODE_TEXT : BROTLI_MODE_GENERIC);
+    LOG_DEBUG("Brotli encoding with quality=%d window_bits=%d text=%d", options.quality_, options.window_bits_,
+              options.text_);
+  };
+
+  ~BrotliEncodeTransformationState() {
+    if (encoder_) {
+      BrotliEncoderDestroyInstance(encoder_);
+    }
+  };
+};
+
+BrotliEncodeTransformation::BrotliEncodeTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                       const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new BrotliEncodeTransformationState(options);
+}
+
+BrotliEncodeTransformation::~BrotliEncodeTransformation() {
+  delete state_;
+}
+
+void BrotliEncodeTransformation::encode(const char *data, size_t length, int operation) {
+  size_t avail_in = length;
+  const uint8_t *next_in = reinterpret_cast<const uint8_t *>(data);
+  BrotliEncoderOperation op = static_cast<BrotliEncoderOperation>(operation);
+  int iteration = 0;
+
+  while (true) {
+    size_t avail_out = state_->output_buffer_.size();
+    uint8_t *next_out = &state_->output_buffer_[0];
+    LOG_DEBUG("Iteration %d: Brotli will compress %lu bytes, operation=%d", ++iteration,
+              static_cast<unsigned long>(avail_in), operation);
+
+    if (!BrotliEncoderCompressStream(state_->encoder_, op, &avail_in, &next_in, &avail_out, &next_out, NULL)) {
+      LOG_ERROR("Iteration %d: Brotli failed to compress %lu bytes with operation=%d", iteration,
+                static_cast<unsigned long>(length), operation);
+      return;
+    }
+
+    size_t bytes_to_write = state_->output_buffer_.size() - avail_out;
+    state_->bytes_produced_ += bytes_to_write;
+    produce(reinterpret_cast<char *>(&state_->output_buffer_[0]), bytes_to_write);
+
+    if (avail_in == 0 && !BrotliEncoderHasMoreOutput(state_->encoder_) &&
+        (op != BROTLI_OPERATION_FINISH || BrotliEncoderIsFinished(state_->encoder_))) {
+      break;
+    }
+  }
+}
+
+void BrotliEncodeTransformation::consume(const string &data) {
+  if (data.size() == 0) {
+    return;
+  }
+
+  if (!state_->encoder_) {
+    LOG_ERROR("Unable to compress output because the brotli encoder was not created.");
+    return;
+  }
+
+  BrotliEncoderOperation op = BROTLI_OPERATION_PROCESS;
+  state_->bytes_since_flush_ += data.length();
+  if (state_->options_.latency_sensitive_ || state_->bytes_since_flush_ >= state_->options_.flush_bytes_) {
+    op = BROTLI_OPERATION_FLUSH;
+    state_->bytes_since_flush_ = 0;
+  }
+  encode(data.data(), data.length(), op);
+}
+
+void BrotliEncodeTransformation::handleInputComplete() {
+  if (state_->encoder_) {
+    encode(NULL, 0, BROTLI_OPERATION_FINISH);
+  }
+
+  int64_t bytes_written = setOutputComplete();
+  if (state_->bytes_produced_ != bytes_written) {
+    LOG_ERROR("Brotli bytes produced sanity check failed, compressed bytes = %lld != written bytes = %lld",
+              static_cast<long long>(state_->bytes_produced_), static_cast<long long>(bytes_written));
+  }
+}
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BufferingTransformation.cc
+ */
+
+#include "atscppapi/BufferingTransformation.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "atscppapi/Stat.h"
+#include "atscppapi/noncopyable.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+
+namespace {
+// produceBufferedInput() writes the body in chunks of this size, and at most FORWARD_ROUND_BYTES each time the
+// output drains, so the output never holds much more than the low watermark plus one round.
+const size_t FORWARD_CHUNK_BYTES = 64 * 1024;
+const size_t FORWARD_ROUND_BYTES = 4 * FORWARD_CHUNK_BYTES;
+
+Stat memory_bytes_stat;
+Stat disk_bytes_stat;
+
+bool writeFully(int fd, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    length -= written;
+  }
+  return true;
+}
+}
+
+/**
+ * @private
+ */
+struct atscppapi::BufferingTransformationState: noncopyable {
+  size_t max_memory_bytes_;
+  string spill_directory_;
+  string memory_buffer_;
+  int fd_;
+  int64_t disk_bytes_;
+  bool failed_; // set once part of the body was lost, the body is then never handed to handleBufferedInput().
+  void *view_; // the mmap of the temporary file, kept until produceBufferedInput() is done with it.
+  size_t view_length_;
+  const char *input_data_; // the body passed to handleBufferedInput().
+  size_t input_length_;
+  size_t forward_offset_;
+  bool forwarding_;
+
+  BufferingTransformationState(size_t max_memory_bytes, const string &spill_directory)
+    : max_memory_bytes_(max_memory_bytes), spill_directory_(spill_directory), fd_(-1), disk_bytes_(0),
+      failed_(false), view_(NULL), view_length_(0), input_data_(NULL), input_length_(0), forward_offset_(0),
+      forwarding_(false) { }
+
+  ~BufferingTransformationState() {
+    releaseView();
+    memory_bytes_stat.decrement(memory_buffer_.length());
+    disk_bytes_stat.decrement(disk_bytes_);
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  void releaseView() {
+    if (view_) {
+      munmap(view_, view_length_);
+      view_ = NULL;
+      view_length_ = 0;
+    }
+  }
+
+  bool spill() {
+    string path_template = spill_directory_ + "/atscppapi_buffer.XXXXXX";
+    std::vector<char> path(path_template.begin(), path_template.end());
+    path.push_back('\0');
+
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+      LOG_ERROR("Unable to create temporary file in '%s', errno=%d.",
+          spill_directory_.c_str(), errno);
+      return false;
+    }
+    unlink(&path[0]); // the file will go away as soon as it's closed.
+
+    if (!writeFully(fd, memory_buffer_.data(), memory_buffer_.length())) {
+      LOG_ERROR("Unable to write %lu bytes to temporary file, errno=%d.",
+          static_cast<unsigned long>(memory_buffer_.length()), errno);
+      close(fd);
+      return false;
+    }
+
+    LOG_DEBUG("Spilled %lu bytes from memory to temporary file fd=%d", static_cast<unsigned long>(memory_buffer_.length()),
+        fd);
+    fd_ = fd;
+    disk_bytes_ = memory_buffer_.length();
+    disk_bytes_stat.increment(disk_bytes_);
+    memory_bytes_stat.decrement(memory_buffer_.length());
+    string().swap(memory_buffer_); // actually release the memory.
+    return true;
+  }
+};
+
+BufferingTransformation::BufferingTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                 size_t max_memory_bytes, const string &spill_directory)
+  : TransformationPlugin(transaction, type) {
+  state_ = new BufferingTransformationState(max_memory_bytes, spill_directory);
+}
+
+BufferingTransformation::~BufferingTransformation() {
+  delete state_;
+}
+
+void BufferingTransformation::consume(const string &data) {
+  if (state_->failed_) {
+    return;
+  }
+
+  if (state_->fd_ >= 0) {
+    if (writeFully(state_->fd_, data.data(), data.length())) {
+      state_->disk_bytes_ += data.length();
+      disk_bytes_stat.increment(data.length());
+      return;
+    }
+    LOG_ERROR("BufferingTransformation=%p failed writing %lu bytes to temporary file, errno=%d, aborting the transformation.",
+        this, static_cast<unsigned long>(data.length()), errno);
+    state_->failed_ = true;
+    abortOutput();
+    return;
+  }
+
+  state_->memory_buffer_.append(data);
+  memory_bytes_stat.increment(data.length());
+  if (state_->memory_buffer_.length() > state_->max_memory_bytes_) {
+    LOG_DEBUG("BufferingTransformation=%p buffered %lu bytes which exceeds the limit of %lu bytes, spilling to disk.",
+        this, static_cast<unsigned long>(state_->memory_buffer_.length()),
+        static_cast<unsigned long>(state_->max_memory_bytes_));
+    if (!state_->spill()) {
+      // Buffering the rest in memory would make the memory limit meaningless, and retrying on every call
+      // would create a temporary file for each one.
+      LOG_ERROR("BufferingTransformation=%p unable to spill %lu bytes to disk, aborting the transformation.",
+          this, static_cast<unsigned long>(state_->memory_buffer_.length()));
+      state_->failed_ = true;
+      memory_bytes_stat.decrement(state_->memory_buffer_.length());
+      string().swap(state_->memory_buffer_);
+      abortOutput();
+    }
+  }
+}
+
+void BufferingTransformation::handleInputComplete() {
+  if (state_->failed_) {
+    return;
+  }
+
+  if (state_->fd_ < 0) {
+    state_->input_data_ = state_->memory_buffer_.data();
+    state_->input_length_ = state_->memory_buffer_.length();
+    handleBufferedInput(state_->input_data_, state_->input_length_);
+    return;
+  }
+
+  size_t length = static_cast<size_t>(state_->disk_bytes_);
+  if (length == 0) {
+    state_->input_data_ = NULL;
+    state_->input_length_ = 0;
+    handleBufferedInput(NULL, 0);
+    return;
+  }
+
+  void *view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, state_->fd_, 0);
+  if (view == MAP_FAILED) {
+    LOG_ERROR("BufferingTransformation=%p unable to mmap %lu buffered bytes, errno=%d, aborting the transformation.",
+        this, static_cast<unsigned long>(length), errno);
+    state_->failed_ = true;
+    abortOutput();
+    return;
+  }
+
+  madvise(view, length, MADV_SEQUENTIAL);
+  state_->view_ = view;
+  state_->view_length_ = length;
+  state_->input_data_ = static_cast<const char *>(view);
+  state_->input_length_ = length;
+  handleBufferedInput(state_->input_data_, length);
+  if (!state_->forwarding_) {
+    state_->releaseView();
+  }
+}
+
+void BufferingTransformation::produceBufferedInput() {
+  if (state_->forwarding_) {
+    return;
+  }
+  LOG_DEBUG("BufferingTransformation=%p passing on %lu buffered bytes", this,
+      static_cast<unsigned long>(state_->input_length_));
+  state_->forwarding_ = true;
+  state_->forward_offset_ = 0;
+  forwardBufferedInput();
+}
+
+void BufferingTransformation::handleOutputDrained() {
+  if (state_->forwarding_) {
+    forwardBufferedInput();
+  }
+}
+
+void BufferingTransformation::forwardBufferedInput() {
+  size_t round_bytes = 0;
+  while (state_->forward_offset_ < state_->input_length_ && round_bytes < FORWARD_ROUND_BYTES) {
+    size_t chunk = std::min(FORWARD_CHUNK_BYTES, state_->input_length_ - state_->forward_offset_);
+    produce(state_->input_data_ + state_->forward_offset_, chunk);
+    state_->forward_offset_ += chunk;
+    round_bytes += chunk;
+  }
+
+  if (isOutputAborted()) {
+    state_->forwarding_ = false;
+    state_->releaseView();
+    return;
+  }
+
+  if (state_->forward_offset_ == state_->input_length_) {
+    LOG_DEBUG("BufferingTransformation=%p passed on all %lu buffered bytes", this,
+        static_cast<unsigned long>(state_->input_length_));
+    state_->forwarding_ = false;
+    state_->releaseView();
+    setOutputComplete();
+  }
+}
+
+int64_t BufferingTransformation::getBufferedBytes() const {
+  return (state_->fd_ >= 0) ? state_->disk_bytes_ : static_cast<int64_t>(state_->memory_buffer_.length());
+}
+
+bool BufferingTransformation::isSpilledToDisk() const {
+  return state_->fd_ >= 0;
+}
+
+bool BufferingTransformation::initStats(const string &name_prefix) {
+  bool memory_ok = memory_bytes_stat.init(name_prefix + ".memory_bytes", Stat::SYNC_SUM);
+  bool disk_ok = disk_bytes_stat.init(name_prefix + ".disk_bytes", Stat::SYNC_SUM);
+  return memory_ok && disk_ok;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file CompressionDictionary.cc
+ */
+
+#include <fstream>
+#include <sstream>
+#include <zlib.h>
+#include "atscppapi/CompressionDictionary.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using std::string;
+
+CompressionDictionary::CompressionDictionary(const string &data) : data_(data) {
+  id_ = adler32(adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(data_.data()), data_.length());
+  LOG_DEBUG("Created compression dictionary of %lu bytes with id %u", static_cast<unsigned long>(data_.length()), id_);
+}
+
+CompressionDictionary *CompressionDictionary::load(const string &path) {
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if (!file) {
+    LOG_ERROR("Unable to open compression dictionary '%s'", path.c_str());
+    return NULL;
+  }
+
+  std::ostringstream data;
+  data << file.rdbuf();
+  if (file.bad() || data.str().empty()) {
+    LOG_ERROR("Unable to read compression dictionary '%s'", path.c_str());
+    return NULL;
+  }
+
+  LOG_DEBUG("Loaded compression dictionary '%s'", path.c_str());
+  return new CompressionDictionary(data.str());
+}
+
+const string &CompressionDictionary::getData() const {
+  return data_;
+}
+
+uint32_t CompressionDictionary::getId() const {
+  return id_;
+}
+
+CompressionDictionary::~CompressionDictionary() {
+}
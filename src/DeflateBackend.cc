@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file DeflateBackend.cc
+ */
+
+#include <cstdlib>
+#include <string>
+#include <pthread.h>
+#include <zlib.h>
+#include "deflate_backend_internal.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using std::string;
+
+namespace {
+
+const char *DEFLATE_BACKEND_ENV_VAR = "ATSCPPAPI_DEFLATE_BACKEND";
+const int GZIP_WINDOW_BITS_OFFSET = 16; // Adding 16 to the window bits makes zlib read and write a gzip wrapper.
+const int GZIP_INFLATE_WINDOW_BITS = 15 + GZIP_WINDOW_BITS_OFFSET;
+const int AUTODETECT_INFLATE_WINDOW_BITS = 15 + 32; // Adding 32 makes zlib accept either a zlib or gzip header.
+
+struct ZlibApi {
+  typedef z_stream Stream;
+  typedef Bytef *InputPointer;
+  typedef Bytef *OutputPointer;
+  static const int OK = Z_OK;
+  static const int STREAM_END = Z_STREAM_END;
+  static const int BUF_ERROR = Z_BUF_ERROR;
+  static const int NEED_DICT = Z_NEED_DICT;
+  static const int NO_FLUSH = Z_NO_FLUSH;
+  static const int SYNC_FLUSH = Z_SYNC_FLUSH;
+  static const int FINISH = Z_FINISH;
+
+  static int initDeflate(Stream *stream, int level, int window_bits, int mem_level, int strategy) {
+    return ::deflateInit2(stream, level, Z_DEFLATED, window_bits, mem_level, strategy);
+  }
+  static int runDeflate(Stream *stream, int flush) { return ::deflate(stream, flush); }
+  static int endDeflate(Stream *stream) { return ::deflateEnd(stream); }
+  static int setDeflateDictionary(Stream *stream, const Bytef *dictionary, size_t length) {
+    return ::deflateSetDictionary(stream, dictionary, length);
+  }
+  static int initInflate(Stream *stream, int window_bits) { return ::inflateInit2(stream, window_bits); }
+  static int runInflate(Stream *stream, int flush) { return ::inflate(stream, flush); }
+  static int endInflate(Stream *stream) { return ::inflateEnd(stream); }
+  static int setInflateDictionary(Stream *stream, const Bytef *dictionary, size_t length) {
+    return ::inflateSetDictionary(stream, dictionary, length);
+  }
+};
+
+enum Backend {
+  BACKEND_ZLIB = 0,
+  BACKEND_ZLIB_NG
+};
+
+const char *BACKEND_NAMES[] = { "zlib", "zlib-ng" };
+
+pthread_once_t backend_once = PTHREAD_ONCE_INIT;
+Backend backend = BACKEND_ZLIB;
+
+void chooseBackend() {
+#ifdef ATSCPPAPI_HAVE_ZLIB_NG
+  backend = BACKEND_ZLIB_NG;
+#endif
+  const char *requested = getenv(DEFLATE_BACKEND_ENV_VAR);
+  if (requested) {
+    if (string(requested) == BACKEND_NAMES[BACKEND_ZLIB]) {
+      backend = BACKEND_ZLIB;
+#ifdef ATSCPPAPI_HAVE_ZLIB_NG
+    } else if (string(requested) == BACKEND_NAMES[BACKEND_ZLIB_NG]) {
+      backend = BACKEND_ZLIB_NG;
+#endif
+    } else {
+      LOG_ERROR("%s=%s is not an available deflate backend, using %s", DEFLATE_BACKEND_ENV_VAR, requested,
+                BACKEND_NAMES[backend]);
+    }
+  }
+  LOG_DEBUG("Using deflate backend %s", BACKEND_NAMES[backend]);
+}
+
+Backend getBackend() {
+  pthread_once(&backend_once, chooseBackend);
+  return backend;
+}
+
+}
+
+const char *atscppapi::transformations::getDeflateBackendName() {
+  return BACKEND_NAMES[getBackend()];
+}
+
+DeflateStream *atscppapi::transformations::createGzipDeflateStream(int level, int window_bits, int mem_level,
+                                                                   int strategy) {
+#ifdef ATSCPPAPI_HAVE_ZLIB_NG
+  if (getBackend() == BACKEND_ZLIB_NG) {
+    return createZlibNgDeflateStream(level, window_bits + GZIP_WINDOW_BITS_OFFSET, mem_level, strategy, NULL, 0);
+  }
+#endif
+  return createZlibStyleDeflateStream<ZlibApi>("zlib", level, window_bits + GZIP_WINDOW_BITS_OFFSET, mem_level,
+                                               strategy, NULL, 0);
+}
+
+DeflateStream *atscppapi::transformations::createGzipInflateStream() {
+#ifdef ATSCPPAPI_HAVE_ZLIB_NG
+  if (getBackend() == BACKEND_ZLIB_NG) {
+    return createZlibNgInflateStream(GZIP_INFLATE_WINDOW_BITS, NULL, 0);
+  }
+#endif
+  return createZlibStyleInflateStream<ZlibApi>("zlib", GZIP_INFLATE_WINDOW_BITS, NULL, 0);
+}
+
+DeflateStream *atscppapi::transformations::createZlibDeflateStream(int level, int window_bits, int mem_level,
+                                                                   int strategy, const char *dictionary,
+                                                                   size_t dictionary_length) {
+#ifdef ATSCPPAPI_HAVE_ZLIB_NG
+  if (getBackend() == BACKEND_ZLIB_NG) {
+    return createZlibNgDeflateStream(level, window_bits, mem_level, strategy, dictionary, dictionary_length);
+  }
+#endif
+  return createZlibStyleDeflateStream<ZlibApi>("zlib", level, window_bits, mem_level, strategy, dictionary,
+                                               dictionary_length);
+}
+
+DeflateStream *atscppapi::transformations::createZlibInflateStream(const char *dictionary, size_t dictionary_length) {
+#ifdef ATSCPPAPI_HAVE_ZLIB_NG
+  if (getBackend() == BACKEND_ZLIB_NG) {
+    return createZlibNgInflateStream(AUTODETECT_INFLATE_WINDOW_BITS, dictionary, dictionary_length);
+  }
+#endif
+  return createZlibStyleInflateStream<ZlibApi>("zlib", AUTODETECT_INFLATE_WINDOW_BITS, dictionary,
+                                               dictionary_length);
+}
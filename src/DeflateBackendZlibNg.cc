@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file DeflateBackendZlibNg.cc
+ *
+ * This is kept apart from DeflateBackend.cc since zlib.h and zlib-ng.h cannot be included together.
+ */
+
+#include <zlib-ng.h>
+#include "deflate_backend_internal.h"
+
+using namespace atscppapi::transformations;
+
+namespace {
+
+struct ZlibNgApi {
+  typedef zng_stream Stream;
+  typedef const uint8_t *InputPointer;
+  typedef uint8_t *OutputPointer;
+  static const int OK = Z_OK;
+  static const int STREAM_END = Z_STREAM_END;
+  static const int BUF_ERROR = Z_BUF_ERROR;
+  static const int NEED_DICT = Z_NEED_DICT;
+  static const int NO_FLUSH = Z_NO_FLUSH;
+  static const int SYNC_FLUSH = Z_SYNC_FLUSH;
+  static const int FINISH = Z_FINISH;
+
+  static int initDeflate(Stream *stream, int level, int window_bits, int mem_level, int strategy) {
+    return zng_deflateInit2(stream, level, Z_DEFLATED, window_bits, mem_level, strategy);
+  }
+  static int runDeflate(Stream *stream, int flush) { return zng_deflate(stream, flush); }
+  static int endDeflate(Stream *stream) { return zng_deflateEnd(stream); }
+  static int setDeflateDictionary(Stream *stream, const uint8_t *dictionary, size_t length) {
+    return zng_deflateSetDictionary(stream, dictionary, length);
+  }
+  static int initInflate(Stream *stream, int window_bits) { return zng_inflateInit2(stream, window_bits); }
+  static int runInflate(Stream *stream, int flush) { return zng_inflate(stream, flush); }
+  static int endInflate(Stream *stream) { return zng_inflateEnd(stream); }
+  static int setInflateDictionary(Stream *stream, const uint8_t *dictionary, size_t length) {
+    return zng_inflateSetDictionary(stream, dictionary, length);
+  }
+};
+
+}
+
+DeflateStream *atscppapi::transformations::createZlibNgDeflateStream(int level, int window_bits, int mem_level,
+                                                                     int strategy, const char *dictionary,
+                                                                     size_t dictionary_length) {
+  return createZlibStyleDeflateStream<ZlibNgApi>("zlib-ng", level, window_bits, mem_level, strategy, dictionary,
+                                                 dictionary_length);
+}
+
+DeflateStream *atscppapi::transformations::createZlibNgInflateStream(int window_bits, const char *dictionary,
+                                                                     size_t dictionary_length) {
+  return createZlibStyleInflateStream<ZlibNgApi>("zlib-ng", window_bits, dictionary, dictionary_length);
+}
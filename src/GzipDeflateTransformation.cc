@@ -19,54 +19,133 @@
 #include <string>
 #include <cstring>
 #include <vector>
-#include <zlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <memory>
+#include <ts/ts.h>
 #include "atscppapi/TransformationPlugin.h"
 #include "atscppapi/GzipDeflateTransformation.h"
+#include "deflate_backend_internal.h"
 #include "logging_internal.h"
 
 using namespace atscppapi::transformations;
+using std::auto_ptr;
 using std::string;
 using std::vector;
 
 namespace {
-const int GZIP_MEM_LEVEL = 8;
-const int WINDOW_BITS = 31; // Always use 31 for gzip.
-const int ONE_KB = 1024;
+const int DEFAULT_COMPRESSION_LEVEL = -1; // the backend picks its default, which is level 6 for zlib.
+const int ZLIB_DEFAULT_LEVEL = 6;
+const size_t OUTPUT_BUFFER_SIZE = 32 * 1024;
+const int LAG_MONITOR_PERIOD_MS = 100;
+
+pthread_once_t lag_monitor_once = PTHREAD_ONCE_INIT;
+volatile int event_loop_lag_us = -1; // only written by the lag monitor continuation.
+int64_t lag_monitor_last_run_us = 0;
+
+int64_t getMonotonicTimeUs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * Runs every LAG_MONITOR_PERIOD_MS on a net thread, any time beyond the period between two
+ * runs is time the event loop spent doing other work and it is smoothed into event_loop_lag_us.
+ */
+int handleLagMonitorEvents(TSCont contp, TSEvent event, void *edata) {
+  int64_t now = getMonotonicTimeUs();
+  if (lag_monitor_last_run_us) {
+    int64_t lag = now - lag_monitor_last_run_us - LAG_MONITOR_PERIOD_MS * 1000;
+    if (lag < 0) {
+      lag = 0;
+    }
+    int previous_lag = (event_loop_lag_us < 0) ? 0 : event_loop_lag_us;
+    event_loop_lag_us = static_cast<int>((7 * static_cast<int64_t>(previous_lag) + lag) / 8);
+  }
+  lag_monitor_last_run_us = now;
+  return 0;
+}
+
+void startLagMonitor() {
+  LOG_DEBUG("Starting the event loop lag monitor with a period of %dms", LAG_MONITOR_PERIOD_MS);
+  TSCont contp = TSContCreate(handleLagMonitorEvents, TSMutexCreate());
+  TSContScheduleEvery(contp, LAG_MONITOR_PERIOD_MS, TS_THREAD_POOL_DEFAULT);
+}
+
+int chooseCompressionLevel(const GzipDeflateTransformation::Options &options) {
+  if (!options.adaptive_) {
+    return options.level_;
+  }
+
+  int level = (options.level_ == DEFAULT_COMPRESSION_LEVEL) ? ZLIB_DEFAULT_LEVEL : options.level_;
+  pthread_once(&lag_monitor_once, startLagMonitor);
+  int lag_ms = GzipDeflateTransformation::getEventLoopLagMs();
+  if (lag_ms <= options.adaptive_low_lag_ms_ || level <= options.adaptive_min_level_) {
+    return level;
+  }
+  if (lag_ms >= options.adaptive_high_lag_ms_) {
+    return options.adaptive_min_level_;
+  }
+  int range = options.adaptive_high_lag_ms_ - options.adaptive_low_lag_ms_;
+  return level - ((level - options.adaptive_min_level_) * (lag_ms - options.adaptive_low_lag_ms_)) / range;
+}
 }
 
 /**
  * @private
  */
 struct atscppapi::transformations::GzipDeflateTransformationState: noncopyable {
-  z_stream z_stream_;
-  bool z_stream_initialized_;
+  auto_ptr<DeflateStream> stream_;
   int64_t bytes_produced_;
   TransformationPlugin::Type transformation_type_;
+  vector<unsigned char> output_buffer_; // reused by every call to deflate() so we never allocate per chunk.
 
-  GzipDeflateTransformationState(TransformationPlugin::Type type) :
-        z_stream_initialized_(false), transformation_type_(type), bytes_produced_(0) {
+  int level_;
+  GzipDeflateTransformation::Options options_;
+  size_t bytes_since_flush_;
+  int64_t last_flush_us_;
 
-    memset(&z_stream_, 0, sizeof(z_stream_));
-    int err =
-        deflateInit2(&z_stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, WINDOW_BITS , GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+  GzipDeflateTransformationState(TransformationPlugin::Type type, const GzipDeflateTransformation::Options &options) :
+        transformation_type_(type), bytes_produced_(0),
+        output_buffer_(OUTPUT_BUFFER_SIZE), level_(chooseCompressionLevel(options)), options_(options),
+        bytes_since_flush_(0), last_flush_us_(getMonotonicTimeUs()) {
 
-    if (Z_OK != err) {
-      LOG_ERROR("deflateInit2 failed with error code '%d'.", err);
+    if (options.dictionary_) {
+      const string &dictionary = options.dictionary_->getData();
+      stream_.reset(createZlibDeflateStream(level_, options.window_bits_, options.mem_level_, options.strategy_,
+                                            dictionary.data(), dictionary.length()));
     } else {
-      z_stream_initialized_ = true;
+      stream_.reset(createGzipDeflateStream(level_, options.window_bits_, options.mem_level_, options.strategy_));
     }
-  };
-
-  ~GzipDeflateTransformationState() {
-    if (z_stream_initialized_) {
-      deflateEnd(&z_stream_);
+    if (!stream_.get()) {
+      LOG_ERROR("Unable to create a %s deflate stream, level=%d window_bits=%d mem_level=%d strategy=%d.",
+                getDeflateBackendName(), level_, options.window_bits_, options.mem_level_, options.strategy_);
+    } else {
+      LOG_DEBUG("Deflating with %s level=%d window_bits=%d mem_level=%d strategy=%d adaptive=%d dictionary=%u",
+                getDeflateBackendName(), level_, options.window_bits_, options.mem_level_, options.strategy_,
+                options.adaptive_, options.dictionary_ ? options.dictionary_->getId() : 0);
     }
   };
 };
 
 
 GzipDeflateTransformation::GzipDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type) : TransformationPlugin(transaction, type) {
-  state_ = new GzipDeflateTransformationState(type);
+  state_ = new GzipDeflateTransformationState(type, Options());
+}
+
+GzipDeflateTransformation::GzipDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                     const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new GzipDeflateTransformationState(type, options);
+}
+
+int GzipDeflateTransformation::getCompressionLevel() const {
+  return state_->level_;
+}
+
+int GzipDeflateTransformation::getEventLoopLagMs() {
+  int lag_us = event_loop_lag_us;
+  return (lag_us < 0) ? -1 : lag_us / 1000;
 }
 
 GzipDeflateTransformation::~GzipDeflateTransformation() {
@@ -78,70 +157,115 @@ void GzipDeflateTransformation::consume(const string &data) {
     return;
   }
 
-  if (!state_->z_stream_initialized_) {
-    LOG_ERROR("Unable to deflate output because the z_stream was not initialized.");
+  if (!state_->stream_.get()) {
+    LOG_ERROR("Unable to deflate output because the deflate stream was not initialized.");
     return;
   }
 
-  int iteration = 0;
-  state_->z_stream_.data_type = Z_ASCII;
-  state_->z_stream_.next_in = reinterpret_cast<unsigned char *>(const_cast<char *>(data.c_str()));
-  state_->z_stream_.avail_in = data.length();
+  // Unless we're latency sensitive we let zlib hold on to compressed data until enough input
+  // has been compressed or enough time has passed, flushing on every call adds an empty block
+  // marker and emits short fragments when the upstream chunks are small.
+  bool sync_flush = false;
+  state_->bytes_since_flush_ += data.length();
+  if (state_->options_.latency_sensitive_ || state_->bytes_since_flush_ >= state_->options_.flush_bytes_) {
+    sync_flush = true;
+  } else if (state_->options_.flush_interval_ms_ > 0) {
+    int64_t waited_ms = (getMonotonicTimeUs() - state_->last_flush_us_) / 1000;
+    if (waited_ms >= state_->options_.flush_interval_ms_) {
+      sync_flush = true;
+    } else {
+      // If no more input arrives in time the wakeup flushes what zlib is holding on to.
+      scheduleWakeup(static_cast<int>(state_->options_.flush_interval_ms_ - waited_ms));
+    }
+  }
+
+  deflateAndProduce(data.data(), data.length(), sync_flush);
+}
+
+void GzipDeflateTransformation::handleWakeup() {
+  if (!state_->stream_.get() || state_->bytes_since_flush_ == 0) {
+    return;
+  }
+  LOG_DEBUG("Flushing %lu bytes of input that were held back for %dms", static_cast<unsigned long>(state_->bytes_since_flush_),
+            state_->options_.flush_interval_ms_);
+  deflateAndProduce(NULL, 0, true);
+}
 
-  // For small payloads the size can actually be greater than the original input
-  // so we'll use twice the original size to avoid needless repeated calls to deflate.
-  unsigned long buffer_size = data.length() < ONE_KB ? 2 * ONE_KB : data.length();
-  vector<unsigned char> buffer(buffer_size);
+void GzipDeflateTransformation::deflateAndProduce(const char *data, size_t length, bool sync_flush) {
+  DeflateStream::Flush flush = sync_flush ? DeflateStream::FLUSH_SYNC : DeflateStream::FLUSH_NONE;
+  if (sync_flush) {
+    state_->bytes_since_flush_ = 0;
+    state_->last_flush_us_ = getMonotonicTimeUs();
+  }
+
+  int iteration = 0;
+  DeflateStream &stream = *state_->stream_;
+  stream.setInput(data, length);
 
   do {
-    LOG_DEBUG("Iteration %d: Deflate will compress %d bytes", ++iteration, data.size());
-    state_->z_stream_.avail_out = buffer_size;
-    state_->z_stream_.next_out = &buffer[0];
+    LOG_DEBUG("Iteration %d: Deflate will compress %lu bytes, flush=%d", ++iteration, static_cast<unsigned long>(length),
+              flush);
+    stream.setOutput(reinterpret_cast<char *>(&state_->output_buffer_[0]), state_->output_buffer_.size());
 
-    int err = deflate(&state_->z_stream_, Z_SYNC_FLUSH);
-    if (Z_OK != err) {
-      LOG_ERROR("Iteration %d: Deflate failed to compress %d bytes with error code '%d'", iteration, data.size(), err);
+    int err;
+    DeflateStream::Status status = stream.process(flush, err);
+    if (status == DeflateStream::STATUS_BUF_ERROR) {
+      // No progress was possible, the previous pass filled the output buffer exactly.
+      break;
+    }
+    if (status != DeflateStream::STATUS_OK) {
+      LOG_ERROR("Iteration %d: Deflate failed to compress %lu bytes with error code '%d'", iteration,
+                static_cast<unsigned long>(length), err);
       return;
     }
 
-    int bytes_to_write = buffer_size - state_->z_stream_.avail_out;
+    int bytes_to_write = state_->output_buffer_.size() - stream.getAvailableOutput();
     state_->bytes_produced_ += bytes_to_write;
 
-    LOG_DEBUG("Iteration %d: Deflate compressed %d bytes to %d bytes, producing output...", iteration, data.size(), bytes_to_write);
-    produce(string(reinterpret_cast<char *>(&buffer[0]), static_cast<size_t>(bytes_to_write)));
-  } while (state_->z_stream_.avail_out == 0);
+    LOG_DEBUG("Iteration %d: Deflate compressed %lu bytes to %d bytes, producing output...", iteration,
+              static_cast<unsigned long>(length), bytes_to_write);
+    produce(reinterpret_cast<char *>(&state_->output_buffer_[0]), static_cast<size_t>(bytes_to_write));
+  } while (stream.getAvailableOutput() == 0);
 
-  if (state_->z_stream_.avail_in != 0) {
-    LOG_ERROR("Inflate finished with data still remaining in the buffer of size '%d'", state_->z_stream_.avail_in);
+  if (stream.getAvailableInput() != 0) {
+    LOG_ERROR("Inflate finished with data still remaining in the buffer of size '%lu'",
+              static_cast<unsigned long>(stream.getAvailableInput()));
   }
 }
 
 void GzipDeflateTransformation::handleInputComplete() {
+  if (!state_->stream_.get()) {
+    LOG_ERROR("Unable to finish deflating because the deflate stream was not initialized.");
+    setOutputComplete();
+    return;
+  }
+
   // We will flush out anything that's remaining in the gzip buffer
-  int status = Z_OK;
+  state_->bytes_since_flush_ = 0;
+  DeflateStream &stream = *state_->stream_;
+  DeflateStream::Status status = DeflateStream::STATUS_OK;
   int iteration = 0;
-  const int buffer_size = 1024; // 1024 bytes is usually more than enough for the epilouge
-  unsigned char buffer[buffer_size];
+  const int buffer_size = state_->output_buffer_.size();
+  char *buffer = reinterpret_cast<char *>(&state_->output_buffer_[0]);
 
   /* Deflate remaining data */
   do {
     LOG_DEBUG("Iteration %d: Gzip deflate finalizing.", ++iteration);
-    state_->z_stream_.data_type = Z_ASCII;
-    state_->z_stream_.avail_out = buffer_size;
-    state_->z_stream_.next_out = buffer;
+    stream.setOutput(buffer, buffer_size);
 
-    status = deflate(&state_->z_stream_, Z_FINISH);
+    int err;
+    status = stream.process(DeflateStream::FLUSH_FINISH, err);
 
-    int bytes_to_write = buffer_size - state_->z_stream_.avail_out;
+    int bytes_to_write = buffer_size - stream.getAvailableOutput();
     state_->bytes_produced_ += bytes_to_write;
 
-    if (status == Z_OK || status == Z_STREAM_END) {
-      LOG_DEBUG("Iteration %d: Gzip deflate finalize had an extra %d bytes to process, status '%d'. Producing output...", iteration, bytes_to_write, status);
-      produce(string(reinterpret_cast<char *>(buffer), static_cast<size_t>(bytes_to_write)));
-    } else if (status != Z_STREAM_END) {
-      LOG_ERROR("Iteration %d: Gzip deflinate finalize produced an error '%d'", iteration, status);
+    if (status == DeflateStream::STATUS_OK || status == DeflateStream::STATUS_STREAM_END) {
+      LOG_DEBUG("Iteration %d: Gzip deflate finalize had an extra %d bytes to process, status '%d'. Producing output...", iteration, bytes_to_write, err);
+      produce(buffer, static_cast<size_t>(bytes_to_write));
+    } else {
+      LOG_ERROR("Iteration %d: Gzip deflinate finalize produced an error '%d'", iteration, err);
     }
-  } while (status == Z_OK);
+  } while (status == DeflateStream::STATUS_OK);
 
   int64_t bytes_written = setOutputComplete();
   if (state_->bytes_produced_ != bytes_written) {
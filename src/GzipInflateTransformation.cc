@@ -19,55 +19,65 @@
 #include <string>
 #include <cstring>
 #include <vector>
-#include <zlib.h>
+#include <memory>
 #include "atscppapi/TransformationPlugin.h"
 #include "atscppapi/GzipInflateTransformation.h"
+#include "deflate_backend_internal.h"
 #include "logging_internal.h"
 
 using namespace atscppapi::transformations;
+using std::auto_ptr;
 using std::string;
 using std::vector;
 
 namespace {
-const int WINDOW_BITS = 31; // Always use 31 for gzip.
-unsigned int INFLATE_SCALE_FACTOR = 6;
+const size_t INFLATE_BUFFER_SIZE = 32 * 1024;
+const int64_t EXPANSION_RATIO_MIN_OUTPUT = 1024 * 1024;
 }
 
 /**
  * @private
  */
 struct atscppapi::transformations::GzipInflateTransformationState: noncopyable {
-  z_stream z_stream_;
-  bool z_stream_initialized_;
+  auto_ptr<DeflateStream> stream_;
   int64_t bytes_produced_;
+  int64_t bytes_consumed_;
   TransformationPlugin::Type transformation_type_;
-
-  GzipInflateTransformationState(TransformationPlugin::Type type) :
-        z_stream_initialized_(false), transformation_type_(type), bytes_produced_(0) {
-
-    memset(&z_stream_, 0, sizeof(z_stream_));
-
-    int err = inflateInit2(&z_stream_, WINDOW_BITS);
-    if (Z_OK != err) {
-      LOG_ERROR("inflateInit2 failed with error code '%d'.", err);
-    } else {
-      z_stream_initialized_ = true;
+  GzipInflateTransformation::Options options_;
+  vector<char> buffer_; // every call to inflate() reuses this buffer.
+  bool finished_; // inflate() reached the end of the compressed stream.
+  bool aborted_;
+
+  GzipInflateTransformationState(TransformationPlugin::Type type, const GzipInflateTransformation::Options &options) :
+        stream_(createStream(options)), transformation_type_(type), bytes_produced_(0), bytes_consumed_(0),
+        options_(options), buffer_(INFLATE_BUFFER_SIZE), finished_(false),
+        aborted_(false) {
+    if (!stream_.get()) {
+      LOG_ERROR("Unable to create a %s inflate stream.", getDeflateBackendName());
     }
   };
 
-  ~GzipInflateTransformationState() {
-    if (z_stream_initialized_) {
-      int err = inflateEnd(&z_stream_);
-      if (Z_OK != err && Z_STREAM_END != err) {
-        LOG_ERROR("Unable to inflateEnd(), returned error code '%d'", err);
-      }
+  static DeflateStream *createStream(const GzipInflateTransformation::Options &options) {
+    if (options.dictionary_) {
+      const string &dictionary = options.dictionary_->getData();
+      return createZlibInflateStream(dictionary.data(), dictionary.length());
     }
-  };
+    return createGzipInflateStream();
+  }
 };
 
 
 GzipInflateTransformation::GzipInflateTransformation(Transaction &transaction, TransformationPlugin::Type type) : TransformationPlugin(transaction, type) {
-  state_ = new GzipInflateTransformationState(type);
+  state_ = new GzipInflateTransformationState(type, Options());
+}
+
+GzipInflateTransformation::GzipInflateTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                     const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new GzipInflateTransformationState(type, options);
+}
+
+bool GzipInflateTransformation::isAborted() const {
+  return state_->aborted_;
 }
 
 GzipInflateTransformation::~GzipInflateTransformation() {
@@ -75,52 +85,97 @@ GzipInflateTransformation::~GzipInflateTransformation() {
 }
 
 void GzipInflateTransformation::consume(const string &data) {
-  if (data.size() == 0) {
+  if (data.size() == 0 || state_->aborted_) {
     return;
   }
 
-  if (!state_->z_stream_initialized_) {
-    LOG_ERROR("Unable to inflate output because the z_stream was not initialized.");
+  if (!state_->stream_.get()) {
+    LOG_ERROR("Unable to inflate output because the inflate stream was not initialized, aborting the output.");
+    state_->aborted_ = true;
+    abortOutput();
     return;
   }
 
-  int err = Z_OK;
+  DeflateStream &stream = *state_->stream_;
+  DeflateStream::Status status = DeflateStream::STATUS_OK;
+  int err;
   int iteration = 0;
-  int inflate_block_size = INFLATE_SCALE_FACTOR * data.size();
-  vector<char> buffer(inflate_block_size);
+  const int inflate_block_size = state_->buffer_.size();
+  char *buffer = &state_->buffer_[0];
+  state_->bytes_consumed_ += data.length();
 
   // Setup the compressed input
-  state_->z_stream_.next_in = reinterpret_cast<unsigned char *>(const_cast<char *>(data.c_str()));
-  state_->z_stream_.avail_in = data.length();
+  stream.setInput(data.data(), data.length());
 
-  // Loop while we have more data to inflate
-  while (state_->z_stream_.avail_in > 0 && err != Z_STREAM_END) {
-    LOG_DEBUG("Iteration %d: Gzip has %d bytes to inflate", ++iteration, state_->z_stream_.avail_in);
+  // Loop while we have more data to inflate or inflate filled our buffer and may have more output.
+  do {
+    LOG_DEBUG("Iteration %d: Gzip has %lu bytes to inflate", ++iteration,
+              static_cast<unsigned long>(stream.getAvailableInput()));
 
     // Setup where the decompressed output will go.
-    state_->z_stream_.next_out = reinterpret_cast<unsigned char *>(&buffer[0]);
-    state_->z_stream_.avail_out = inflate_block_size;
+    stream.setOutput(buffer, inflate_block_size);
 
     /* Uncompress */
-    err = inflate(&state_->z_stream_, Z_SYNC_FLUSH);
+    status = stream.process(DeflateStream::FLUSH_SYNC, err);
 
-    if (err != Z_OK && err != Z_STREAM_END) {
-     LOG_ERROR("Iteration %d: Inflate failed with error '%d'", iteration, err);
+    if (status == DeflateStream::STATUS_BUF_ERROR) {
+      // No progress was possible, the previous pass filled the output buffer exactly.
+      break;
+    }
+
+    if (status == DeflateStream::STATUS_ERROR) {
+     LOG_ERROR("Iteration %d: Inflate failed with error '%d', aborting the output", iteration, err);
+     state_->aborted_ = true;
+     abortOutput();
      return;
     }
 
-    LOG_DEBUG("Iteration %d: Gzip inflated a total of %d bytes, producingOutput...", iteration, (inflate_block_size - state_->z_stream_.avail_out));
-    produce(string(&buffer[0], (inflate_block_size - state_->z_stream_.avail_out)));
-    state_->bytes_produced_ += (inflate_block_size - state_->z_stream_.avail_out);
-  }
+    int64_t inflated_bytes = inflate_block_size - stream.getAvailableOutput();
+    int64_t total_inflated_bytes = state_->bytes_produced_ + inflated_bytes;
+    const Options &options = state_->options_;
+    if ((options.max_output_bytes_ > 0 && total_inflated_bytes > options.max_output_bytes_) ||
+        (options.max_expansion_ratio_ > 0 && total_inflated_bytes > EXPANSION_RATIO_MIN_OUTPUT &&
+         total_inflated_bytes > options.max_expansion_ratio_ * state_->bytes_consumed_)) {
+      LOG_ERROR("Aborting inflate after %lld compressed bytes inflated to %lld bytes, max output bytes=%lld "
+                "max expansion ratio=%d", static_cast<long long>(state_->bytes_consumed_),
+                static_cast<long long>(total_inflated_bytes), static_cast<long long>(options.max_output_bytes_),
+                options.max_expansion_ratio_);
+      state_->aborted_ = true;
+      if (options.aborted_stat_) {
+        options.aborted_stat_->increment();
+      }
+      abortOutput();
+      return;
+    }
+
+    LOG_DEBUG("Iteration %d: Gzip inflated a total of %lld bytes, producingOutput...", iteration,
+              static_cast<long long>(inflated_bytes));
+    produce(buffer, inflated_bytes);
+    state_->bytes_produced_ += inflated_bytes;
+    if (status == DeflateStream::STATUS_STREAM_END) {
+      state_->finished_ = true;
+    }
+  } while ((stream.getAvailableInput() > 0 || stream.getAvailableOutput() == 0) &&
+           status != DeflateStream::STATUS_STREAM_END);
 }
 
 void GzipInflateTransformation::handleInputComplete() {
+  if (state_->aborted_) {
+    // The output was aborted, it must not be completed.
+    return;
+  }
+
+  // An empty body is passed through, anything else must have reached the end of the stream.
+  if (!state_->finished_ && state_->bytes_consumed_ > 0) {
+    LOG_ERROR("Gzip stream was truncated after %lld compressed bytes, aborting the output",
+              static_cast<long long>(state_->bytes_consumed_));
+    state_->aborted_ = true;
+    abortOutput();
+    return;
+  }
+
   int64_t bytes_written = setOutputComplete();
   if (state_->bytes_produced_ != bytes_written) {
     LOG_ERROR("Gzip bytes produced sanity check failed, inflated bytes = %d != written bytes = %d", state_->bytes_produced_, bytes_written);
   }
 }
-
-
-
@@ -21,6 +21,7 @@
 #include <ts/ts.h>
 #include "atscppapi/noncopyable.h"
 #include <cctype>
+#include <cstdlib>
 
 using atscppapi::Headers;
 using std::string;
@@ -49,6 +50,7 @@ struct HeadersState: noncopyable {
   bool detached_;
   InitializableValue<Headers::RequestCookieMap> request_cookies_;
   InitializableValue<list<Headers::ResponseCookie> > response_cookies_;
+  InitializableValue<Headers::AcceptEncodingList> accept_encoding_;
   HeadersState(Headers::Type type) : type_(type), hdr_buf_(NULL), hdr_loc_(NULL), detached_(false) { }
 };
 
@@ -151,10 +153,14 @@ Headers::size_type Headers::erase(const string &k) {
   if (!checkAndInitHeaders()) {
     return 0;
   }
-  if ((state_->type_ == TYPE_REQUEST) && (CaseInsensitiveStringComparator()(k, "Cookie") == 0)) {
+  if ((state_->type_ == TYPE_REQUEST) && (CaseInsensitiveStringComparator().compare(k, "Cookie") == 0)) {
     state_->request_cookies_.getValueRef().clear();
     state_->request_cookies_.setInitialized(false);
-  } else if ((state_->type_ == TYPE_RESPONSE) && (CaseInsensitiveStringComparator()(k, "Set-Cookie") == 0)) {
+  } else if ((state_->type_ == TYPE_REQUEST) &&
+             (CaseInsensitiveStringComparator().compare(k, "Accept-Encoding") == 0)) {
+    state_->accept_encoding_.getValueRef().clear();
+    state_->accept_encoding_.setInitialized(false);
+  } else if ((state_->type_ == TYPE_RESPONSE) && (CaseInsensitiveStringComparator().compare(k, "Set-Cookie") == 0)) {
     state_->response_cookies_.getValueRef().clear();
     state_->response_cookies_.setInitialized(false);
   }
@@ -195,11 +201,15 @@ Headers::const_iterator Headers::append(const pair<string, list<string> > &pair)
   if (!checkAndInitHeaders()) {
     return state_->name_values_map_.getValueRef().end();
   }
-  if ((state_->type_ == TYPE_REQUEST) && (CaseInsensitiveStringComparator()(pair.first, "Cookie") == 0)) {
+  if ((state_->type_ == TYPE_REQUEST) && (CaseInsensitiveStringComparator().compare(pair.first, "Cookie") == 0)) {
     state_->request_cookies_.getValueRef().clear();
     state_->request_cookies_.setInitialized(false);
+  } else if ((state_->type_ == TYPE_REQUEST) &&
+             (CaseInsensitiveStringComparator().compare(pair.first, "Accept-Encoding") == 0)) {
+    state_->accept_encoding_.getValueRef().clear();
+    state_->accept_encoding_.setInitialized(false);
   } else if ((state_->type_ == TYPE_RESPONSE) &&
-             (CaseInsensitiveStringComparator()(pair.first, "Set-Cookie") == 0)) {
+             (CaseInsensitiveStringComparator().compare(pair.first, "Set-Cookie") == 0)) {
     state_->response_cookies_.getValueRef().clear();
     state_->response_cookies_.setInitialized(false);
   }
@@ -432,6 +442,134 @@ const list<Headers::ResponseCookie> &Headers::getResponseCookies() const {
   return state_->response_cookies_;
 }
 
+namespace {
+
+bool compareAcceptEncodingQuality(const Headers::AcceptEncoding &a, const Headers::AcceptEncoding &b) {
+  return a.q_ > b.q_;
+}
+
+/**
+ * Parses a single "coding;q=0.5" element of an Accept-Encoding header, returns false if it's malformed.
+ */
+bool parseAcceptEncoding(const string &element, Headers::AcceptEncoding &accept_encoding) {
+  size_t params_pos = element.find(';');
+  accept_encoding.coding_.assign(element, 0, params_pos);
+  stripEnclosingWhitespace(accept_encoding.coding_);
+  if (accept_encoding.coding_.empty()) {
+    return false;
+  }
+  for (size_t i = 0; i < accept_encoding.coding_.size(); ++i) {
+    accept_encoding.coding_[i] = std::tolower(accept_encoding.coding_[i]);
+  }
+  if (accept_encoding.coding_ == "x-gzip") {
+    accept_encoding.coding_ = "gzip";
+  }
+
+  accept_encoding.q_ = 1.0f;
+  while (params_pos != string::npos) {
+    size_t param_start = params_pos + 1;
+    params_pos = element.find(';', param_start);
+    string param(element, param_start, (params_pos == string::npos) ? string::npos : params_pos - param_start);
+    stripEnclosingWhitespace(param);
+    if (param.size() < 2 || std::tolower(param[0]) != 'q' || param[1] != '=') {
+      continue; // not a quality value
+    }
+    const char *q_start = param.c_str() + 2;
+    char *q_end = NULL;
+    double q = strtod(q_start, &q_end);
+    if (q_end == q_start || *q_end != '\0' || q < 0 || q > 1) {
+      return false;
+    }
+    accept_encoding.q_ = static_cast<float>(q);
+  }
+  return true;
+}
+
+}
+
+const Headers::AcceptEncodingList &Headers::getAcceptEncoding() const {
+  if (state_->type_ != Headers::TYPE_REQUEST) {
+    LOG_ERROR("Object is not of type request. Returning empty list");
+    return state_->accept_encoding_;
+  }
+  if (state_->accept_encoding_.isInitialized() || !checkAndInitHeaders()) {
+    return state_->accept_encoding_;
+  }
+  state_->accept_encoding_.setInitialized();
+  const_iterator iter = find("Accept-Encoding");
+  if (iter != end()) {
+    AcceptEncodingList &accept_encodings = state_->accept_encoding_.getValueRef();
+    for (list<string>::const_iterator value_iter = iter->second.begin(), value_end = iter->second.end();
+         value_iter != value_end; ++value_iter) {
+      const string &value = *value_iter;
+      size_t start_pos = 0;
+      while (start_pos <= value.size()) {
+        size_t end_pos = value.find(',', start_pos);
+        if (end_pos == string::npos) {
+          end_pos = value.size();
+        }
+        AcceptEncoding accept_encoding;
+        string element(value, start_pos, end_pos - start_pos);
+        if (parseAcceptEncoding(element, accept_encoding)) {
+          accept_encodings.push_back(accept_encoding);
+        } else if (element.find_first_not_of(" \t") != string::npos) {
+          LOG_DEBUG("Ignoring malformed Accept-Encoding element [%s]", element.c_str());
+        }
+        start_pos = end_pos + 1;
+      }
+    }
+    accept_encodings.sort(compareAcceptEncodingQuality); // list::sort is stable
+  }
+  return state_->accept_encoding_;
+}
+
+string Headers::negotiateAcceptEncoding(const list<string> &supported) const {
+  const AcceptEncodingList &accept_encodings = getAcceptEncoding();
+  if (accept_encodings.empty()) {
+    // Without an Accept-Encoding header we don't assume the client can decode anything.
+    return "identity";
+  }
+
+  float wildcard_q = -1;
+  float identity_q = -1;
+  for (AcceptEncodingList::const_iterator iter = accept_encodings.begin(); iter != accept_encodings.end(); ++iter) {
+    if (iter->coding_ == "*" && wildcard_q < 0) {
+      wildcard_q = iter->q_;
+    } else if (iter->coding_ == "identity" && identity_q < 0) {
+      identity_q = iter->q_;
+    }
+  }
+
+  string best_coding;
+  float best_q = 0;
+  for (list<string>::const_iterator supported_iter = supported.begin(); supported_iter != supported.end();
+       ++supported_iter) {
+    float q = -1;
+    for (AcceptEncodingList::const_iterator iter = accept_encodings.begin(); iter != accept_encodings.end(); ++iter) {
+      if (CaseInsensitiveStringComparator().compare(iter->coding_, *supported_iter) == 0) {
+        q = iter->q_;
+        break;
+      }
+    }
+    if (q < 0) {
+      q = (wildcard_q < 0) ? 0 : wildcard_q;
+    }
+    if (q > best_q) {
+      best_q = q;
+      best_coding = *supported_iter;
+    }
+  }
+  if (!best_coding.empty()) {
+    return best_coding;
+  }
+
+  // Identity is acceptable unless it, or the wildcard when identity isn't listed, has a q of 0.
+  if (identity_q > 0 || (identity_q < 0 && wildcard_q != 0)) {
+    return "identity";
+  }
+  return string();
+}
+
 bool Headers::addCookie(const string &name, const string &value) {
   if (state_->type_ != Headers::TYPE_REQUEST) {
     LOG_ERROR("Cannot add request cookie to response headers");
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Histogram.cc
+ */
+
+#include "atscppapi/Histogram.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <pthread.h>
+#include "atscppapi/AsyncTimer.h"
+#include "atscppapi/Mutex.h"
+#include "atscppapi/Stat.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Values below SUB_BUCKET_COUNT get a bucket each, above that each power of two gets HALF_SUB_BUCKET_COUNT buckets.
+const int SUB_BUCKET_BITS = 6;
+const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+const int HALF_SUB_BUCKET_COUNT = SUB_BUCKET_COUNT / 2;
+const int BUCKET_COUNT = SUB_BUCKET_COUNT + (63 - SUB_BUCKET_BITS) * HALF_SUB_BUCKET_COUNT;
+const int MAX_HISTOGRAMS = 256;
+const size_t CACHE_LINE_SIZE = 64;
+
+int getBucketIndex(int64_t value) {
+  if (value < SUB_BUCKET_COUNT) {
+    return (value < 0) ? 0 : static_cast<int>(value);
+  }
+  int exponent = 63 - __builtin_clzll(value);
+  int shift = exponent - (SUB_BUCKET_BITS - 1);
+  return SUB_BUCKET_COUNT + (exponent - SUB_BUCKET_BITS) * HALF_SUB_BUCKET_COUNT +
+         static_cast<int>((value >> shift) - HALF_SUB_BUCKET_COUNT);
+}
+
+/**
+ * @return the largest value that is counted in a bucket.
+ */
+int64_t getBucketValue(int index) {
+  if (index < SUB_BUCKET_COUNT) {
+    return index;
+  }
+  int exponent = (index - SUB_BUCKET_COUNT) / HALF_SUB_BUCKET_COUNT + SUB_BUCKET_BITS;
+  uint64_t mantissa = (index - SUB_BUCKET_COUNT) % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT;
+  return static_cast<int64_t>(((mantissa + 1) << (exponent - (SUB_BUCKET_BITS - 1))) - 1);
+}
+
+/**
+ * One thread's buckets for one Histogram, only the owning thread writes them.
+ */
+struct HistogramShard {
+  volatile uint64_t counts_[BUCKET_COUNT];
+};
+
+/**
+ * A thread's shards of every Histogram, indexed by the Histogram's slot.
+ */
+struct ThreadHistogramShards {
+  HistogramShard *shards_[MAX_HISTOGRAMS];
+};
+
+pthread_once_t thread_shards_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t thread_shards_key;
+volatile int histogram_slot_count = 0;
+
+void deleteThreadShards(void *thread_shards) {
+  // The shards themselves belong to their Histograms, they still have to be merged after the thread exits.
+  delete static_cast<ThreadHistogramShards *>(thread_shards);
+}
+
+void createThreadShardsKey() {
+  pthread_key_create(&thread_shards_key, deleteThreadShards);
+}
+
+class HistogramExporter;
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::HistogramState : noncopyable {
+  string name_;
+  int slot_;
+  Mutex shards_mutex_;
+  vector<HistogramShard *> shards_;
+  vector<uint64_t> exported_counts_; // the merged counts at the previous export.
+  Stat p50_stat_;
+  Stat p90_stat_;
+  Stat p99_stat_;
+  Stat p999_stat_;
+  Stat max_stat_;
+  Stat count_stat_;
+  AsyncTimer *timer_;
+  HistogramExporter *exporter_;
+  HistogramState() : slot_(-1), exported_counts_(BUCKET_COUNT), timer_(NULL), exporter_(NULL) { }
+};
+
+namespace {
+
+HistogramShard *getShard(HistogramState *state) {
+  ThreadHistogramShards *thread_shards = static_cast<ThreadHistogramShards *>(pthread_getspecific(thread_shards_key));
+  if (!thread_shards) {
+    thread_shards = new ThreadHistogramShards();
+    memset(thread_shards->shards_, 0, sizeof(thread_shards->shards_));
+    pthread_setspecific(thread_shards_key, thread_shards);
+  }
+
+  HistogramShard *shard = thread_shards->shards_[state->slot_];
+  if (!shard) {
+    void *memory = NULL;
+    // Aligned so two threads' shards never share a cache line.
+    if (posix_memalign(&memory, CACHE_LINE_SIZE, sizeof(HistogramShard)) != 0) {
+      abort();
+    }
+    memset(memory, 0, sizeof(HistogramShard));
+    shard = static_cast<HistogramShard *>(memory);
+    thread_shards->shards_[state->slot_] = shard;
+    ScopedMutexLock lock(state->shards_mutex_);
+    state->shards_.push_back(shard);
+  }
+  return shard;
+}
+
+/**
+ * Adds up the buckets of every thread, the threads keep recording while their buckets are read.
+ */
+void mergeShards(HistogramState *state, vector<uint64_t> &counts) {
+  vector<HistogramShard *> shards;
+  {
+    ScopedMutexLock lock(state->shards_mutex_);
+    shards = state->shards_;
+  }
+  counts.assign(BUCKET_COUNT, 0);
+  for (vector<HistogramShard *>::const_iterator iter = shards.begin(); iter != shards.end(); ++iter) {
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+      counts[i] += (*iter)->counts_[i];
+    }
+  }
+}
+
+int64_t getPercentileValue(const vector<uint64_t> &counts, uint64_t total, double percentile) {
+  if (!total) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(ceil(total * percentile / 100.0));
+  if (rank < 1) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return getBucketValue(i);
+    }
+  }
+  return getBucketValue(BUCKET_COUNT - 1);
+}
+
+void exportPercentiles(HistogramState *state) {
+  vector<uint64_t> counts;
+  mergeShards(state, counts);
+  uint64_t total = 0;
+  int64_t max = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i) {
+    uint64_t merged = counts[i];
+    counts[i] -= state->exported_counts_[i];
+    state->exported_counts_[i] = merged;
+    if (counts[i]) {
+      total += counts[i];
+      max = getBucketValue(i);
+    }
+  }
+
+  state->p50_stat_.set(getPercentileValue(counts, total, 50));
+  state->p90_stat_.set(getPercentileValue(counts, total, 90));
+  state->p99_stat_.set(getPercentileValue(counts, total, 99));
+  state->p999_stat_.set(getPercentileValue(counts, total, 99.9));
+  state->max_stat_.set(max);
+  state->count_stat_.set(static_cast<int64_t>(total));
+  LOG_DEBUG("Exported %llu values of histogram '%s'", static_cast<unsigned long long>(total), state->name_.c_str());
+}
+
+class HistogramExporter : public AsyncReceiver<AsyncTimer> {
+public:
+  HistogramExporter(HistogramState *state) : state_(state) { }
+
+  void handleAsyncComplete(AsyncTimer &timer) {
+    exportPercentiles(state_);
+  }
+private:
+  HistogramState *state_;
+};
+
+}
+
+Histogram::Histogram() {
+  state_ = new HistogramState();
+}
+
+Histogram::~Histogram() {
+  delete state_->timer_;
+  delete state_->exporter_;
+  for (vector<HistogramShard *>::iterator iter = state_->shards_.begin(); iter != state_->shards_.end(); ++iter) {
+    free(*iter);
+  }
+  delete state_;
+}
+
+bool Histogram::init(const string &name, int export_interval_ms) {
+  if (state_->slot_ >= 0) {
+    LOG_ERROR("Attempt to reinitialize histogram '%s' as '%s'", state_->name_.c_str(), name.c_str());
+    return false;
+  }
+
+  // The slot is reserved first so a histogram over the limit doesn't create its stats, and the count never
+  // passes MAX_HISTOGRAMS. A slot whose stats can't be created below is not given back.
+  int slot = histogram_slot_count;
+  while (true) {
+    if (slot >= MAX_HISTOGRAMS) {
+      LOG_ERROR("Unable to create histogram '%s', the limit of %d histograms was reached", name.c_str(),
+                MAX_HISTOGRAMS);
+      return false;
+    }
+    int seen = __sync_val_compare_and_swap(&histogram_slot_count, slot, slot + 1);
+    if (seen == slot) {
+      break;
+    }
+    slot = seen;
+  }
+
+  // The percentiles are set rather than incremented, SYNC_SUM stats publish the value that is set.
+  if (!state_->p50_stat_.init(name + ".p50", Stat::SYNC_SUM) ||
+      !state_->p90_stat_.init(name + ".p90", Stat::SYNC_SUM) ||
+      !state_->p99_stat_.init(name + ".p99", Stat::SYNC_SUM) ||
+      !state_->p999_stat_.init(name + ".p999", Stat::SYNC_SUM) ||
+      !state_->max_stat_.init(name + ".max", Stat::SYNC_SUM) ||
+      !state_->count_stat_.init(name + ".count", Stat::SYNC_SUM)) {
+    LOG_ERROR("Unable to create the stats of histogram '%s'", name.c_str());
+    return false;
+  }
+
+  pthread_once(&thread_shards_key_once, createThreadShardsKey);
+  state_->name_ = name;
+  state_->slot_ = slot;
+
+  state_->exporter_ = new HistogramExporter(state_);
+  state_->timer_ = new AsyncTimer(AsyncTimer::TYPE_PERIODIC, export_interval_ms);
+  Async::execute<AsyncTimer>(state_->exporter_, state_->timer_, shared_ptr<Mutex>());
+  LOG_DEBUG("Created histogram '%s' in slot %d, exporting every %dms", name.c_str(), slot, export_interval_ms);
+  return true;
+}
+
+void Histogram::record(int64_t value) {
+  if (state_->slot_ < 0) {
+    return;
+  }
+
+  ++getShard(state_)->counts_[getBucketIndex(value)];
+}
+
+int64_t Histogram::getPercentile(double percentile) const {
+  if (state_->slot_ < 0) {
+    return 0;
+  }
+
+  vector<uint64_t> counts;
+  mergeShards(state_, counts);
+  uint64_t total = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i) {
+    total += counts[i];
+  }
+  return getPercentileValue(counts, total, percentile);
+}
@@ -25,14 +25,116 @@
 #include <cstdio>
 #include <string>
 #include <cstring>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #include <ts/ts.h>
 #include "atscppapi/noncopyable.h"
+#include "atscppapi/Mutex.h"
 #include "logging_internal.h"
 
 using std::vector;
 using std::string;
 
 using atscppapi::Logger;
+using atscppapi::Mutex;
+using atscppapi::ScopedMutexLock;
+
+namespace {
+
+const uint32_t RING_WRAP_MARKER = 0xFFFFFFFF;
+const size_t MIN_RING_BYTES = 64 * 1024;
+const useconds_t BLOCKED_WRITER_SLEEP_US = 100;
+// TSTextLogObjectWrite formats each entry into a fixed 16KB buffer, which also holds the timestamp and
+// the newline, and truncates anything longer.
+const size_t MAX_TEXT_LOG_ENTRY_BYTES = 16 * 1024 - 128;
+
+/**
+ * Writes a message as one text log entry, or as consecutive entries of at most MAX_TEXT_LOG_ENTRY_BYTES
+ * if it wouldn't fit in one. The message doesn't have to be null terminated.
+ */
+void writeTextLogEntries(TSTextLogObject text_log_obj, const char *message, size_t length) {
+  do {
+    size_t entry_length = (length > MAX_TEXT_LOG_ENTRY_BYTES) ? MAX_TEXT_LOG_ENTRY_BYTES : length;
+    TSTextLogObjectWrite(text_log_obj, const_cast<char *>("%.*s"), static_cast<int>(entry_length), message);
+    message += entry_length;
+    length -= entry_length;
+  } while (length);
+}
+
+size_t alignRecord(size_t length) {
+  return (length + 3) & ~static_cast<size_t>(3);
+}
+
+/**
+ * A single producer single consumer ring of length prefixed messages. The thread that owns the ring
+ * is the only one that moves head_ and the background thread is the only one that moves tail_, both
+ * only ever grow and are published with a full barrier after the data they cover.
+ */
+struct LogRing : atscppapi::noncopyable {
+  vector<char> buffer_;
+  size_t mask_;
+  volatile uint64_t head_;
+  volatile uint64_t tail_;
+  volatile uint64_t dropped_; // only written by the producer.
+  uint64_t dropped_reported_; // only used by the consumer.
+  uint64_t overflows_; // only used by the producer.
+
+  LogRing(size_t size) : buffer_(size), mask_(size - 1), head_(0), tail_(0), dropped_(0), dropped_reported_(0),
+                         overflows_(0) { }
+
+  /**
+   * @return false if there isn't enough free space for the message.
+   */
+  bool push(const char *message, size_t length) {
+    size_t record_length = alignRecord(sizeof(uint32_t) + length);
+    uint64_t head = head_;
+    size_t position = head & mask_;
+    size_t contiguous = buffer_.size() - position;
+    size_t skip = (contiguous < record_length) ? contiguous : 0;
+    if (record_length + skip > buffer_.size() - (head - tail_)) {
+      return false;
+    }
+
+    if (skip) {
+      memcpy(&buffer_[position], &RING_WRAP_MARKER, sizeof(uint32_t));
+      position = 0;
+    }
+    uint32_t message_length = length;
+    memcpy(&buffer_[position], &message_length, sizeof(uint32_t));
+    memcpy(&buffer_[position + sizeof(uint32_t)], message, length);
+    __sync_synchronize();
+    head_ = head + skip + record_length;
+    return true;
+  }
+
+  /**
+   * @return the number of messages written to text_log_obj.
+   */
+  int drain(TSTextLogObject text_log_obj) {
+    uint64_t head = head_;
+    __sync_synchronize();
+    uint64_t tail = tail_;
+    int count = 0;
+    while (tail != head) {
+      size_t position = tail & mask_;
+      uint32_t message_length;
+      memcpy(&message_length, &buffer_[position], sizeof(uint32_t));
+      if (message_length == RING_WRAP_MARKER) {
+        tail += buffer_.size() - position;
+        continue;
+      }
+      writeTextLogEntries(text_log_obj, &buffer_[position + sizeof(uint32_t)], message_length);
+      tail += alignRecord(sizeof(uint32_t) + message_length);
+      ++count;
+    }
+    __sync_synchronize();
+    tail_ = tail;
+    return count;
+  }
+};
+
+}
 
 /**
  * @private
@@ -47,8 +149,19 @@ struct atscppapi::LoggerState: noncopyable  {
   TSTextLogObject text_log_obj_;
   bool initialized_;
 
+  volatile bool async_;
+  Logger::AsyncOptions async_options_;
+  size_t ring_bytes_;
+  pthread_key_t ring_key_;
+  Mutex rings_mutex_; // protects rings_, which only grows while the logger is async.
+  vector<LogRing *> rings_;
+  volatile bool flush_requested_;
+  volatile bool drain_stop_;
+  volatile bool drain_stopped_;
+
   LoggerState() : add_timestamp_(false), rename_file_(false), level_(Logger::LOG_LEVEL_NO_LOG), rolling_enabled_(false),
-                  rolling_interval_seconds_(-1), text_log_obj_(NULL), initialized_(false) { };
+                  rolling_interval_seconds_(-1), text_log_obj_(NULL), initialized_(false), async_(false),
+                  ring_bytes_(0), flush_requested_(false), drain_stop_(false), drain_stopped_(false) { };
   ~LoggerState() { };
 };
 
@@ -67,6 +180,17 @@ Logger::Logger() {
 }
 
 Logger::~Logger() {
+  if (state_->async_) {
+    state_->drain_stop_ = true;
+    while (!state_->drain_stopped_) {
+      usleep(1000);
+    }
+    for (vector<LogRing *>::iterator iter = state_->rings_.begin(); iter != state_->rings_.end(); ++iter) {
+      delete *iter;
+    }
+    pthread_key_delete(state_->ring_key_);
+  }
+
   if (state_->initialized_ && state_->text_log_obj_) {
     TSTextLogObjectDestroy(state_->text_log_obj_);
   }
@@ -113,6 +237,141 @@ bool Logger::init(const string &file, bool add_timestamp, bool rename_file, LogL
   return result == TS_SUCCESS;
 }
 
+namespace {
+
+/**
+ * Writes out what every ring holds, reports any newly dropped messages and flushes when asked to.
+ * @return the number of messages written.
+ */
+int drainRings(atscppapi::LoggerState *state) {
+  vector<LogRing *> rings;
+  {
+    ScopedMutexLock lock(state->rings_mutex_);
+    rings = state->rings_;
+  }
+
+  int count = 0;
+  for (vector<LogRing *>::iterator iter = rings.begin(); iter != rings.end(); ++iter) {
+    LogRing *ring = *iter;
+    count += ring->drain(state->text_log_obj_);
+    uint64_t dropped = ring->dropped_;
+    if (dropped != ring->dropped_reported_) {
+      TSTextLogObjectWrite(state->text_log_obj_, const_cast<char *>("[WARNING] %llu log messages were dropped "
+                           "because a ring buffer of %zu bytes was full"),
+                           static_cast<unsigned long long>(dropped - ring->dropped_reported_), ring->buffer_.size());
+      ring->dropped_reported_ = dropped;
+    }
+  }
+
+  if (state->flush_requested_) {
+    state->flush_requested_ = false;
+    TSTextLogObjectFlush(state->text_log_obj_);
+  }
+  return count;
+}
+
+void *runDrainThread(void *data) {
+  atscppapi::LoggerState *state = static_cast<atscppapi::LoggerState *>(data);
+  LOG_DEBUG("Started the async writer for log [%s]", state->filename_.c_str());
+  while (!state->drain_stop_) {
+    if (!drainRings(state)) {
+      usleep(state->async_options_.drain_interval_ms_ * 1000);
+    }
+  }
+  drainRings(state);
+  LOG_DEBUG("Stopped the async writer for log [%s]", state->filename_.c_str());
+  state->drain_stopped_ = true;
+  return NULL;
+}
+
+LogRing *getThreadRing(atscppapi::LoggerState *state) {
+  LogRing *ring = static_cast<LogRing *>(pthread_getspecific(state->ring_key_));
+  if (!ring) {
+    ring = new LogRing(state->ring_bytes_);
+    pthread_setspecific(state->ring_key_, ring);
+    ScopedMutexLock lock(state->rings_mutex_);
+    state->rings_.push_back(ring);
+  }
+  return ring;
+}
+
+void writeAsync(atscppapi::LoggerState *state, const char *message, size_t length) {
+  LogRing *ring = getThreadRing(state);
+  if (ring->push(message, length)) {
+    return;
+  }
+
+  const Logger::AsyncOptions &options = state->async_options_;
+  bool wait = (options.overflow_policy_ == Logger::OVERFLOW_BLOCK) ||
+      (options.overflow_policy_ == Logger::OVERFLOW_SAMPLE && (ring->overflows_++ % options.sample_rate_) == 0);
+  if (wait && alignRecord(sizeof(uint32_t) + length) <= ring->buffer_.size() / 2) {
+    while (!ring->push(message, length)) {
+      usleep(BLOCKED_WRITER_SLEEP_US);
+    }
+    return;
+  }
+  __sync_fetch_and_add(&ring->dropped_, 1);
+}
+
+/**
+ * Writes a formatted message including its level prefix, the message doesn't have to be null terminated.
+ */
+void writeMessage(atscppapi::LoggerState *state, const char *message, size_t length) {
+  if (state->async_) {
+    writeAsync(state, message, length);
+  } else {
+    writeTextLogEntries(state->text_log_obj_, message, length);
+  }
+}
+
+}
+
+bool Logger::enableAsync(const AsyncOptions &options) {
+  if (!state_->initialized_ || !state_->text_log_obj_) {
+    LOG_ERROR("Unable to make log [%s] async because it's not initialized.", state_->filename_.c_str());
+    return false;
+  }
+  if (state_->async_) {
+    LOG_ERROR("Log [%s] is already async.", state_->filename_.c_str());
+    return false;
+  }
+
+  state_->async_options_ = options;
+  if (state_->async_options_.sample_rate_ < 1) {
+    state_->async_options_.sample_rate_ = 1;
+  }
+  state_->ring_bytes_ = MIN_RING_BYTES;
+  while (state_->ring_bytes_ < options.ring_bytes_) {
+    state_->ring_bytes_ <<= 1;
+  }
+
+  if (pthread_key_create(&state_->ring_key_, NULL) != 0) {
+    LOG_ERROR("Unable to create the ring buffer key for log [%s].", state_->filename_.c_str());
+    return false;
+  }
+  if (!TSThreadCreate(runDrainThread, state_)) {
+    LOG_ERROR("Unable to start the async writer for log [%s].", state_->filename_.c_str());
+    pthread_key_delete(state_->ring_key_);
+    return false;
+  }
+
+  state_->async_ = true;
+  LOG_DEBUG("Log [%s] is now async with %zu byte rings, overflow policy %d", state_->filename_.c_str(),
+            state_->ring_bytes_, options.overflow_policy_);
+  return true;
+}
+
+uint64_t Logger::getDroppedMessageCount() const {
+  uint64_t dropped = 0;
+  if (state_->async_) {
+    ScopedMutexLock lock(state_->rings_mutex_);
+    for (vector<LogRing *>::const_iterator iter = state_->rings_.begin(); iter != state_->rings_.end(); ++iter) {
+      dropped += (*iter)->dropped_;
+    }
+  }
+  return dropped;
+}
+
 void Logger::setLogLevel(Logger::LogLevel level) {
   if (state_->initialized_) {
     state_->level_ = level;
@@ -162,7 +421,9 @@ bool Logger::isRollingEnabled() const {
 }
 
 void Logger::flush() {
-  if (state_->initialized_) {
+  if (state_->async_) {
+    state_->flush_requested_ = true;
+  } else if (state_->initialized_) {
     TSTextLogObjectFlush(state_->text_log_obj_);
   } else {
     LOG_ERROR("Not initialized!");
@@ -170,41 +431,149 @@ void Logger::flush() {
 }
 
 namespace {
-const int DEFAULT_BUFFER_SIZE_FOR_VARARGS = 8*1024;
-
-#define TS_TEXT_LOG_OBJECT_WRITE(level) \
-    char buffer[DEFAULT_BUFFER_SIZE_FOR_VARARGS]; \
-    int n; \
-    va_list ap; \
-    while (true) { \
-     va_start(ap, fmt); \
-     n = vsnprintf (&buffer[0], sizeof(buffer), fmt, ap); \
-     va_end(ap); \
-     if (n > -1 && n < sizeof(buffer)) { \
-       LOG_DEBUG("logging a " level " to '%s' with length %d", state_->filename_.c_str(), n); \
-       TSTextLogObjectWrite(state_->text_log_obj_, const_cast<char*>("[" level "] %s"), buffer); \
-     } else { \
-       LOG_ERROR("Unable to log " level " message to '%s' due to size exceeding %d bytes.", state_->filename_.c_str(), sizeof(buffer)); \
-     } \
-     return; \
-    }
+const size_t INITIAL_FORMAT_BUFFER_SIZE = 8 * 1024;
+const size_t MAX_RETAINED_FORMAT_BUFFER_SIZE = 256 * 1024;
+
+pthread_once_t format_buffer_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t format_buffer_key;
+
+void deleteFormatBuffer(void *buffer) {
+  delete static_cast<vector<char> *>(buffer);
+}
+
+void createFormatBufferKey() {
+  pthread_key_create(&format_buffer_key, deleteFormatBuffer);
+}
+
+/**
+ * Each thread formats into its own buffer which grows to fit the largest message it has logged,
+ * unusually large buffers are released once the message has been written.
+ */
+vector<char> &getFormatBuffer() {
+  pthread_once(&format_buffer_key_once, createFormatBufferKey);
+  vector<char> *buffer = static_cast<vector<char> *>(pthread_getspecific(format_buffer_key));
+  if (!buffer) {
+    buffer = new vector<char>(INITIAL_FORMAT_BUFFER_SIZE);
+    pthread_setspecific(format_buffer_key, buffer);
+  }
+  return *buffer;
+}
+
+/**
+ * Formats the level prefix and the message together into the thread's buffer and writes it, the
+ * message is only formatted a second time if it didn't fit in the buffer.
+ */
+void formatAndWrite(atscppapi::LoggerState *state, const char *prefix, const char *fmt, va_list ap) {
+  vector<char> &buffer = getFormatBuffer();
+  size_t prefix_length = strlen(prefix);
+  memcpy(&buffer[0], prefix, prefix_length);
+
+  va_list ap_copy;
+  va_copy(ap_copy, ap);
+  int n = vsnprintf(&buffer[prefix_length], buffer.size() - prefix_length, fmt, ap_copy);
+  va_end(ap_copy);
+  if (n < 0) {
+    LOG_ERROR("Unable to format a %s message for '%s'", prefix, state->filename_.c_str());
+    return;
+  }
+
+  size_t length = prefix_length + n;
+  if (length >= buffer.size()) {
+    buffer.resize(length + 1);
+    vsnprintf(&buffer[prefix_length], buffer.size() - prefix_length, fmt, ap);
+  }
+
+  LOG_DEBUG("logging a %s to '%s' with length %d", prefix, state->filename_.c_str(), n);
+  writeMessage(state, &buffer[0], length);
+
+  if (buffer.size() > MAX_RETAINED_FORMAT_BUFFER_SIZE) {
+    vector<char>(INITIAL_FORMAT_BUFFER_SIZE).swap(buffer);
+  }
+}
 
 } /* end anonymous namespace */
 
 void Logger::logDebug(const char *fmt, ...) {
   if (state_->level_ <= LOG_LEVEL_DEBUG) {
-    TS_TEXT_LOG_OBJECT_WRITE("DEBUG");
+    va_list ap;
+    va_start(ap, fmt);
+    formatAndWrite(state_, "[DEBUG] ", fmt, ap);
+    va_end(ap);
   }
 }
 
 void Logger::logInfo(const char *fmt, ...) {
   if (state_->level_ <= LOG_LEVEL_INFO) {
-    TS_TEXT_LOG_OBJECT_WRITE("INFO");
+    va_list ap;
+    va_start(ap, fmt);
+    formatAndWrite(state_, "[INFO] ", fmt, ap);
+    va_end(ap);
   }
 }
 
 void Logger::logError(const char *fmt, ...) {
   if (state_->level_ <= LOG_LEVEL_ERROR) {
-    TS_TEXT_LOG_OBJECT_WRITE("ERROR");
+    va_list ap;
+    va_start(ap, fmt);
+    formatAndWrite(state_, "[ERROR] ", fmt, ap);
+    va_end(ap);
+  }
+}
+
+void Logger::logRaw(const char *data, size_t length) {
+  if (state_->level_ != LOG_LEVEL_NO_LOG) {
+    writeMessage(state_, data, length);
+  }
+}
+
+namespace {
+const int64_t CALL_SITE_REFILL_INTERVAL_MS = 1000;
+const int64_t CALL_SITE_SUMMARY_INTERVAL_MS = 10000;
+const int64_t DEBUG_TAG_CHECK_INTERVAL_MS = 1000;
+
+int64_t getCoarseTimeMs() {
+  struct timespec now;
+#ifdef CLOCK_MONOTONIC_COARSE
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+#else
+  clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+  return static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+} /* end anonymous namespace */
+
+bool atscppapi::LogCallSite::refill(int32_t per_second) {
+  int64_t refill_time_ms = refill_time_ms_;
+  int64_t now = getCoarseTimeMs();
+  // Only the thread that moves refill_time_ms_ forward refills, the others see an empty bucket.
+  if (per_second > 0 && now >= refill_time_ms &&
+      __sync_bool_compare_and_swap(&refill_time_ms_, refill_time_ms, now + CALL_SITE_REFILL_INTERVAL_MS)) {
+    tokens_ = per_second - 1;
+    return true;
+  }
+  __sync_fetch_and_add(&suppressed_, 1);
+  return false;
+}
+
+uint64_t atscppapi::LogCallSite::takeSuppressedCount() {
+  if (!suppressed_) {
+    return 0;
+  }
+  int64_t summary_time_ms = summary_time_ms_;
+  int64_t now = getCoarseTimeMs();
+  if (now < summary_time_ms ||
+      !__sync_bool_compare_and_swap(&summary_time_ms_, summary_time_ms, now + CALL_SITE_SUMMARY_INTERVAL_MS)) {
+    return 0;
+  }
+  return __sync_lock_test_and_set(&suppressed_, 0);
+}
+
+bool atscppapi::DebugTagCache::isEnabled(const char *tag) {
+  int64_t check_time_ms = check_time_ms_;
+  int64_t now = getCoarseTimeMs();
+  if (now >= check_time_ms &&
+      __sync_bool_compare_and_swap(&check_time_ms_, check_time_ms, now + DEBUG_TAG_CHECK_INTERVAL_MS)) {
+    enabled_ = TSIsDebugTagSet(tag);
   }
+  return enabled_;
 }
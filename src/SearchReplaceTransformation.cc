@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file SearchReplaceTransformation.cc
+ */
+
+#include <string>
+#include <vector>
+#include <deque>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/SearchReplaceTransformation.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using std::map;
+using std::string;
+using std::vector;
+using std::deque;
+
+namespace {
+const int ALPHABET_SIZE = 256;
+const int ROOT_STATE = 0;
+const int NO_STATE = -1;
+}
+
+/**
+ * The automaton is stored as a complete DFA, every state has a transition for every byte,
+ * so scanning costs a single table lookup per input byte.
+ *
+ * @private
+ */
+struct atscppapi::transformations::SearchReplacePatternsState: noncopyable {
+  vector<int> transitions_; // num_states * ALPHABET_SIZE
+  vector<int> depth_; // length of the string that leads to each state
+  vector<int> match_length_; // length of the longest pattern ending in each state, 0 if none
+  vector<int> match_replacement_; // index into replacements_ for match_length_
+  vector<string> replacements_;
+  size_t max_pattern_length_;
+
+  SearchReplacePatternsState() : max_pattern_length_(0) {
+    addState(0);
+  }
+
+  int addState(int depth) {
+    transitions_.resize(transitions_.size() + ALPHABET_SIZE, NO_STATE);
+    depth_.push_back(depth);
+    match_length_.push_back(0);
+    match_replacement_.push_back(-1);
+    return static_cast<int>(depth_.size()) - 1;
+  }
+
+  void addPattern(const string &pattern, const string &replacement) {
+    int state = ROOT_STATE;
+    for (string::const_iterator iter = pattern.begin(), end = pattern.end(); iter != end; ++iter) {
+      unsigned char c = static_cast<unsigned char>(*iter);
+      int next = transitions_[state * ALPHABET_SIZE + c];
+      if (next == NO_STATE) {
+        next = addState(depth_[state] + 1);
+        transitions_[state * ALPHABET_SIZE + c] = next;
+      }
+      state = next;
+    }
+    replacements_.push_back(replacement);
+    match_length_[state] = pattern.length();
+    match_replacement_[state] = replacements_.size() - 1;
+    if (pattern.length() > max_pattern_length_) {
+      max_pattern_length_ = pattern.length();
+    }
+  }
+
+  /**
+   * Computes the failure links breadth first and folds them into the transition table
+   * so that it becomes a complete DFA.
+   */
+  void compile() {
+    vector<int> failure(depth_.size(), ROOT_STATE);
+    deque<int> queue;
+    for (int c = 0; c < ALPHABET_SIZE; ++c) {
+      int &next = transitions_[ROOT_STATE * ALPHABET_SIZE + c];
+      if (next == NO_STATE) {
+        next = ROOT_STATE;
+      } else {
+        failure[next] = ROOT_STATE;
+        queue.push_back(next);
+      }
+    }
+
+    while (!queue.empty()) {
+      int state = queue.front();
+      queue.pop_front();
+
+      // A pattern that is a suffix of this state also ends here, keep the longest one.
+      int fail = failure[state];
+      if (match_length_[fail] > match_length_[state]) {
+        match_length_[state] = match_length_[fail];
+        match_replacement_[state] = match_replacement_[fail];
+      }
+
+      for (int c = 0; c < ALPHABET_SIZE; ++c) {
+        int &next = transitions_[state * ALPHABET_SIZE + c];
+        if (next == NO_STATE) {
+          next = transitions_[fail * ALPHABET_SIZE + c];
+        } else {
+          failure[next] = transitions_[fail * ALPHABET_SIZE + c];
+          queue.push_back(next);
+        }
+      }
+    }
+  }
+};
+
+SearchReplacePatterns::SearchReplacePatterns(const map<string, string> &replacements) {
+  state_ = new SearchReplacePatternsState();
+  for (map<string, string>::const_iterator iter = replacements.begin(), end = replacements.end(); iter != end; ++iter) {
+    if (iter->first.empty()) {
+      LOG_ERROR("Ignoring empty search pattern with replacement '%s'", iter->second.c_str());
+      continue;
+    }
+    state_->addPattern(iter->first, iter->second);
+  }
+  state_->compile();
+  LOG_DEBUG("Compiled %d patterns into %d states, longest pattern is %d bytes",
+      static_cast<int>(state_->replacements_.size()), static_cast<int>(state_->depth_.size()),
+      static_cast<int>(state_->max_pattern_length_));
+}
+
+SearchReplacePatterns::~SearchReplacePatterns() {
+  delete state_;
+}
+
+size_t SearchReplacePatterns::getMaxPatternLength() const {
+  return state_->max_pattern_length_;
+}
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::SearchReplaceTransformationState: noncopyable {
+  shared_ptr<SearchReplacePatterns> patterns_;
+  int state_;
+  string carry_over_; // the last depth_[state_] bytes seen, they may still become a match.
+  string output_;
+  int64_t replacement_count_;
+
+  SearchReplaceTransformationState(shared_ptr<SearchReplacePatterns> patterns)
+    : patterns_(patterns), state_(ROOT_STATE), replacement_count_(0) {
+    carry_over_.reserve(patterns_->getMaxPatternLength());
+  }
+};
+
+SearchReplaceTransformation::SearchReplaceTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                         shared_ptr<SearchReplacePatterns> patterns)
+  : TransformationPlugin(transaction, type) {
+  state_ = new SearchReplaceTransformationState(patterns);
+}
+
+SearchReplaceTransformation::~SearchReplaceTransformation() {
+  delete state_;
+}
+
+void SearchReplaceTransformation::consume(const string &data) {
+  if (data.empty()) {
+    return;
+  }
+
+  const SearchReplacePatternsState &automaton = *state_->patterns_->state_;
+  const int *transitions = &automaton.transitions_[0];
+  string &output = state_->output_;
+  output.clear();
+  output.reserve(state_->carry_over_.length() + data.length());
+
+  // Bytes before pending_start are known not to be part of a match, everything in the carry over
+  // followed by data[pending_start..] may still be, positions are relative to data.
+  size_t pending_start = 0;
+  bool carry_over_pending = !state_->carry_over_.empty();
+  int state = state_->state_;
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data.data());
+  size_t length = data.length();
+
+  for (size_t i = 0; i < length; ++i) {
+    state = transitions[state * ALPHABET_SIZE + bytes[i]];
+    int match_length = automaton.match_length_[state];
+    if (match_length) {
+      // The match covers the last match_length bytes, which may start in the carry over.
+      size_t consumed = i + 1 - pending_start;
+      if (carry_over_pending) {
+        size_t carried = state_->carry_over_.length();
+        size_t keep = carried + consumed - match_length;
+        output.append(state_->carry_over_, 0, (keep < carried) ? keep : carried);
+        if (keep > carried) {
+          output.append(data, pending_start, keep - carried);
+        }
+        state_->carry_over_.clear();
+        carry_over_pending = false;
+      } else {
+        output.append(data, pending_start, consumed - match_length);
+      }
+      output.append(automaton.replacements_[automaton.match_replacement_[state]]);
+      ++state_->replacement_count_;
+      pending_start = i + 1;
+      state = ROOT_STATE;
+    }
+  }
+
+  // Only the last depth_[state] bytes can still become part of a match, everything else is emitted.
+  size_t keep = automaton.depth_[state];
+  size_t pending = (carry_over_pending ? state_->carry_over_.length() : 0) + (length - pending_start);
+  size_t emit = pending - keep;
+  if (carry_over_pending) {
+    size_t carried = state_->carry_over_.length();
+    if (emit < carried) {
+      output.append(state_->carry_over_, 0, emit);
+      state_->carry_over_.erase(0, emit);
+      state_->carry_over_.append(data, pending_start, string::npos);
+    } else {
+      output.append(state_->carry_over_);
+      output.append(data, pending_start, emit - carried);
+      state_->carry_over_.assign(data, pending_start + emit - carried, string::npos);
+    }
+  } else {
+    output.append(data, pending_start, emit);
+    state_->carry_over_.assign(data, pending_start + emit, string::npos);
+  }
+  state_->state_ = state;
+
+  LOG_DEBUG("SearchReplaceTransformation=%p consumed %lu bytes, producing %lu bytes and carrying over %lu bytes",
+      this, static_cast<unsigned long>(length), static_cast<unsigned long>(output.length()),
+      static_cast<unsigned long>(state_->carry_over_.length()));
+  produce(output);
+}
+
+void SearchReplaceTransformation::handleInputComplete() {
+  if (!state_->carry_over_.empty()) {
+    produce(state_->carry_over_);
+    state_->carry_over_.clear();
+  }
+  state_->state_ = ROOT_STATE;
+  LOG_DEBUG("SearchReplaceTransformation=%p made %lld replacements", this,
+      static_cast<long long>(state_->replacement_count_));
+  setOutputComplete();
+}
+
+int64_t SearchReplaceTransformation::getReplacementCount() const {
+  return state_->replacement_count_;
+}
@@ -17,15 +17,106 @@
  */
 
 #include "atscppapi/Stat.h"
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <vector>
 #include <stdint.h>
+#include <pthread.h>
 #include <ts/ts.h>
+#include "atscppapi/Mutex.h"
 #include "logging_internal.h"
 
 using namespace atscppapi;
 using std::string;
+using std::vector;
 
-Stat::Stat() : stat_id_(TS_ERROR) {
+namespace {
+
+const int MAX_SHARDED_STATS = 1024;
+const int SHARD_FLUSH_INTERVAL_MS = 1000;
+const size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * One thread's counters for every sharded Stat, only the owning thread writes them. Shards are never
+ * freed because the counts of a thread that exits still have to be added up.
+ */
+struct StatShard {
+  volatile int64_t values_[MAX_SHARDED_STATS];
+};
+
+/**
+ * The sharded stats and the shards of every thread that has updated one. flushed_ is the total of the
+ * shards that has already been added to each Traffic Server stat.
+ */
+struct ShardedStats : noncopyable {
+  Mutex mutex_;
+  vector<StatShard *> shards_;
+  int stat_ids_[MAX_SHARDED_STATS];
+  int64_t flushed_[MAX_SHARDED_STATS];
+  int slot_count_;
+  pthread_key_t shard_key_;
+  TSCont flush_cont_;
+  ShardedStats() : slot_count_(0), flush_cont_(NULL) {
+    pthread_key_create(&shard_key_, NULL);
+  }
+};
+
+pthread_once_t sharded_stats_once = PTHREAD_ONCE_INIT;
+ShardedStats *sharded_stats = NULL;
+
+/**
+ * Adds what the shards have counted since the last flush to the Traffic Server stat, the mutex must be held.
+ * @return the total of the shards.
+ */
+int64_t flushSlot(int slot) {
+  int64_t total = 0;
+  for (vector<StatShard *>::const_iterator iter = sharded_stats->shards_.begin();
+       iter != sharded_stats->shards_.end(); ++iter) {
+    total += (*iter)->values_[slot];
+  }
+  int64_t delta = total - sharded_stats->flushed_[slot];
+  if (delta) {
+    TSStatIntIncrement(sharded_stats->stat_ids_[slot], delta);
+    sharded_stats->flushed_[slot] = total;
+  }
+  return total;
+}
+
+int handleShardFlushEvents(TSCont cont, TSEvent event, void *edata) {
+  ScopedMutexLock lock(sharded_stats->mutex_);
+  for (int slot = 0; slot < sharded_stats->slot_count_; ++slot) {
+    flushSlot(slot);
+  }
+  return 0;
+}
+
+void initShardedStats() {
+  sharded_stats = new ShardedStats();
+  sharded_stats->flush_cont_ = TSContCreate(handleShardFlushEvents, TSMutexCreate());
+  TSContScheduleEvery(sharded_stats->flush_cont_, SHARD_FLUSH_INTERVAL_MS, TS_THREAD_POOL_TASK);
+}
+
+StatShard *getShard() {
+  StatShard *shard = static_cast<StatShard *>(pthread_getspecific(sharded_stats->shard_key_));
+  if (!shard) {
+    void *memory = NULL;
+    // Aligned so two threads' shards never share a cache line.
+    if (posix_memalign(&memory, CACHE_LINE_SIZE, sizeof(StatShard)) != 0) {
+      abort();
+    }
+    shard = static_cast<StatShard *>(memory);
+    memset(memory, 0, sizeof(StatShard));
+    pthread_setspecific(sharded_stats->shard_key_, shard);
+    ScopedMutexLock lock(sharded_stats->mutex_);
+    sharded_stats->shards_.push_back(shard);
+  }
+  return shard;
+}
+
+}
+
+Stat::Stat() : stat_id_(TS_ERROR), sync_type_(SYNC_COUNT), shard_slot_(-1) {
 // ATS Guarantees that stat ids will always be > 0. So we can use stat_id_ > 0 to
 // verify that this stat has been properly initialized.
 }
@@ -48,6 +139,7 @@ bool Stat::init(string name, Stat::SyncType type, bool persistent) {
     return false;
   }
 
+  sync_type_ = type;
   if (!persistent) {
     set(0);
   }
@@ -55,11 +147,64 @@ bool Stat::init(string name, Stat::SyncType type, bool persistent) {
   return true;
 }
 
+bool Stat::initSharded(string name, bool persistent) {
+  if (!init(name, SYNC_SUM, persistent)) {
+    return false;
+  }
+
+  if (!shard()) {
+    LOG_ERROR("Unable to shard stat '%s', the limit of %d sharded stats was reached, it won't be sharded",
+              name.c_str(), MAX_SHARDED_STATS);
+  }
+  return true;
+}
+
+bool Stat::shard() {
+  if (shard_slot_ >= 0) {
+    return true;
+  }
+  if (stat_id_ == TS_ERROR || sync_type_ != SYNC_SUM) {
+    return false;
+  }
+
+  pthread_once(&sharded_stats_once, initShardedStats);
+  // Checked without the lock first, the slots never free up once they are all taken.
+  if (sharded_stats->slot_count_ >= MAX_SHARDED_STATS) {
+    return false;
+  }
+  ScopedMutexLock lock(sharded_stats->mutex_);
+  if (shard_slot_ >= 0) {
+    return true;
+  }
+  if (sharded_stats->slot_count_ >= MAX_SHARDED_STATS) {
+    return false;
+  }
+
+  int slot = sharded_stats->slot_count_;
+  sharded_stats->stat_ids_[slot] = stat_id_;
+  sharded_stats->flushed_[slot] = 0;
+  __sync_synchronize();
+  ++sharded_stats->slot_count_;
+  shard_slot_ = slot;
+  LOG_DEBUG("Stat with stat_id = %d is sharded in slot %d", stat_id_, shard_slot_);
+  return true;
+}
+
 void Stat::set(int64_t value) {
   if (stat_id_ == TS_ERROR) {
     return;
   }
 
+  if (shard_slot_ >= 0) {
+    // Whatever the shards counted before the set is discarded.
+    ScopedMutexLock lock(sharded_stats->mutex_);
+    sharded_stats->flushed_[shard_slot_] = 0;
+    for (vector<StatShard *>::const_iterator iter = sharded_stats->shards_.begin();
+         iter != sharded_stats->shards_.end(); ++iter) {
+      sharded_stats->flushed_[shard_slot_] += (*iter)->values_[shard_slot_];
+    }
+  }
+
   TSStatIntSet(stat_id_, value);
 }
 
@@ -68,6 +213,11 @@ int64_t Stat::get() const {
     return 0;
   }
 
+  if (shard_slot_ >= 0) {
+    ScopedMutexLock lock(sharded_stats->mutex_);
+    flushSlot(shard_slot_);
+  }
+
   return TSStatIntGet(stat_id_);
 }
 
@@ -76,6 +226,11 @@ void Stat::increment(int64_t amount) {
     return;
   }
 
+  if (shard_slot_ >= 0) {
+    getShard()->values_[shard_slot_] += amount;
+    return;
+  }
+
   TSStatIntIncrement(stat_id_, amount);
 }
 
@@ -84,10 +239,14 @@ void Stat::decrement(int64_t amount) {
     return;
   }
 
+  if (shard_slot_ >= 0) {
+    getShard()->values_[shard_slot_] -= amount;
+    return;
+  }
+
   TSStatIntDecrement(stat_id_, amount);
 }
 
-
-
-
-
+Stat::SyncType Stat::getSyncType() const {
+  return sync_type_;
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StatFamily.cc
+ */
+
+#include "atscppapi/StatFamily.h"
+#include <vector>
+#include <stdint.h>
+#include "atscppapi/Mutex.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+namespace {
+
+const size_t MIN_TABLE_SIZE = 16;
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+struct StatFamilyEntry : noncopyable {
+  uint64_t hash_;
+  vector<string> values_;
+  Stat stat_;
+};
+
+uint64_t hashValues(const string *const *values, size_t count) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (size_t i = 0; i < count; ++i) {
+    const string &value = *values[i];
+    for (string::size_type j = 0; j < value.length(); ++j) {
+      hash = (hash ^ static_cast<unsigned char>(value[j])) * FNV_PRIME;
+    }
+    // A separator that can't appear in a value, so ("ab", "c") and ("a", "bc") hash differently.
+    hash = (hash ^ 0x100) * FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * Appends a label value to a stat name, percent-encoded so the name is reversible, see StatFamily.
+ */
+void appendEncodedValue(string &stat_name, const string &value) {
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+  for (string::size_type i = 0; i < value.length(); ++i) {
+    unsigned char c = static_cast<unsigned char>(value[i]);
+    bool reserved = (i == 0 && c == 'o' && value == "overflow");
+    if (c == '.' || c == '_' || c == '%' || c <= ' ' || c >= 0x7f || reserved) {
+      stat_name += '%';
+      stat_name += HEX_DIGITS[c >> 4];
+      stat_name += HEX_DIGITS[c & 0xf];
+    } else {
+      stat_name += static_cast<char>(c);
+    }
+  }
+}
+
+bool hasValues(const StatFamilyEntry *entry, uint64_t hash, const string *const *values, size_t count) {
+  if (entry->hash_ != hash) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (entry->values_[i] != *values[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::StatFamilyState : noncopyable {
+  string name_;
+  size_t label_count_;
+  size_t max_cardinality_;
+  Stat::SyncType type_;
+  Stat overflow_stat_;
+  Mutex mutex_;
+  StatFamilyEntry *volatile *table_; // open addressing, an entry is never moved or removed once it's published.
+  size_t table_mask_;
+  volatile size_t cardinality_;
+  StatFamilyState() : label_count_(0), max_cardinality_(0), type_(Stat::SYNC_SUM), table_(NULL), table_mask_(0),
+                      cardinality_(0) { }
+};
+
+StatFamily::StatFamily() {
+  state_ = new StatFamilyState();
+}
+
+StatFamily::~StatFamily() {
+  if (state_->table_) {
+    for (size_t i = 0; i <= state_->table_mask_; ++i) {
+      delete state_->table_[i];
+    }
+    delete[] state_->table_;
+  }
+  delete state_;
+}
+
+bool StatFamily::init(const string &name, const vector<string> &label_names, size_t max_cardinality,
+                      Stat::SyncType type) {
+  if (state_->table_) {
+    LOG_ERROR("Attempt to reinitialize stat family '%s' as '%s'", state_->name_.c_str(), name.c_str());
+    return false;
+  }
+  if (label_names.empty()) {
+    LOG_ERROR("Stat family '%s' must have at least one label", name.c_str());
+    return false;
+  }
+  if (!state_->overflow_stat_.init(name + ".overflow", type)) {
+    LOG_ERROR("Unable to create the overflow stat of stat family '%s'", name.c_str());
+    return false;
+  }
+
+  state_->name_ = name;
+  state_->label_count_ = label_names.size();
+  state_->max_cardinality_ = max_cardinality;
+  state_->type_ = type;
+  // At most half full, so probes stay short.
+  size_t table_size = MIN_TABLE_SIZE;
+  while (table_size < 2 * max_cardinality) {
+    table_size *= 2;
+  }
+  state_->table_mask_ = table_size - 1;
+  state_->table_ = new StatFamilyEntry *volatile[table_size];
+  for (size_t i = 0; i < table_size; ++i) {
+    state_->table_[i] = NULL;
+  }
+  LOG_DEBUG("Initialized stat family '%s' with %d labels and a maximum cardinality of %d", name.c_str(),
+            static_cast<int>(label_names.size()), static_cast<int>(max_cardinality));
+  return true;
+}
+
+Stat &StatFamily::get(const string &value) {
+  const string *values[] = { &value };
+  return resolve(values, 1);
+}
+
+Stat &StatFamily::get(const string &value1, const string &value2) {
+  const string *values[] = { &value1, &value2 };
+  return resolve(values, 2);
+}
+
+Stat &StatFamily::get(const string &value1, const string &value2, const string &value3) {
+  const string *values[] = { &value1, &value2, &value3 };
+  return resolve(values, 3);
+}
+
+Stat &StatFamily::get(const vector<string> &values) {
+  vector<const string *> value_pointers(values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    value_pointers[i] = &values[i];
+  }
+  return resolve(value_pointers.empty() ? NULL : &value_pointers[0], values.size());
+}
+
+size_t StatFamily::getCardinality() const {
+  return state_->cardinality_;
+}
+
+Stat &StatFamily::resolve(const string *const *values, size_t count) {
+  if (!state_->table_) {
+    LOG_ERROR("Unable to get a stat, the stat family is not initialized.");
+    return state_->overflow_stat_;
+  }
+  if (count != state_->label_count_) {
+    LOG_ERROR("Stat family '%s' has %d labels but %d values were given", state_->name_.c_str(),
+              static_cast<int>(state_->label_count_), static_cast<int>(count));
+    return state_->overflow_stat_;
+  }
+
+  uint64_t hash = hashValues(values, count);
+  size_t index = hash & state_->table_mask_;
+  for (StatFamilyEntry *entry; (entry = state_->table_[index]) != NULL; index = (index + 1) & state_->table_mask_) {
+    if (hasValues(entry, hash, values, count)) {
+      return entry->stat_;
+    }
+  }
+  if (state_->cardinality_ >= state_->max_cardinality_) {
+    return state_->overflow_stat_;
+  }
+
+  ScopedMutexLock lock(state_->mutex_);
+  // Another thread may have added it, or filled the family, while we waited for the lock.
+  index = hash & state_->table_mask_;
+  for (StatFamilyEntry *entry; (entry = state_->table_[index]) != NULL; index = (index + 1) & state_->table_mask_) {
+    if (hasValues(entry, hash, values, count)) {
+      return entry->stat_;
+    }
+  }
+  if (state_->cardinality_ >= state_->max_cardinality_) {
+    LOG_DEBUG("Stat family '%s' reached its maximum cardinality of %d", state_->name_.c_str(),
+              static_cast<int>(state_->max_cardinality_));
+    return state_->overflow_stat_;
+  }
+
+  StatFamilyEntry *entry = new StatFamilyEntry();
+  entry->hash_ = hash;
+  string stat_name = state_->name_;
+  for (size_t i = 0; i < count; ++i) {
+    entry->values_.push_back(*values[i]);
+    stat_name += '.';
+    appendEncodedValue(stat_name, *values[i]);
+  }
+  if (!entry->stat_.init(stat_name, state_->type_)) {
+    LOG_ERROR("Unable to create stat '%s' of stat family '%s', counting it as overflow", stat_name.c_str(),
+              state_->name_.c_str());
+    delete entry;
+    return state_->overflow_stat_;
+  }
+
+  // The entry must be complete before readers can find it.
+  __sync_synchronize();
+  state_->table_[index] = entry;
+  ++state_->cardinality_;
+  return entry->stat_;
+}
@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StructuredLogger.cc
+ */
+
+#include "atscppapi/StructuredLogger.h"
+#include <cstdarg>
+#include <cstring>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <ts/ts.h>
+#include "atscppapi/Mutex.h"
+#include "logging_internal.h"
+#include "structured_log_internal.h"
+
+using namespace atscppapi;
+using namespace atscppapi::structured_log;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int MAX_FORMATS = 4096;
+const size_t BUFFER_FLUSH_BYTES = 64 * 1024;
+const size_t BUFFER_CAPACITY = BUFFER_FLUSH_BYTES + 4096;
+const size_t MAX_PENDING_BYTES = 256 * BUFFER_FLUSH_BYTES;
+const size_t MAX_RECORD_HEADER_LENGTH = 1 + 2 * MAX_VARINT_LENGTH;
+
+struct Format {
+  vector<ArgumentType> arguments_;
+};
+
+/**
+ * The records a thread has logged and not yet written, the mutex is only contended when the
+ * periodic flush runs.
+ */
+struct ThreadBuffer : noncopyable {
+  Mutex mutex_;
+  vector<char> data_;
+  size_t used_;
+
+  ThreadBuffer() : data_(BUFFER_CAPACITY), used_(0) { }
+
+  char *reserve(size_t length) {
+    if (used_ + length > data_.size()) {
+      data_.resize((used_ + length) * 2);
+    }
+    return &data_[used_];
+  }
+};
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::StructuredLoggerState : noncopyable {
+  string path_;
+  int fd_;
+  Mutex write_mutex_;
+  Mutex formats_mutex_;
+  Format *formats_[MAX_FORMATS]; // published before format_count_ so log() can read them without a lock.
+  volatile int format_count_;
+  pthread_key_t buffer_key_;
+  Mutex buffers_mutex_;
+  vector<ThreadBuffer *> buffers_;
+  Mutex pending_mutex_;
+  vector<vector<char> *> pending_; // full buffers handed to the task thread, see handOffBuffer().
+  size_t pending_bytes_;
+  TSCont flush_cont_;
+  TSAction flush_action_;
+  TSAction pending_action_;
+
+  StructuredLoggerState() : fd_(-1), format_count_(0), pending_bytes_(0), flush_cont_(NULL), flush_action_(NULL),
+                            pending_action_(NULL) { }
+};
+
+namespace {
+
+uint64_t getTimeUs() {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * Writes a run of complete records. If the write fails part way the file is truncated back so the
+ * whole run is dropped, a partial record would make the decoder read the rest of the file out of sync.
+ */
+bool writeFully(StructuredLoggerState *state, const char *data, size_t length) {
+  ScopedMutexLock lock(state->write_mutex_);
+  off_t start = lseek(state->fd_, 0, SEEK_END);
+  size_t remaining = length;
+  while (remaining) {
+    ssize_t written = write(state->fd_, data, remaining);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      int error = errno;
+      if (remaining != length && (start < 0 || ftruncate(state->fd_, start) != 0)) {
+        LOG_ERROR("Unable to remove a partial write from structured log '%s', errno %d", state->path_.c_str(), errno);
+      }
+      LOG_ERROR("Dropped %lu bytes of structured log '%s', errno %d", static_cast<unsigned long>(length),
+                state->path_.c_str(), error);
+      return false;
+    }
+    data += written;
+    remaining -= written;
+  }
+  return true;
+}
+
+/**
+ * The buffer's mutex must be held.
+ */
+void writeBuffer(StructuredLoggerState *state, ThreadBuffer *buffer) {
+  if (buffer->used_) {
+    writeFully(state, &buffer->data_[0], buffer->used_);
+    buffer->used_ = 0;
+    if (buffer->data_.size() > 4 * BUFFER_FLUSH_BYTES) {
+      vector<char>(BUFFER_CAPACITY).swap(buffer->data_);
+    }
+  }
+}
+
+void writePendingBuffers(StructuredLoggerState *state) {
+  vector<vector<char> *> pending;
+  {
+    ScopedMutexLock lock(state->pending_mutex_);
+    pending.swap(state->pending_);
+    state->pending_bytes_ = 0;
+  }
+  for (vector<vector<char> *>::iterator iter = pending.begin(); iter != pending.end(); ++iter) {
+    writeFully(state, &(**iter)[0], (*iter)->size());
+    delete *iter;
+  }
+}
+
+/**
+ * Called by log() on a net thread when a buffer is full, the buffer's mutex must be held. The full buffer
+ * is swapped for an empty one and written by the task thread so the net thread never blocks on the disk.
+ * If the task thread falls too far behind the buffer is dropped, it only holds complete records.
+ */
+void handOffBuffer(StructuredLoggerState *state, ThreadBuffer *buffer) {
+  vector<char> *full = new vector<char>(BUFFER_CAPACITY);
+  full->swap(buffer->data_);
+  full->resize(buffer->used_);
+  buffer->used_ = 0;
+
+  ScopedMutexLock lock(state->pending_mutex_);
+  if (state->pending_bytes_ + full->size() > MAX_PENDING_BYTES) {
+    LOG_ERROR("Dropped %lu bytes of structured log '%s', %lu bytes are already waiting to be written",
+              static_cast<unsigned long>(full->size()), state->path_.c_str(),
+              static_cast<unsigned long>(state->pending_bytes_));
+    delete full;
+    return;
+  }
+  state->pending_.push_back(full);
+  state->pending_bytes_ += full->size();
+  if (!state->pending_action_) {
+    state->pending_action_ = TSContSchedule(state->flush_cont_, 0, TS_THREAD_POOL_TASK);
+  }
+}
+
+ThreadBuffer *getThreadBuffer(StructuredLoggerState *state) {
+  ThreadBuffer *buffer = static_cast<ThreadBuffer *>(pthread_getspecific(state->buffer_key_));
+  if (!buffer) {
+    buffer = new ThreadBuffer();
+    pthread_setspecific(state->buffer_key_, buffer);
+    ScopedMutexLock lock(state->buffers_mutex_);
+    state->buffers_.push_back(buffer);
+  }
+  return buffer;
+}
+
+void writeAllBuffers(StructuredLoggerState *state) {
+  vector<ThreadBuffer *> buffers;
+  {
+    ScopedMutexLock lock(state->buffers_mutex_);
+    buffers = state->buffers_;
+  }
+  for (vector<ThreadBuffer *>::iterator iter = buffers.begin(); iter != buffers.end(); ++iter) {
+    // Holding the buffer's mutex keeps a buffer it handed off ahead of the records it still holds.
+    ScopedMutexLock lock((*iter)->mutex_);
+    writePendingBuffers(state);
+    writeBuffer(state, *iter);
+  }
+  writePendingBuffers(state);
+}
+
+int handleFlushEvents(TSCont cont, TSEvent event, void *edata) {
+  StructuredLoggerState *state = static_cast<StructuredLoggerState *>(TSContDataGet(cont));
+  if (event == TS_EVENT_IMMEDIATE) {
+    {
+      ScopedMutexLock lock(state->pending_mutex_);
+      state->pending_action_ = NULL;
+    }
+    writePendingBuffers(state);
+  } else {
+    writeAllBuffers(state);
+  }
+  return 0;
+}
+
+size_t encodeArgument(ArgumentType type, va_list &ap, ThreadBuffer *buffer) {
+  char *out = buffer->reserve(MAX_VARINT_LENGTH);
+  switch (type) {
+  case ARG_INT:
+    return encodeVarint(zigzagEncode(va_arg(ap, int)), out);
+  case ARG_LONG:
+    return encodeVarint(zigzagEncode(va_arg(ap, long)), out);
+  case ARG_LONG_LONG:
+    return encodeVarint(zigzagEncode(va_arg(ap, long long)), out);
+  case ARG_UNSIGNED:
+    return encodeVarint(va_arg(ap, unsigned int), out);
+  case ARG_UNSIGNED_LONG:
+    return encodeVarint(va_arg(ap, unsigned long), out);
+  case ARG_UNSIGNED_LONG_LONG:
+    return encodeVarint(va_arg(ap, unsigned long long), out);
+  case ARG_SIZE:
+    return encodeVarint(va_arg(ap, size_t), out);
+  case ARG_POINTER:
+    return encodeVarint(reinterpret_cast<uintptr_t>(va_arg(ap, void *)), out);
+  case ARG_DOUBLE: {
+    double value = va_arg(ap, double);
+    memcpy(out, &value, sizeof(value));
+    return sizeof(value);
+  }
+  case ARG_STRING: {
+    const char *value = va_arg(ap, const char *);
+    if (!value) {
+      value = "(null)";
+    }
+    size_t length = strlen(value);
+    size_t prefix_length = encodeVarint(length, out);
+    buffer->used_ += prefix_length;
+    memcpy(buffer->reserve(length), value, length);
+    buffer->used_ -= prefix_length;
+    return prefix_length + length;
+  }
+  }
+  return 0;
+}
+
+}
+
+StructuredLogger::StructuredLogger() {
+  state_ = new StructuredLoggerState();
+}
+
+StructuredLogger::~StructuredLogger() {
+  if (state_->flush_cont_) {
+    if (state_->flush_action_) {
+      TSActionCancel(state_->flush_action_);
+    }
+    if (state_->pending_action_) {
+      TSActionCancel(state_->pending_action_);
+    }
+    TSContDestroy(state_->flush_cont_);
+  }
+  if (state_->fd_ >= 0) {
+    writePendingBuffers(state_);
+    for (vector<ThreadBuffer *>::iterator iter = state_->buffers_.begin(); iter != state_->buffers_.end(); ++iter) {
+      {
+        ScopedMutexLock lock((*iter)->mutex_);
+        writeBuffer(state_, *iter);
+      }
+      delete *iter;
+    }
+    pthread_key_delete(state_->buffer_key_);
+    close(state_->fd_);
+  }
+  for (int i = 0; i < state_->format_count_; ++i) {
+    delete state_->formats_[i];
+  }
+  delete state_;
+}
+
+bool StructuredLogger::init(const string &path, int flush_interval_ms) {
+  if (state_->fd_ >= 0) {
+    LOG_ERROR("Attempt to reinitialize structured log '%s' as '%s'", state_->path_.c_str(), path.c_str());
+    return false;
+  }
+
+  state_->fd_ = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (state_->fd_ < 0) {
+    LOG_ERROR("Unable to open structured log '%s', errno %d", path.c_str(), errno);
+    return false;
+  }
+  state_->path_ = path;
+  pthread_key_create(&state_->buffer_key_, NULL);
+  writeFully(state_, STRUCTURED_LOG_MAGIC, STRUCTURED_LOG_MAGIC_LENGTH);
+
+  state_->flush_cont_ = TSContCreate(handleFlushEvents, TSMutexCreate());
+  TSContDataSet(state_->flush_cont_, static_cast<void *>(state_));
+  if (flush_interval_ms > 0) {
+    state_->flush_action_ = TSContScheduleEvery(state_->flush_cont_, flush_interval_ms, TS_THREAD_POOL_TASK);
+  }
+  LOG_DEBUG("Initialized structured log '%s'", path.c_str());
+  return true;
+}
+
+int StructuredLogger::registerFormat(const string &format) {
+  if (state_->fd_ < 0) {
+    LOG_ERROR("Unable to register a format, the structured log is not initialized.");
+    return -1;
+  }
+
+  vector<FormatPiece> pieces;
+  if (!parseFormat(format, pieces)) {
+    LOG_ERROR("Unsupported structured log format '%s'", format.c_str());
+    return -1;
+  }
+
+  ScopedMutexLock lock(state_->formats_mutex_);
+  int id = state_->format_count_;
+  if (id >= MAX_FORMATS) {
+    LOG_ERROR("Unable to register structured log format '%s', the limit of %d formats was reached", format.c_str(),
+              MAX_FORMATS);
+    return -1;
+  }
+
+  Format *registered = new Format();
+  for (vector<FormatPiece>::iterator iter = pieces.begin(); iter != pieces.end(); ++iter) {
+    if (!iter->literal_) {
+      registered->arguments_.push_back(iter->type_);
+    }
+  }
+
+  // The definition goes straight to the file so it always precedes the events that use it.
+  string record(1, static_cast<char>(RECORD_FORMAT));
+  char varint[MAX_VARINT_LENGTH];
+  record.append(varint, encodeVarint(id, varint));
+  record.append(varint, encodeVarint(format.length(), varint));
+  record.append(format);
+  if (!writeFully(state_, record.data(), record.length())) {
+    LOG_ERROR("Unable to register structured log format '%s', the definition couldn't be written", format.c_str());
+    delete registered;
+    return -1;
+  }
+
+  state_->formats_[id] = registered;
+  __sync_synchronize();
+  state_->format_count_ = id + 1;
+  LOG_DEBUG("Registered structured log format %d '%s'", id, format.c_str());
+  return id;
+}
+
+void StructuredLogger::log(int format_id, ...) {
+  if (format_id < 0 || format_id >= state_->format_count_) {
+    LOG_ERROR("Unknown structured log format id %d", format_id);
+    return;
+  }
+  const Format *format = state_->formats_[format_id];
+  ThreadBuffer *buffer = getThreadBuffer(state_);
+  ScopedMutexLock lock(buffer->mutex_);
+
+  char *out = buffer->reserve(MAX_RECORD_HEADER_LENGTH);
+  size_t length = 0;
+  out[length++] = static_cast<char>(RECORD_EVENT);
+  length += encodeVarint(format_id, out + length);
+  length += encodeVarint(getTimeUs(), out + length);
+  buffer->used_ += length;
+
+  va_list ap;
+  va_start(ap, format_id);
+  for (vector<ArgumentType>::const_iterator iter = format->arguments_.begin(); iter != format->arguments_.end();
+       ++iter) {
+    buffer->used_ += encodeArgument(*iter, ap, buffer);
+  }
+  va_end(ap);
+
+  if (buffer->used_ >= BUFFER_FLUSH_BYTES) {
+    handOffBuffer(state_, buffer);
+  }
+}
+
+void StructuredLogger::flush() {
+  if (state_->fd_ < 0) {
+    return;
+  }
+  writeAllBuffers(state_);
+}
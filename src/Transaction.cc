@@ -23,6 +23,7 @@
 #include <string>
 #include <ts/ts.h>
 #include "atscppapi/shared_ptr.h"
+#include "atscppapi/Stat.h"
 #include "logging_internal.h"
 #include "utils_internal.h"
 #include "InitializableValue.h"
@@ -32,6 +33,18 @@ using std::map;
 using std::string;
 using namespace atscppapi;
 
+namespace {
+
+// Enough for the handful of distinct stats a transaction touches, stats beyond this are incremented directly.
+const int MAX_BUFFERED_STATS = 16;
+
+struct StatDelta {
+  Stat *stat_;
+  int64_t amount_;
+};
+
+}
+
 /**
  * @private
  */
@@ -51,13 +64,15 @@ struct atscppapi::TransactionState: noncopyable {
   TSMLoc client_response_hdr_loc_;
   Response client_response_;
   map<string, shared_ptr<Transaction::ContextValue> > context_values_;
+  StatDelta stat_deltas_[MAX_BUFFERED_STATS];
+  int stat_delta_count_;
 
   TransactionState(TSHttpTxn txn, TSMBuffer client_request_hdr_buf, TSMLoc client_request_hdr_loc)
     : txn_(txn), client_request_hdr_buf_(client_request_hdr_buf), client_request_hdr_loc_(client_request_hdr_loc),
       client_request_(txn, client_request_hdr_buf, client_request_hdr_loc),
       server_request_hdr_buf_(NULL), server_request_hdr_loc_(NULL),
       server_response_hdr_buf_(NULL), server_response_hdr_loc_(NULL),
-      client_response_hdr_buf_(NULL), client_response_hdr_loc_(NULL)
+      client_response_hdr_buf_(NULL), client_response_hdr_loc_(NULL), stat_delta_count_(0)
   { };
 };
 
@@ -139,6 +154,40 @@ void Transaction::addPlugin(TransactionPlugin *plugin) {
   state_->plugins_.push_back(plugin);
 }
 
+void Transaction::incrementStat(Stat &stat, int64_t amount) {
+  if (stat.getSyncType() != Stat::SYNC_SUM) {
+    stat.increment(amount);
+    return;
+  }
+
+  for (int i = 0; i < state_->stat_delta_count_; ++i) {
+    if (state_->stat_deltas_[i].stat_ == &stat) {
+      state_->stat_deltas_[i].amount_ += amount;
+      return;
+    }
+  }
+
+  if (state_->stat_delta_count_ == MAX_BUFFERED_STATS) {
+    stat.increment(amount);
+    return;
+  }
+
+  StatDelta &delta = state_->stat_deltas_[state_->stat_delta_count_++];
+  delta.stat_ = &stat;
+  delta.amount_ = amount;
+}
+
+void Transaction::flushStats() {
+  LOG_DEBUG("Transaction tshttptxn=%p flushing %d buffered stats", state_->txn_, state_->stat_delta_count_);
+  for (int i = 0; i < state_->stat_delta_count_; ++i) {
+    if (state_->stat_deltas_[i].amount_ != 0) {
+      // A Stat the owner sharded goes to this thread's shard, the others to the Traffic Server stat.
+      state_->stat_deltas_[i].stat_->increment(state_->stat_deltas_[i].amount_);
+    }
+  }
+  state_->stat_delta_count_ = 0;
+}
+
 shared_ptr<Transaction::ContextValue> Transaction::getContextValue(const std::string &key) {
   shared_ptr<Transaction::ContextValue> return_context_value;
   map<string, shared_ptr<Transaction::ContextValue> >::iterator iter = state_->context_values_.find(key);
@@ -188,6 +237,37 @@ bool Transaction::setCacheUrl(const string &cache_url) {
     return (res == TS_SUCCESS);
 }
 
+Transaction::CacheStatus Transaction::getCacheStatus() const {
+  int status = 0;
+  if (TSHttpTxnCacheLookupStatusGet(state_->txn_, &status) != TS_SUCCESS) {
+    LOG_DEBUG("Unable to get the cache lookup status of transaction %p", state_->txn_);
+    return CACHE_LOOKUP_NONE;
+  }
+
+  switch (status) {
+  case TS_CACHE_LOOKUP_MISS:
+    return CACHE_LOOKUP_MISS;
+  case TS_CACHE_LOOKUP_HIT_STALE:
+    return CACHE_LOOKUP_HIT_STALE;
+  case TS_CACHE_LOOKUP_HIT_FRESH:
+    return CACHE_LOOKUP_HIT_FRESH;
+  case TS_CACHE_LOOKUP_SKIPPED:
+    return CACHE_LOOKUP_SKIPPED;
+  default:
+    return CACHE_LOOKUP_NONE;
+  }
+}
+
+void Transaction::setTransformedResponseCached(bool cached) {
+  LOG_DEBUG("Setting transformed response cached=%d on transaction %p", cached, state_->txn_);
+  TSHttpTxnTransformedRespCache(state_->txn_, cached ? 1 : 0);
+}
+
+void Transaction::setUntransformedResponseCached(bool cached) {
+  LOG_DEBUG("Setting untransformed response cached=%d on transaction %p", cached, state_->txn_);
+  TSHttpTxnUntransformedRespCache(state_->txn_, cached ? 1 : 0);
+}
+
 const sockaddr *Transaction::getIncomingAddress() const {
   return TSHttpTxnIncomingAddrGet(state_->txn_);
 }
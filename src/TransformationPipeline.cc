@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransformationPipeline.cc
+ */
+
+#include "atscppapi/TransformationPipeline.h"
+#include <vector>
+#include "atscppapi/noncopyable.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+/**
+ * @private
+ */
+struct atscppapi::TransformationPipelineState: noncopyable {
+  vector<TransformationPipeline::Stage *> stages_;
+  bool started_;
+
+  TransformationPipelineState() : started_(false) { }
+
+  ~TransformationPipelineState() {
+    for (vector<TransformationPipeline::Stage *>::iterator iter = stages_.begin(), end = stages_.end(); iter != end; ++iter) {
+      delete *iter;
+    }
+  }
+};
+
+TransformationPipeline::Stage::Stage() : next_(NULL), pipeline_(NULL), bytes_produced_(0), wakeup_requested_(false) {
+}
+
+TransformationPipeline::Stage::~Stage() {
+}
+
+void TransformationPipeline::Stage::handleWakeup() {
+}
+
+void TransformationPipeline::Stage::handleOutputDrained() {
+}
+
+size_t TransformationPipeline::Stage::produce(const string &data) {
+  if (data.empty()) {
+    return 0;
+  }
+
+  bytes_produced_ += data.length();
+  if (next_) {
+    next_->consume(data);
+    return data.length();
+  }
+  return pipeline_->TransformationPlugin::produce(data);
+}
+
+size_t TransformationPipeline::Stage::setOutputComplete() {
+  if (next_) {
+    next_->handleInputComplete();
+  } else {
+    pipeline_->TransformationPlugin::setOutputComplete();
+  }
+  return static_cast<size_t>(bytes_produced_);
+}
+
+void TransformationPipeline::Stage::abortOutput() {
+  pipeline_->TransformationPlugin::abortOutput();
+}
+
+void TransformationPipeline::Stage::scheduleWakeup(int delay_ms) {
+  wakeup_requested_ = true;
+  pipeline_->TransformationPlugin::scheduleWakeup(delay_ms);
+}
+
+TransformationPipeline::TransformationPipeline(Transaction &transaction, TransformationPlugin::Type type)
+  : TransformationPlugin(transaction, type) {
+  state_ = new TransformationPipelineState();
+}
+
+TransformationPipeline::~TransformationPipeline() {
+  delete state_;
+}
+
+void TransformationPipeline::addStage(Stage *stage) {
+  if (state_->started_) {
+    LOG_ERROR("TransformationPipeline=%p cannot add stage=%p after data has started flowing.", this, stage);
+    delete stage;
+    return;
+  }
+
+  stage->pipeline_ = this;
+  if (!state_->stages_.empty()) {
+    state_->stages_.back()->next_ = stage;
+  }
+  state_->stages_.push_back(stage);
+  LOG_DEBUG("TransformationPipeline=%p added stage=%p, total stages=%d", this, stage,
+            static_cast<int>(state_->stages_.size()));
+}
+
+void TransformationPipeline::consume(const string &data) {
+  state_->started_ = true;
+  if (state_->stages_.empty()) {
+    TransformationPlugin::produce(data);
+    return;
+  }
+  state_->stages_.front()->consume(data);
+}
+
+void TransformationPipeline::handleInputComplete() {
+  state_->started_ = true;
+  if (state_->stages_.empty()) {
+    TransformationPlugin::setOutputComplete();
+    return;
+  }
+  state_->stages_.front()->handleInputComplete();
+}
+
+void TransformationPipeline::handleWakeup() {
+  for (vector<Stage *>::iterator iter = state_->stages_.begin(), end = state_->stages_.end(); iter != end; ++iter) {
+    if ((*iter)->wakeup_requested_) {
+      (*iter)->wakeup_requested_ = false;
+      (*iter)->handleWakeup();
+    }
+  }
+}
+
+void TransformationPipeline::handleOutputDrained() {
+  for (vector<Stage *>::iterator iter = state_->stages_.begin(), end = state_->stages_.end(); iter != end; ++iter) {
+    (*iter)->handleOutputDrained();
+  }
+}
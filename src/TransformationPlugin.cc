@@ -17,12 +17,17 @@
  */
 
 #include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/TransformationPipeline.h"
 
 #include <ts/ts.h>
 #include <cstddef>
+#include <deque>
+#include <pthread.h>
 #include "utils_internal.h"
 #include "logging_internal.h"
 #include "atscppapi/noncopyable.h"
+#include "atscppapi/Mutex.h"
+#include "atscppapi/shared_ptr.h"
 
 #ifndef INT64_MAX
 #define INT64_MAX (9223372036854775807LL)
@@ -31,6 +36,60 @@
 using namespace atscppapi;
 using atscppapi::TransformationPlugin;
 
+namespace {
+const int64_t DEFAULT_OUTPUT_HIGH_WATERMARK = 256 * 1024;
+const int64_t DEFAULT_OUTPUT_LOW_WATERMARK = 64 * 1024;
+
+/**
+ * A unit of work handed between the net thread that owns the transformation vconn and
+ * the task thread running consume()/handleInputComplete() when offloading is enabled.
+ */
+struct OffloadItem {
+  enum Type {
+    INPUT_DATA = 0, /**< data to pass to consume() */
+    INPUT_COMPLETE, /**< call handleInputComplete() */
+    OUTPUT_DATA, /**< data passed to produce() */
+    OUTPUT_COMPLETE, /**< setOutputComplete() was called */
+    OUTPUT_ABORT, /**< abortOutput() was called */
+    WAKEUP, /**< call handleWakeup() */
+    SCHEDULE_WAKEUP, /**< scheduleWakeup() was called */
+    CHUNK_DONE /**< the task thread finished with one input item */
+  };
+  Type type_;
+  std::string data_;
+  int delay_ms_; // only used by SCHEDULE_WAKEUP
+
+  OffloadItem() : type_(INPUT_DATA), delay_ms_(0) { }
+  OffloadItem(Type type, const std::string &data = std::string()) : type_(type), data_(data), delay_ms_(0) { }
+};
+
+/**
+ * State shared by a TransformationPlugin and the task thread it offloads to. The task thread
+ * holds a reference to this so that it is safe to touch even after the transformation is gone.
+ */
+struct OffloadState: noncopyable {
+  Mutex mutex_; // protects everything below except in_flight_ which is only used on the net thread.
+  std::deque<OffloadItem> input_;
+  std::deque<OffloadItem> output_;
+  bool worker_scheduled_;
+  bool worker_running_;
+  pthread_t worker_thread_;
+  bool cancelled_;
+  size_t bytes_produced_;
+  TransformationPlugin *transformation_plugin_;
+  shared_ptr<Mutex> plugin_mutex_;
+  TSVConn vconn_;
+  int max_in_flight_;
+  int in_flight_;
+
+  OffloadState(TransformationPlugin *transformation_plugin, shared_ptr<Mutex> plugin_mutex,
+      TSVConn vconn, int max_in_flight)
+    : worker_scheduled_(false), worker_running_(false), worker_thread_(pthread_t()), cancelled_(false),
+      bytes_produced_(0), transformation_plugin_(transformation_plugin), plugin_mutex_(plugin_mutex),
+      vconn_(vconn), max_in_flight_(max_in_flight), in_flight_(0) { }
+};
+}
+
 /**
  * @private
  */
@@ -44,6 +103,19 @@ struct atscppapi::TransformationPluginState: noncopyable {
   TSIOBuffer output_buffer_;
   TSIOBufferReader output_buffer_reader_;
   int64_t bytes_written_;
+  int64_t output_length_; // -1 until a TransformationPlugin declares its output length.
+  int64_t output_high_watermark_;
+  int64_t output_low_watermark_;
+  int64_t peak_buffered_output_;
+  int input_pause_count_;
+  bool input_paused_;
+  bool output_aborted_;
+  bool output_completed_;
+  TSAction wakeup_action_; // set while a wakeup requested with scheduleWakeup() is pending.
+
+  // Only set for a PIPELINE_STAGE once it was added to a TransformationPipeline, a PIPELINE_STAGE has no
+  // vconn of its own and passes all of its output through this Stage instead.
+  TransformationPipeline::Stage *pipeline_stage_;
 
   // We can only send a single WRITE_COMPLETE even though
   // we may receive an immediate event after we've sent a
@@ -51,11 +123,16 @@ struct atscppapi::TransformationPluginState: noncopyable {
   // sent the input end our write complte.
   bool input_complete_dispatched_;
 
+  // Only set when consume() and handleInputComplete() are offloaded to the task thread pool.
+  shared_ptr<OffloadState> offload_;
+
   TransformationPluginState(atscppapi::Transaction &transaction, TransformationPlugin &transformation_plugin,
       TransformationPlugin::Type type, TSHttpTxn txn)
     : vconn_(NULL), transaction_(transaction), transformation_plugin_(transformation_plugin), type_(type),
       output_vio_(NULL), txn_(txn), output_buffer_(NULL), output_buffer_reader_(NULL), bytes_written_(0),
-      input_complete_dispatched_(false) {
+      output_length_(-1), output_high_watermark_(DEFAULT_OUTPUT_HIGH_WATERMARK), output_low_watermark_(DEFAULT_OUTPUT_LOW_WATERMARK),
+      peak_buffered_output_(0), input_pause_count_(0), input_paused_(false), output_aborted_(false),
+      output_completed_(false), wakeup_action_(NULL), pipeline_stage_(NULL), input_complete_dispatched_(false) {
     output_buffer_ = TSIOBufferCreate();
     output_buffer_reader_ = TSIOBufferReaderAlloc(output_buffer_);
   };
@@ -75,13 +152,399 @@ struct atscppapi::TransformationPluginState: noncopyable {
 
 namespace {
 
+void abortTransformationOutput(TransformationPluginState *state);
+
 void cleanupTransformation(TSCont contp) {
   LOG_DEBUG("Destroying transformation contp=%p", contp);
   TSContDataSet(contp, reinterpret_cast<void *>(0xDEADDEAD));
   TSContDestroy(contp);
 }
 
+size_t writeOutput(TransformationPluginState *state, const char *data, size_t length) {
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p producing output with length=%lu", &state->transformation_plugin_,
+      state->txn_, static_cast<unsigned long>(length));
+  int64_t write_length = static_cast<int64_t>(length);
+  if (!write_length) {
+    return 0;
+  }
+
+  if (state->output_aborted_) {
+    LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p dropping %ld bytes of output, the output was aborted.",
+        &state->transformation_plugin_, state->txn_, write_length);
+    return 0;
+  }
+
+  if (state->output_length_ >= 0 && state->bytes_written_ + write_length > state->output_length_) {
+    // Traffic Server already promised the declared length downstream, more bytes would corrupt the response.
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p producing %lld bytes would exceed the declared output length=%lld, "
+        "bytes already written=%lld, aborting the output.", &state->transformation_plugin_, state->txn_,
+        static_cast<long long>(write_length), static_cast<long long>(state->output_length_),
+        static_cast<long long>(state->bytes_written_));
+    abortTransformationOutput(state);
+    return 0;
+  }
+
+  if (!state->output_vio_) {
+    TSVConn output_vconn = TSTransformOutputVConnGet(state->vconn_);
+    LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p will issue a TSVConnWrite, output_vconn=%p.", &state->transformation_plugin_, state->txn_, output_vconn);
+    if (output_vconn) {
+      // If you're confused about the following reference the traffic server transformation docs.
+      // Unless the output length was declared we write INT64_MAX, this basically says you're not sure
+      // how much data you're going to write and the response will be sent chunked. When the length is
+      // known Traffic Server will use it for the Content-Length of the transformed response.
+      int64_t nbytes = (state->output_length_ >= 0) ? state->output_length_ : INT64_MAX;
+      state->output_vio_ = TSVConnWrite(output_vconn, state->vconn_, state->output_buffer_reader_, nbytes);
+    } else {
+      LOG_ERROR("TransformationPlugin=%p tshttptxn=%p output_vconn=%p cannot issue TSVConnWrite due to null output vconn.",
+          &state->transformation_plugin_, state->txn_, output_vconn);
+      return 0;
+    }
+
+    if (!state->output_vio_) {
+      LOG_ERROR("TransformationPlugin=%p tshttptxn=%p state->output_vio=%p, TSVConnWrite failed.",
+          &state->transformation_plugin_, state->txn_, state->output_vio_);
+      return 0;
+    }
+  }
+
+  // Finally we can copy this data into the output_buffer
+  int64_t bytes_written = TSIOBufferWrite(state->output_buffer_, data, write_length);
+  state->bytes_written_ += bytes_written; // So we can set BytesDone on outputComplete().
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p write to TSIOBuffer %lld bytes total bytes written %lld",
+      &state->transformation_plugin_, state->txn_, static_cast<long long>(bytes_written),
+      static_cast<long long>(state->bytes_written_));
+
+  int64_t buffered = TSIOBufferReaderAvail(state->output_buffer_reader_);
+  if (buffered > state->peak_buffered_output_) {
+    state->peak_buffered_output_ = buffered;
+  }
+
+  // Sanity Checks
+  if (bytes_written != write_length) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p bytes written < expected. bytes_written=%lld write_length=%lld",
+        &state->transformation_plugin_, state->txn_, static_cast<long long>(bytes_written),
+        static_cast<long long>(write_length));
+  }
+
+  int connection_closed = TSVConnClosedGet(state->vconn_);
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p vconn=%p connection_closed=%d", &state->transformation_plugin_, state->txn_, state->vconn_, connection_closed);
+
+  if (!connection_closed) {
+    TSVIOReenable(state->output_vio_); // Wake up the downstream vio
+  } else {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p output_vio=%p connection_closed=%d : Couldn't reenable output vio (connection closed).", &state->transformation_plugin_, state->txn_, state->output_vio_, connection_closed);
+  }
+
+  return static_cast<size_t>(bytes_written);
+}
+
+size_t completeOutput(TransformationPluginState *state) {
+  if (state->output_aborted_) {
+    LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p ignoring output complete, the output was aborted.",
+        &state->transformation_plugin_, state->txn_);
+    return state->bytes_written_;
+  }
+
+  if (state->output_length_ >= 0 && state->bytes_written_ != state->output_length_) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p wrote %lld bytes but declared an output length of %lld bytes, "
+        "aborting the output.", &state->transformation_plugin_, state->txn_,
+        static_cast<long long>(state->bytes_written_), static_cast<long long>(state->output_length_));
+    abortTransformationOutput(state);
+    return state->bytes_written_;
+  }
+
+  state->output_completed_ = true;
+  int connection_closed = TSVConnClosedGet(state->vconn_);
+  LOG_DEBUG("OutputComplete TransformationPlugin=%p tshttptxn=%p vconn=%p connection_closed=%d, total bytes written=%lld",
+      &state->transformation_plugin_, state->txn_, state->vconn_, connection_closed,
+      static_cast<long long>(state->bytes_written_));
+
+  if (!connection_closed && !state->output_vio_) {
+      LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p output complete without writing any data, initiating write of 0 bytes.", &state->transformation_plugin_, state->txn_);
+
+      // We're done without ever outputting anything, to correctly
+      // clean up we'll initiate a write then immeidately set it to 0 bytes done.
+      state->output_vio_ = TSVConnWrite(TSTransformOutputVConnGet(state->vconn_), state->vconn_, state->output_buffer_reader_, 0);
+
+      if (state->output_vio_) {
+        TSVIONDoneSet(state->output_vio_, 0);
+        TSVIOReenable(state->output_vio_); // Wake up the downstream vio
+      } else {
+        LOG_ERROR("TransformationPlugin=%p tshttptxn=%p unable to reenable output_vio=%p because VConnWrite failed.", &state->transformation_plugin_, state->txn_, state->output_vio_);
+      }
+
+      return 0;
+  }
+
+  if (!connection_closed) {
+    // So there is a possible race condition here, if we wake up a dead
+    // VIO it can cause a segfault, so we must check that the VCONN is not dead.
+    int connection_closed = TSVConnClosedGet(state->vconn_);
+    if (!connection_closed) {
+      TSVIONBytesSet(state->output_vio_, state->bytes_written_);
+      TSVIOReenable(state->output_vio_); // Wake up the downstream vio
+    } else {
+      LOG_ERROR("TransformationPlugin=%p tshttptxn=%p unable to reenable output_vio=%p connection was closed=%d.", &state->transformation_plugin_, state->txn_, state->output_vio_, connection_closed);
+    }
+  } else {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p unable to reenable output_vio=%p connection was closed=%d.", &state->transformation_plugin_, state->txn_, state->output_vio_, connection_closed);
+  }
+
+  return state->bytes_written_;
+}
+
+void abortTransformationOutput(TransformationPluginState *state) {
+  if (state->output_aborted_) {
+    return;
+  }
+
+  LOG_ERROR("TransformationPlugin=%p tshttptxn=%p aborting output after %ld bytes were written.",
+      &state->transformation_plugin_, state->txn_, state->bytes_written_);
+  state->output_aborted_ = true;
+  if (state->offload_) {
+    ScopedMutexLock lock(state->offload_->mutex_);
+    state->offload_->input_.clear();
+  }
+
+  // A partial body must never be stored as if it were the whole object.
+  TSHttpTxnServerRespNoStoreSet(state->txn_, 1);
+  TSHttpTxnTransformedRespCache(state->txn_, 0);
+
+  if (!TSVConnClosedGet(state->vconn_)) {
+    // Aborting rather than completing the output vconn makes Traffic Server tear down the transfer,
+    // so the partial output can't be mistaken for a complete body.
+    TSVConn output_vconn = TSTransformOutputVConnGet(state->vconn_);
+    if (output_vconn) {
+      TSVConnAbort(output_vconn, 1);
+    }
+  }
+}
+
+void scheduleTransformationWakeup(TransformationPluginState *state, int delay_ms) {
+  if (state->wakeup_action_) {
+    return;
+  }
+  if (delay_ms < 1) {
+    delay_ms = 1; // a delay of 0 would be delivered as TS_EVENT_IMMEDIATE, which the offload worker also sends.
+  }
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p scheduling a wakeup in %dms", &state->transformation_plugin_,
+      state->txn_, delay_ms);
+  state->wakeup_action_ = TSContSchedule(state->vconn_, delay_ms, TS_THREAD_POOL_DEFAULT);
+}
+
+bool isOffloadWorkerThread(const shared_ptr<OffloadState> &offload) {
+  ScopedMutexLock lock(offload->mutex_);
+  return offload->worker_running_ && pthread_equal(offload->worker_thread_, pthread_self());
+}
+
+/**
+ * Called on the task thread when produce() or setOutputComplete() are invoked from an offloaded
+ * consume() or handleInputComplete(), the output is written by the net thread in the order it was queued.
+ */
+size_t queueOffloadOutput(const shared_ptr<OffloadState> &offload, const OffloadItem &item) {
+  ScopedMutexLock lock(offload->mutex_);
+  offload->bytes_produced_ += item.data_.length();
+  offload->output_.push_back(item);
+  return (item.type_ == OffloadItem::OUTPUT_DATA) ? item.data_.length() : offload->bytes_produced_;
+}
+
+/**
+ * Runs on a task thread, this will process queued input until there is none left. The plugin mutex
+ * is held while calling into the TransformationPlugin, since the TransformationPlugin is destroyed
+ * under that same mutex this guarantees it cannot go away underneath us.
+ */
+void runOffloadWorker(const shared_ptr<OffloadState> &offload) {
+  while (true) {
+    ScopedSharedMutexLock plugin_lock(offload->plugin_mutex_);
+    OffloadItem item;
+    {
+      ScopedMutexLock lock(offload->mutex_);
+      if (offload->cancelled_ || offload->input_.empty()) {
+        offload->worker_scheduled_ = false;
+        return;
+      }
+      item = offload->input_.front();
+      offload->input_.pop_front();
+      offload->worker_running_ = true;
+      offload->worker_thread_ = pthread_self();
+    }
+
+    LOG_DEBUG("Offloaded TransformationPlugin=%p processing item type=%d with length=%lu",
+        offload->transformation_plugin_, item.type_, static_cast<unsigned long>(item.data_.length()));
+    if (item.type_ == OffloadItem::INPUT_DATA) {
+      offload->transformation_plugin_->consume(item.data_);
+    } else if (item.type_ == OffloadItem::WAKEUP) {
+      offload->transformation_plugin_->handleWakeup();
+    } else {
+      offload->transformation_plugin_->handleInputComplete();
+    }
+
+    {
+      ScopedMutexLock lock(offload->mutex_);
+      offload->worker_running_ = false;
+      offload->output_.push_back(OffloadItem(OffloadItem::CHUNK_DONE));
+    }
+
+    // Wake up the net thread so it can write our output and read more input, we're still holding
+    // the plugin mutex so the vconn cannot have been destroyed yet.
+    TSContSchedule(offload->vconn_, 0, TS_THREAD_POOL_DEFAULT);
+  }
+}
+
+int handleOffloadWorkerEvents(TSCont contp, TSEvent event, void *edata) {
+  shared_ptr<OffloadState> *offload = static_cast<shared_ptr<OffloadState> *>(TSContDataGet(contp));
+  runOffloadWorker(*offload);
+  delete offload;
+  TSContDestroy(contp);
+  return 0;
+}
+
+/**
+ * Hands an input item to the task thread pool, a new worker is only scheduled if one isn't
+ * already processing this transformation's input so that items are always handled in order.
+ */
+void dispatchOffloadInput(TransformationPluginState *state, const OffloadItem &item) {
+  shared_ptr<OffloadState> &offload = state->offload_;
+  ++offload->in_flight_;
+  ScopedMutexLock lock(offload->mutex_);
+  offload->input_.push_back(item);
+  if (!offload->worker_scheduled_) {
+    offload->worker_scheduled_ = true;
+    TSCont worker_contp = TSContCreate(handleOffloadWorkerEvents, NULL);
+    TSContDataSet(worker_contp, static_cast<void *>(new shared_ptr<OffloadState>(offload)));
+    TSContSchedule(worker_contp, 0, TS_THREAD_POOL_TASK);
+  }
+}
+
+void dispatchConsume(TransformationPluginState *state, const std::string &data) {
+  if (state->output_aborted_) {
+    return; // the input is still read so the upstream can finish, but nothing is done with it.
+  }
+  if (state->offload_) {
+    dispatchOffloadInput(state, OffloadItem(OffloadItem::INPUT_DATA, data));
+  } else {
+    state->transformation_plugin_.consume(data);
+  }
+}
+
+void dispatchWakeup(TransformationPluginState *state) {
+  if (state->output_aborted_ || state->output_completed_) {
+    return;
+  }
+  if (state->offload_) {
+    dispatchOffloadInput(state, OffloadItem(OffloadItem::WAKEUP));
+  } else {
+    state->transformation_plugin_.handleWakeup();
+  }
+}
+
+void dispatchInputComplete(TransformationPluginState *state) {
+  if (state->output_aborted_) {
+    return;
+  }
+  if (state->offload_) {
+    dispatchOffloadInput(state, OffloadItem(OffloadItem::INPUT_COMPLETE));
+  } else {
+    state->transformation_plugin_.handleInputComplete();
+  }
+}
+
+/**
+ * Runs on the net thread, writes any output the task thread has queued in the order it was produced.
+ */
+void drainOffloadOutput(TransformationPluginState *state) {
+  std::deque<OffloadItem> output;
+  {
+    ScopedMutexLock lock(state->offload_->mutex_);
+    output.swap(state->offload_->output_);
+  }
+
+  for (std::deque<OffloadItem>::iterator iter = output.begin(); iter != output.end(); ++iter) {
+    switch (iter->type_) {
+    case OffloadItem::OUTPUT_DATA:
+      writeOutput(state, iter->data_.data(), iter->data_.length());
+      break;
+    case OffloadItem::OUTPUT_COMPLETE:
+      completeOutput(state);
+      break;
+    case OffloadItem::OUTPUT_ABORT:
+      abortTransformationOutput(state);
+      break;
+    case OffloadItem::SCHEDULE_WAKEUP:
+      scheduleTransformationWakeup(state, iter->delay_ms_);
+      break;
+    case OffloadItem::CHUNK_DONE:
+      --state->offload_->in_flight_;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/**
+ * Decides whether we can read more input given how much of our output is still waiting
+ * to be read downstream. Once paused, input is resumed by the WRITE_READY events the downstream
+ * consumer sends us as it drains the output buffer.
+ */
+bool isInputPausedByOutput(TSCont contp, TransformationPluginState *state) {
+  if (state->offload_ && state->offload_->in_flight_ >= state->offload_->max_in_flight_) {
+    LOG_DEBUG("Transformation contp=%p pausing input, in flight chunks=%d >= max=%d", contp,
+        state->offload_->in_flight_, state->offload_->max_in_flight_);
+    return true;
+  }
+
+  if (state->output_high_watermark_ <= 0) {
+    return false;
+  }
+
+  int64_t buffered = TSIOBufferReaderAvail(state->output_buffer_reader_);
+  if (state->input_paused_) {
+    if (buffered > state->output_low_watermark_) {
+      LOG_DEBUG("Transformation contp=%p input remains paused, buffered output=%ld > low watermark=%ld", contp, buffered,
+          state->output_low_watermark_);
+      return true;
+    }
+    LOG_DEBUG("Transformation contp=%p resuming input, buffered output=%ld <= low watermark=%ld", contp, buffered,
+        state->output_low_watermark_);
+    state->input_paused_ = false;
+  } else if (buffered >= state->output_high_watermark_) {
+    LOG_DEBUG("Transformation contp=%p pausing input, buffered output=%ld >= high watermark=%ld", contp, buffered,
+        state->output_high_watermark_);
+    state->input_paused_ = true;
+    ++state->input_pause_count_;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Lets the TransformationPlugin know that it can produce more output, this happens whenever we're woken up
+ * while the output waiting downstream is at or below the low watermark.
+ */
+void dispatchOutputDrained(TransformationPluginState *state) {
+  if (state->output_completed_ || state->output_aborted_) {
+    return;
+  }
+
+  // While offloaded the task thread may be inside the TransformationPlugin, wait until it has gone idle.
+  if (state->offload_ && state->offload_->in_flight_ > 0) {
+    return;
+  }
+
+  if (state->output_high_watermark_ > 0 &&
+      TSIOBufferReaderAvail(state->output_buffer_reader_) > state->output_low_watermark_) {
+    return;
+  }
+
+  state->transformation_plugin_.handleOutputDrained();
+}
+
 int handleTransformationPluginRead(TSCont contp, TransformationPluginState *state) {
+  if (isInputPausedByOutput(contp, state)) {
+    return 0;
+  }
+
   // Traffic Server naming is quite confusing, in this context the write_vio
   // is actually the vio we read from.
   TSVIO write_vio = TSVConnWriteVIOGet(contp);
@@ -126,7 +589,7 @@ int handleTransformationPluginRead(TSCont contp, TransformationPluginState *stat
 
         /* Now call the client to tell them about data */
         if (in_data.length() > 0) {
-           state->transformation_plugin_.consume(in_data);
+           dispatchConsume(state, in_data);
         }
       }
 
@@ -149,7 +612,7 @@ int handleTransformationPluginRead(TSCont contp, TransformationPluginState *stat
 
         /* Call back the write VIO continuation to let it know that we have completed the write operation. */
         if (!state->input_complete_dispatched_) {
-         state->transformation_plugin_.handleInputComplete();
+         dispatchInputComplete(state);
          state->input_complete_dispatched_ = true;
          if (vio_cont) {
            TSContCall(vio_cont, static_cast<TSEvent>(TS_EVENT_VCONN_WRITE_COMPLETE), write_vio);
@@ -162,7 +625,7 @@ int handleTransformationPluginRead(TSCont contp, TransformationPluginState *stat
 
       /* Call back the write VIO continuation to let it know that we have completed the write operation. */
       if (!state->input_complete_dispatched_) {
-       state->transformation_plugin_.handleInputComplete();
+       dispatchInputComplete(state);
        state->input_complete_dispatched_ = true;
        if (vio_cont) {
          TSContCall(vio_cont, static_cast<TSEvent>(TS_EVENT_VCONN_WRITE_COMPLETE), write_vio);
@@ -179,6 +642,14 @@ int handleTransformationPluginEvents(TSCont contp, TSEvent event, void *edata) {
   TransformationPluginState *state = static_cast<TransformationPluginState *>(TSContDataGet(contp));
   LOG_DEBUG("Transformation contp=%p event=%d edata=%p tshttptxn=%p", contp, event, edata, state->txn_);
 
+  // A timeout is the wakeup firing, its Event is freed once we return so it must never be cancelled,
+  // even when the VConn has been closed in the meantime.
+  bool woke_up = false;
+  if (event == TS_EVENT_TIMEOUT) {
+    woke_up = (state->wakeup_action_ != NULL);
+    state->wakeup_action_ = NULL;
+  }
+
   // The first thing you always do is check if the VConn is closed.
   int connection_closed = TSVConnClosedGet(state->vconn_);
   if (connection_closed) {
@@ -187,6 +658,15 @@ int handleTransformationPluginEvents(TSCont contp, TSEvent event, void *edata) {
     return 0;
   }
 
+  if (state->offload_) {
+    drainOffloadOutput(state);
+  }
+
+  if (woke_up) {
+    LOG_DEBUG("Transformation contp=%p tshttptxn=%p woke up as requested", contp, state->txn_);
+    dispatchWakeup(state);
+  }
+
   if (event == TS_EVENT_VCONN_WRITE_COMPLETE) {
     TSVConn output_vconn = TSTransformOutputVConnGet(state->vconn_);
     LOG_DEBUG("Transformation contp=%p tshttptxn=%p received WRITE_COMPLETE, shutting down outputvconn=%p ", contp, state->txn_, output_vconn);
@@ -207,6 +687,7 @@ int handleTransformationPluginEvents(TSCont contp, TSEvent event, void *edata) {
   }
 
   // All other events includign WRITE_READY will just attempt to transform more data.
+  dispatchOutputDrained(state);
   return handleTransformationPluginRead(state->vconn_, state);
 }
 
@@ -215,6 +696,10 @@ int handleTransformationPluginEvents(TSCont contp, TSEvent event, void *edata) {
 TransformationPlugin::TransformationPlugin(Transaction &transaction, TransformationPlugin::Type type)
   : TransactionPlugin(transaction) {
   state_ = new TransformationPluginState(transaction, *this, type, static_cast<TSHttpTxn>(transaction.getAtsHandle()));
+  if (type == PIPELINE_STAGE) {
+    LOG_DEBUG("Creating TransformationPlugin=%p tshttptxn=%p as a pipeline stage", this, state_->txn_);
+    return;
+  }
   state_->vconn_ = TSTransformCreate(handleTransformationPluginEvents, state_->txn_);
   TSContDataSet(state_->vconn_, static_cast<void *>(state_)); // edata in a TransformationHandler is NOT a TSHttpTxn.
   LOG_DEBUG("Creating TransformationPlugin=%p (vconn)contp=%p tshttptxn=%p transformation_type=%d", this, state_->vconn_, state_->txn_, type);
@@ -223,93 +708,224 @@ TransformationPlugin::TransformationPlugin(Transaction &transaction, Transformat
 
 TransformationPlugin::~TransformationPlugin() {
   LOG_DEBUG("Destroying TransformationPlugin=%p", this);
-  cleanupTransformation(state_->vconn_);
+  if (state_->offload_) {
+    // We're destroyed under the plugin mutex so the task thread cannot be inside consume(), make sure
+    // that it never calls into us again.
+    ScopedMutexLock lock(state_->offload_->mutex_);
+    state_->offload_->cancelled_ = true;
+    state_->offload_->input_.clear();
+  }
+  if (state_->wakeup_action_) {
+    TSActionCancel(state_->wakeup_action_);
+  }
+  if (state_->vconn_) {
+    cleanupTransformation(state_->vconn_);
+  }
   delete state_;
 }
 
-size_t TransformationPlugin::produce(const std::string &data) {
-  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p producing output with length=%d", this, state_->txn_, data.length());
-  int64_t write_length = static_cast<int64_t>(data.length());
-  if (!write_length) {
-    return 0;
+void TransformationPlugin::handleOutputDrained() {
+}
+
+void TransformationPlugin::handleWakeup() {
+}
+
+void TransformationPlugin::scheduleWakeup(int delay_ms) {
+  if (state_->type_ == PIPELINE_STAGE) {
+    if (state_->pipeline_stage_) {
+      state_->pipeline_stage_->scheduleWakeup(delay_ms);
+    }
+    return;
   }
+  if (state_->offload_ && isOffloadWorkerThread(state_->offload_)) {
+    OffloadItem item(OffloadItem::SCHEDULE_WAKEUP);
+    item.delay_ms_ = delay_ms;
+    queueOffloadOutput(state_->offload_, item);
+    return;
+  }
+  scheduleTransformationWakeup(state_, delay_ms);
+}
 
-  if (!state_->output_vio_) {
-    TSVConn output_vconn = TSTransformOutputVConnGet(state_->vconn_);
-    LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p will issue a TSVConnWrite, output_vconn=%p.", this, state_->txn_, output_vconn);
-    if (output_vconn) {
-      // If you're confused about the following reference the traffic server transformation docs.
-      // You always write INT64_MAX, this basically says you're not sure how much data you're going to write
-      state_->output_vio_ = TSVConnWrite(output_vconn, state_->vconn_, state_->output_buffer_reader_, INT64_MAX);
-    } else {
-      LOG_ERROR("TransformationPlugin=%p tshttptxn=%p output_vconn=%p cannot issue TSVConnWrite due to null output vconn.",
-          this, state_->txn_, output_vconn);
+size_t TransformationPlugin::produce(const std::string &data) {
+  return produce(data.data(), data.length());
+}
+
+size_t TransformationPlugin::produce(const char *data, size_t length) {
+  if (state_->type_ == PIPELINE_STAGE) {
+    if (!state_->pipeline_stage_) {
+      LOG_ERROR("TransformationPlugin=%p pipeline stage dropping %lu bytes, it wasn't added to a TransformationPipeline.",
+          this, static_cast<unsigned long>(length));
       return 0;
     }
+    return state_->pipeline_stage_->produce(std::string(data, length));
+  }
+  if (state_->offload_ && isOffloadWorkerThread(state_->offload_)) {
+    LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p queueing offloaded output with length=%lu", this, state_->txn_,
+        static_cast<unsigned long>(length));
+    return queueOffloadOutput(state_->offload_, OffloadItem(OffloadItem::OUTPUT_DATA, std::string(data, length)));
+  }
+  if (state_->offload_) {
+    ScopedMutexLock lock(state_->offload_->mutex_);
+    state_->offload_->bytes_produced_ += length;
+  }
+  return writeOutput(state_, data, length);
+}
 
-    if (!state_->output_vio_) {
-      LOG_ERROR("TransformationPlugin=%p tshttptxn=%p state_->output_vio=%p, TSVConnWrite failed.",
-          this, state_->txn_, state_->output_vio_);
-      return 0;
+size_t TransformationPlugin::setOutputComplete() {
+  if (state_->type_ == PIPELINE_STAGE) {
+    return state_->pipeline_stage_ ? state_->pipeline_stage_->setOutputComplete() : 0;
+  }
+  if (state_->offload_ && isOffloadWorkerThread(state_->offload_)) {
+    LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p queueing offloaded output complete", this, state_->txn_);
+    return queueOffloadOutput(state_->offload_, OffloadItem(OffloadItem::OUTPUT_COMPLETE));
+  }
+  return completeOutput(state_);
+}
+
+void TransformationPlugin::abortOutput() {
+  if (state_->type_ == PIPELINE_STAGE) {
+    if (state_->pipeline_stage_) {
+      state_->pipeline_stage_->abortOutput();
     }
+    return;
+  }
+  if (state_->offload_ && isOffloadWorkerThread(state_->offload_)) {
+    LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p queueing offloaded output abort", this, state_->txn_);
+    queueOffloadOutput(state_->offload_, OffloadItem(OffloadItem::OUTPUT_ABORT));
+    return;
   }
+  abortTransformationOutput(state_);
+}
 
-  // Finally we can copy this data into the output_buffer
-  int64_t bytes_written = TSIOBufferWrite(state_->output_buffer_, data.c_str(), write_length);
-  state_->bytes_written_ += bytes_written; // So we can set BytesDone on outputComplete().
-  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p write to TSIOBuffer %d bytes total bytes written %d", this, state_->txn_, bytes_written, state_->bytes_written_);
+void TransformationPlugin::enableThreadPoolOffload(int max_in_flight_chunks) {
+  if (state_->type_ == PIPELINE_STAGE) {
+    LOG_ERROR("TransformationPlugin=%p a pipeline stage cannot offload, enable it on the TransformationPipeline.", this);
+    return;
+  }
+  if (max_in_flight_chunks < 1) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p max in flight chunks=%d must be at least 1, ignoring.", this,
+        state_->txn_, max_in_flight_chunks);
+    return;
+  }
+  if (state_->offload_) {
+    state_->offload_->max_in_flight_ = max_in_flight_chunks;
+    return;
+  }
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p offloading to the task thread pool with max in flight chunks=%d",
+      this, state_->txn_, max_in_flight_chunks);
+  state_->offload_.reset(new OffloadState(this, utils::internal::getTransactionPluginMutex(*this), state_->vconn_,
+      max_in_flight_chunks));
+}
 
-  // Sanity Checks
-  if (bytes_written != write_length) {
-    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p bytes written < expected. bytes_written=%d write_length=%d", this, state_->txn_, bytes_written, write_length);
+bool TransformationPlugin::setOutputLength(int64_t length) {
+  if (state_->type_ == PIPELINE_STAGE) {
+    LOG_ERROR("TransformationPlugin=%p a pipeline stage cannot set the output length.", this);
+    return false;
+  }
+  if (length < 0) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p cannot set a negative output length=%ld.", this, state_->txn_, length);
+    return false;
+  }
+  if (state_->output_vio_) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p cannot set output length=%ld after output has started.", this,
+        state_->txn_, length);
+    return false;
   }
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p setting output length=%ld", this, state_->txn_, length);
+  state_->output_length_ = length;
+  return true;
+}
 
-  int connection_closed = TSVConnClosedGet(state_->vconn_);
-  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p vconn=%p connection_closed=%d", this, state_->txn_, state_->vconn_, connection_closed);
+void TransformationPlugin::setOutputWatermarks(int64_t high_watermark, int64_t low_watermark) {
+  if (state_->type_ == PIPELINE_STAGE) {
+    LOG_ERROR("TransformationPlugin=%p a pipeline stage uses the watermarks of its TransformationPipeline.", this);
+    return;
+  }
+  if (high_watermark > 0 && low_watermark >= high_watermark) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p low watermark=%ld must be less than high watermark=%ld, ignoring.",
+        this, state_->txn_, low_watermark, high_watermark);
+    return;
+  }
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p setting output watermarks high=%ld low=%ld", this, state_->txn_,
+      high_watermark, low_watermark);
+  state_->output_high_watermark_ = high_watermark;
+  state_->output_low_watermark_ = low_watermark;
+}
 
-  if (!connection_closed) {
-    TSVIOReenable(state_->output_vio_); // Wake up the downstream vio
-  } else {
-    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p output_vio=%p connection_closed=%d : Couldn't reenable output vio (connection closed).", this, state_->txn_, state_->output_vio_, connection_closed);
+int64_t TransformationPlugin::getBufferedOutputBytes() const {
+  if (state_->type_ == PIPELINE_STAGE) {
+    return state_->pipeline_stage_ ? state_->pipeline_stage_->pipeline_->getBufferedOutputBytes() : 0;
   }
+  return TSIOBufferReaderAvail(state_->output_buffer_reader_);
+}
 
-  return static_cast<size_t>(bytes_written);
+int64_t TransformationPlugin::getPeakBufferedOutputBytes() const {
+  if (state_->type_ == PIPELINE_STAGE) {
+    return state_->pipeline_stage_ ? state_->pipeline_stage_->pipeline_->getPeakBufferedOutputBytes() : 0;
+  }
+  return state_->peak_buffered_output_;
 }
 
-size_t TransformationPlugin::setOutputComplete() {
-  int connection_closed = TSVConnClosedGet(state_->vconn_);
-  LOG_DEBUG("OutputComplete TransformationPlugin=%p tshttptxn=%p vconn=%p connection_closed=%d, total bytes written=%d", this, state_->txn_, state_->vconn_, connection_closed,state_->bytes_written_);
+int TransformationPlugin::getInputPauseCount() const {
+  if (state_->type_ == PIPELINE_STAGE) {
+    return state_->pipeline_stage_ ? state_->pipeline_stage_->pipeline_->getInputPauseCount() : 0;
+  }
+  return state_->input_pause_count_;
+}
 
-  if (!connection_closed && !state_->output_vio_) {
-      LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p output complete without writing any data, initiating write of 0 bytes.", this, state_->txn_);
+bool TransformationPlugin::isOutputAborted() const {
+  if (state_->type_ == PIPELINE_STAGE && state_->pipeline_stage_) {
+    return state_->pipeline_stage_->pipeline_->isOutputAborted();
+  }
+  return state_->output_aborted_;
+}
 
-      // We're done without ever outputting anything, to correctly
-      // clean up we'll initiate a write then immeidately set it to 0 bytes done.
-      state_->output_vio_ = TSVConnWrite(TSTransformOutputVConnGet(state_->vconn_), state_->vconn_, state_->output_buffer_reader_, 0);
+namespace {
 
-      if (state_->output_vio_) {
-        TSVIONDoneSet(state_->output_vio_, 0);
-        TSVIOReenable(state_->output_vio_); // Wake up the downstream vio
-      } else {
-        LOG_ERROR("TransformationPlugin=%p tshttptxn=%p unable to reenable output_vio=%p because VConnWrite failed.", this, state_->txn_, state_->output_vio_);
-      }
+/**
+ * Runs a TransformationPlugin created as a PIPELINE_STAGE inside a TransformationPipeline.
+ */
+class TransformationPluginStage : public TransformationPipeline::Stage {
+public:
+  TransformationPluginStage(TransformationPlugin *transformation_plugin)
+    : transformation_plugin_(transformation_plugin) { }
 
-      return 0;
+  void consume(const std::string &data) {
+    transformation_plugin_->consume(data);
   }
 
-  if (!connection_closed) {
-    // So there is a possible race condition here, if we wake up a dead
-    // VIO it can cause a segfault, so we must check that the VCONN is not dead.
-    int connection_closed = TSVConnClosedGet(state_->vconn_);
-    if (!connection_closed) {
-      TSVIONBytesSet(state_->output_vio_, state_->bytes_written_);
-      TSVIOReenable(state_->output_vio_); // Wake up the downstream vio
-    } else {
-      LOG_ERROR("TransformationPlugin=%p tshttptxn=%p unable to reenable output_vio=%p connection was closed=%d.", this, state_->txn_, state_->output_vio_, connection_closed);
-    }
-  } else {
-    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p unable to reenable output_vio=%p connection was closed=%d.", this, state_->txn_, state_->output_vio_, connection_closed);
+  void handleInputComplete() {
+    transformation_plugin_->handleInputComplete();
+  }
+
+  void handleWakeup() {
+    transformation_plugin_->handleWakeup();
+  }
+
+  void handleOutputDrained() {
+    transformation_plugin_->handleOutputDrained();
+  }
+
+  ~TransformationPluginStage() {
+    delete transformation_plugin_;
+  }
+private:
+  TransformationPlugin *transformation_plugin_;
+};
+
+}
+
+// This lives here rather than in TransformationPipeline.cc because it needs the TransformationPluginState.
+void TransformationPipeline::addStage(TransformationPlugin *transformation_plugin) {
+  if (transformation_plugin->state_->type_ != TransformationPlugin::PIPELINE_STAGE) {
+    // It already has a transform vconn of its own, the best we can do is let it run on its own.
+    LOG_ERROR("TransformationPipeline=%p TransformationPlugin=%p wasn't created as a PIPELINE_STAGE, adding it to "
+        "the transaction instead.", this, transformation_plugin);
+    transformation_plugin->state_->transaction_.addPlugin(transformation_plugin);
+    return;
   }
 
-  return state_->bytes_written_;
+  TransformationPluginStage *stage = new TransformationPluginStage(transformation_plugin);
+  transformation_plugin->state_->pipeline_stage_ = stage;
+  addStage(stage); // if the pipeline already started this deletes the stage and with it the TransformationPlugin.
 }
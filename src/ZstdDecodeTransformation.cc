@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ZstdDecodeTransformation.cc
+ */
+
+#include <string>
+#include <map>
+#include <vector>
+#include <zstd.h>
+#include <zstd_errors.h>
+#include "atscppapi/Mutex.h"
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/ZstdDecodeTransformation.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using atscppapi::Mutex;
+using atscppapi::ScopedMutexLock;
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+const size_t OUTPUT_BUFFER_SIZE = 32 * 1024;
+const int64_t EXPANSION_RATIO_MIN_OUTPUT = 1024 * 1024;
+
+typedef map<const CompressionDictionary *, ZSTD_DDict *> DigestedDictionaryMap;
+
+Mutex digested_dictionaries_mutex;
+DigestedDictionaryMap digested_dictionaries; // dictionaries live as long as the plugin so these are never freed.
+
+ZSTD_DDict *getDigestedDictionary(const CompressionDictionary *dictionary) {
+  ScopedMutexLock lock(digested_dictionaries_mutex);
+  DigestedDictionaryMap::iterator iter = digested_dictionaries.find(dictionary);
+  if (iter != digested_dictionaries.end()) {
+    return iter->second;
+  }
+
+  const string &data = dictionary->getData();
+  ZSTD_DDict *ddict = ZSTD_createDDict(data.data(), data.length());
+  if (!ddict) {
+    LOG_ERROR("Unable to digest zstd dictionary %u", dictionary->getId());
+    return NULL;
+  }
+  digested_dictionaries[dictionary] = ddict;
+  return ddict;
+}
+}
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::ZstdDecodeTransformationState: noncopyable {
+  ZSTD_DCtx *dctx_;
+  ZstdDecodeTransformation::Options options_;
+  vector<char> output_buffer_; // reused by every call to the decompressor.
+  int64_t bytes_consumed_;
+  int64_t bytes_produced_;
+  bool finished_; // the last call to the decompressor ended on a frame boundary.
+  bool aborted_;
+
+  ZstdDecodeTransformationState(const ZstdDecodeTransformation::Options &options) :
+        dctx_(ZSTD_createDCtx()), options_(options), output_buffer_(OUTPUT_BUFFER_SIZE), bytes_consumed_(0),
+        bytes_produced_(0), finished_(false), aborted_(false) {
+    if (!dctx_) {
+      LOG_ERROR("ZSTD_createDCtx failed.");
+      return;
+    }
+    if (options.max_window_log_ > 0) {
+      size_t ret = ZSTD_DCtx_setParameter(dctx_, ZSTD_d_windowLogMax, options.max_window_log_);
+      if (ZSTD_isError(ret)) {
+        LOG_ERROR("Unable to set zstd max window log to %d: %s", options.max_window_log_, ZSTD_getErrorName(ret));
+      }
+    }
+    if (options.dictionary_) {
+      ZSTD_DDict *ddict = getDigestedDictionary(options.dictionary_);
+      if (ddict) {
+        ZSTD_DCtx_refDDict(dctx_, ddict);
+      }
+    }
+  };
+
+  ~ZstdDecodeTransformationState() {
+    if (dctx_) {
+      ZSTD_freeDCtx(dctx_);
+    }
+  };
+};
+
+ZstdDecodeTransformation::ZstdDecodeTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                   const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new ZstdDecodeTransformationState(options);
+}
+
+ZstdDecodeTransformation::~ZstdDecodeTransformation() {
+  delete state_;
+}
+
+bool ZstdDecodeTransformation::isAborted() const {
+  return state_->aborted_;
+}
+
+void ZstdDecodeTransformation::consume(const string &data) {
+  if (data.size() == 0 || state_->aborted_) {
+    return;
+  }
+
+  if (!state_->dctx_) {
+    LOG_ERROR("Unable to decompress output because the zstd context was not created, aborting the output.");
+    state_->aborted_ = true;
+    abortOutput();
+    return;
+  }
+
+  ZSTD_inBuffer input = { data.data(), data.length(), 0 };
+  state_->bytes_consumed_ += data.length();
+  bool output_full = false;
+  int iteration = 0;
+
+  // Loop while we have more input or zstd filled our buffer and may have more output.
+  while (input.pos < input.size || output_full) {
+    ZSTD_outBuffer output = { &state_->output_buffer_[0], state_->output_buffer_.size(), 0 };
+    LOG_DEBUG("Iteration %d: Zstd has %lu bytes to decompress", ++iteration,
+              static_cast<unsigned long>(input.size - input.pos));
+
+    size_t ret = ZSTD_decompressStream(state_->dctx_, &output, &input);
+    if (ZSTD_isError(ret)) {
+      LOG_ERROR("Iteration %d: Zstd failed to decompress with error '%s', aborting the output", iteration,
+                ZSTD_getErrorName(ret));
+      state_->aborted_ = true;
+      if (ZSTD_getErrorCode(ret) == ZSTD_error_frameParameter_windowTooLarge && state_->options_.aborted_stat_) {
+        state_->options_.aborted_stat_->increment(); // the window limit is one of our limits, not corrupt input.
+      }
+      abortOutput();
+      return;
+    }
+    state_->finished_ = (ret == 0); // a following frame is allowed, it clears this again.
+
+    int64_t total_decoded_bytes = state_->bytes_produced_ + output.pos;
+    const Options &options = state_->options_;
+    if ((options.max_output_bytes_ > 0 && total_decoded_bytes > options.max_output_bytes_) ||
+        (options.max_expansion_ratio_ > 0 && total_decoded_bytes > EXPANSION_RATIO_MIN_OUTPUT &&
+         total_decoded_bytes > options.max_expansion_ratio_ * state_->bytes_consumed_)) {
+      LOG_ERROR("Aborting zstd decode after %lld compressed bytes decoded to %lld bytes, max output bytes=%lld "
+                "max expansion ratio=%d", static_cast<long long>(state_->bytes_consumed_),
+                static_cast<long long>(total_decoded_bytes), static_cast<long long>(options.max_output_bytes_),
+                options.max_expansion_ratio_);
+      state_->aborted_ = true;
+      if (options.aborted_stat_) {
+        options.aborted_stat_->increment();
+      }
+      abortOutput();
+      return;
+    }
+
+    produce(&state_->output_buffer_[0], output.pos);
+    state_->bytes_produced_ += output.pos;
+    output_full = (output.pos == output.size);
+  }
+}
+
+void ZstdDecodeTransformation::handleInputComplete() {
+  if (state_->aborted_) {
+    // The output was aborted, it must not be completed.
+    return;
+  }
+
+  // An empty body is passed through, anything else must have reached the end of the stream.
+  if (!state_->finished_ && state_->bytes_consumed_ > 0) {
+    LOG_ERROR("Zstd stream was truncated after %lld compressed bytes, aborting the output",
+              static_cast<long long>(state_->bytes_consumed_));
+    state_->aborted_ = true;
+    abortOutput();
+    return;
+  }
+
+  int64_t bytes_written = setOutputComplete();
+  if (state_->bytes_produced_ != bytes_written) {
+    LOG_ERROR("Zstd bytes produced sanity check failed, decoded bytes = %lld != written bytes = %lld",
+              static_cast<long long>(state_->bytes_produced_), static_cast<long long>(bytes_written));
+  }
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ZstdEncodeTransformation.cc
+ */
+
+#include <string>
+#include <map>
+#include <utility>
+#include <vector>
+#include <zstd.h>
+#include "atscppapi/Mutex.h"
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/ZstdEncodeTransformation.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using atscppapi::Mutex;
+using atscppapi::ScopedMutexLock;
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+const size_t OUTPUT_BUFFER_SIZE = 32 * 1024;
+
+typedef map<pair<const CompressionDictionary *, int>, ZSTD_CDict *> DigestedDictionaryMap;
+
+Mutex digested_dictionaries_mutex;
+DigestedDictionaryMap digested_dictionaries; // dictionaries live as long as the plugin so these are never freed.
+
+/**
+ * Digesting a dictionary costs far more than compressing a small body, so each dictionary is
+ * digested once per compression level and referenced by every context after that.
+ */
+ZSTD_CDict *getDigestedDictionary(const CompressionDictionary *dictionary, int level) {
+  ScopedMutexLock lock(digested_dictionaries_mutex);
+  pair<const CompressionDictionary *, int> key(dictionary, level);
+  DigestedDictionaryMap::iterator iter = digested_dictionaries.find(key);
+  if (iter != digested_dictionaries.end()) {
+    return iter->second;
+  }
+
+  const string &data = dictionary->getData();
+  ZSTD_CDict *cdict = ZSTD_createCDict(data.data(), data.length(), level);
+  if (!cdict) {
+    LOG_ERROR("Unable to digest zstd dictionary %u at level %d", dictionary->getId(), level);
+    return NULL;
+  }
+  LOG_DEBUG("Digested zstd dictionary %u at level %d", dictionary->getId(), level);
+  digested_dictionaries[key] = cdict;
+  return cdict;
+}
+}
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::ZstdEncodeTransformationState: noncopyable {
+  ZSTD_CCtx *cctx_;
+  ZstdEncodeTransformation::Options options_;
+  vector<char> output_buffer_; // reused by every call to the compressor.
+  size_t bytes_since_flush_;
+  int64_t bytes_produced_;
+
+  ZstdEncodeTransformationState(const ZstdEncodeTransformation::Options &options) :
+        cctx_(ZSTD_createCCtx()), options_(options), output_buffer_(OUTPUT_BUFFER_SIZE), bytes_since_flush_(0),
+        bytes_produced_(0) {
+    if (!cctx_) {
+      LOG_ERROR("ZSTD_createCCtx failed.");
+      return;
+    }
+    ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, options.level_);
+    ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, options.checksum_ ? 1 : 0);
+    if (options.window_log_) {
+      ZSTD_CCtx_setParameter(cctx_, ZSTD_c_windowLog, options.window_log_);
+    }
+    if (options.dictionary_) {
+      ZSTD_CDict *cdict = getDigestedDictionary(options.dictionary_, options.level_);
+      if (cdict) {
+        ZSTD_CCtx_refCDict(cctx_, cdict);
+      }
+    }
+    LOG_DEBUG("Zstd compressing with level=%d window_log=%d checksum=%d dictionary=%u", options.level_,
+              options.window_log_, options.checksum_, options.dictionary_ ? options.dictionary_->getId() : 0);
+  };
+
+  ~ZstdEncodeTransformationState() {
+    if (cctx_) {
+      ZSTD_freeCCtx(cctx_);
+    }
+  };
+};
+
+ZstdEncodeTransformation::ZstdEncodeTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                   const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new ZstdEncodeTransformationState(options);
+}
+
+ZstdEncodeTransformation::~ZstdEncodeTransformation() {
+  delete state_;
+}
+
+void ZstdEncodeTransformation::encode(const char *data, size_t length, int operation) {
+  ZSTD_inBuffer input = { data, length, 0 };
+  ZSTD_EndDirective directive = static_cast<ZSTD_EndDirective>(operation);
+  bool finished = false;
+  int iteration = 0;
+
+  do {
+    ZSTD_outBuffer output = { &state_->output_buffer_[0], state_->output_buffer_.size(), 0 };
+    LOG_DEBUG("Iteration %d: Zstd will compress %lu bytes, directive=%d", ++iteration,
+              static_cast<unsigned long>(input.size - input.pos), operation);
+
+    size_t remaining = ZSTD_compressStream2(state_->cctx_, &output, &input, directive);
+    if (ZSTD_isError(remaining)) {
+      LOG_ERROR("Iteration %d: Zstd failed to compress %lu bytes with error '%s'", iteration,
+                static_cast<unsigned long>(length),
+                ZSTD_getErrorName(remaining));
+      return;
+    }
+
+    state_->bytes_produced_ += output.pos;
+    produce(&state_->output_buffer_[0], output.pos);
+
+    // When continuing we're done once all of the input was taken, when flushing or ending the
+    // frame zstd tells us how much it still has to write.
+    finished = (directive == ZSTD_e_continue) ? (input.pos == input.size) : (remaining == 0);
+  } while (!finished);
+}
+
+void ZstdEncodeTransformation::consume(const string &data) {
+  if (data.size() == 0) {
+    return;
+  }
+
+  if (!state_->cctx_) {
+    LOG_ERROR("Unable to compress output because the zstd context was not created.");
+    return;
+  }
+
+  ZSTD_EndDirective directive = ZSTD_e_continue;
+  state_->bytes_since_flush_ += data.length();
+  if (state_->options_.latency_sensitive_ || state_->bytes_since_flush_ >= state_->options_.flush_bytes_) {
+    directive = ZSTD_e_flush;
+    state_->bytes_since_flush_ = 0;
+  }
+  encode(data.data(), data.length(), directive);
+}
+
+void ZstdEncodeTransformation::handleInputComplete() {
+  if (state_->cctx_) {
+    encode(NULL, 0, ZSTD_e_end);
+  }
+
+  int64_t bytes_written = setOutputComplete();
+  if (state_->bytes_produced_ != bytes_written) {
+    LOG_ERROR("Zstd bytes produced sanity check failed, compressed bytes = %lld != written bytes = %lld",
+              static_cast<long long>(state_->bytes_produced_), static_cast<long long>(bytes_written));
+  }
+}
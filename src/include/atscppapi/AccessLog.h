@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file AccessLog.h
+ * @brief Access log lines built from a format that is compiled once.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ACCESSLOG_H_
+#define ATSCPPAPI_ACCESSLOG_H_
+
+#include <string>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+class AccessLogState;
+class Logger;
+class Transaction;
+
+/**
+ * @brief Writes one line per Transaction to a Logger from a format of Traffic Server style log fields.
+ *
+ * The format is compiled into a list of instructions by init(), so log() only runs the list: header
+ * values, urls and methods are copied straight out of the Transaction's marshal buffers into a buffer
+ * owned by the calling thread, without building the strings the Headers, Url and Request getters return.
+ *
+ * \code
+ * Logger logger;
+ * logger.init("access");
+ * AccessLog access_log;
+ * access_log.init("%{chi} \"%{cqhm} %{cqu}\" %{pssc} %{crc} %{cqh:Host} %{cqh:User-Agent}", logger);
+ * ...
+ * // Usually from HOOK_SEND_RESPONSE_HEADERS, when the response to the client is known.
+ * access_log.log(transaction);
+ * \endcode
+ *
+ * The supported fields are:
+ *  - %{cqh:Name} %{pqh:Name} %{ssh:Name} %{psh:Name}: the value of a header in the client request, the
+ *    request to the origin (proxy request), the origin's response (server response) or the response to the
+ *    client (proxy response). Repeated headers are joined with ", ".
+ *  - %{cqhm} %{pqhm}: the method of the client request or the proxy request.
+ *  - %{cqu} %{pqu}: the url of the client request or the proxy request.
+ *  - %{cqup} %{pqup}: the path of the client request or the proxy request.
+ *  - %{sssc} %{pssc}: the status code of the server response or the proxy response.
+ *  - %{chi}: the client's IP address.
+ *  - %{crc}: the result of the cache lookup, MISS, HIT_STALE, HIT_FRESH, SKIPPED or NONE.
+ *  - %%: a percent sign.
+ *
+ * A field that isn't available, such as the server response of a cache hit, is written as "-".
+ */
+class AccessLog : noncopyable {
+public:
+  AccessLog();
+  ~AccessLog();
+
+  /**
+   * Compiles the format, this should be done once, usually in TSPluginInit().
+   *
+   * @param format the format of each line.
+   * @param logger the initialized Logger that lines are written to without a level prefix, see Logger::logRaw(),
+   *   it must outlive the AccessLog.
+   * @return false if the format has an unknown or malformed field.
+   */
+  bool init(const std::string &format, Logger &logger);
+
+  /**
+   * Writes the line for a Transaction, this can be called concurrently from any number of threads.
+   */
+  void log(Transaction &transaction);
+private:
+  AccessLogState *state_; /**< Internal state for the AccessLog */
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_ACCESSLOG_H_ */
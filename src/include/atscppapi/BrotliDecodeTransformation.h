@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BrotliDecodeTransformation.h
+ * @brief Brotli Decode Transformation can be used to decompress brotli content.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_BROTLIDECODETRANSFORMATION_H_
+#define ATSCPPAPI_BROTLIDECODETRANSFORMATION_H_
+
+#include <string>
+#include <stdint.h>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/Stat.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for Brotli Decode Transformations
+ * @private
+ */
+class BrotliDecodeTransformationState;
+
+/**
+ * @brief A TransformationPlugin to easily add brotli decompression to your TransformationPlugin chain.
+ *
+ * The BrotliDecodeTransformation works exactly like the GzipInflateTransformation, including its
+ * limits on the decompressed size. It is only available when libatscppapi was built with brotli.
+ *
+ * @note BrotliDecodeTransformation DOES NOT set or check Content-Encoding headers.
+ *
+ * @see BrotliEncodeTransformation
+ * @see GzipInflateTransformation
+ */
+class BrotliDecodeTransformation : public TransformationPlugin {
+public:
+  /**
+   * @brief The limits of a BrotliDecodeTransformation, by default there are no limits.
+   */
+  struct Options {
+    int64_t max_output_bytes_; /**< The maximum number of decompressed bytes, 0 means no limit. */
+    int max_expansion_ratio_; /**< The maximum ratio of decompressed bytes to compressed bytes, 0 means no limit.
+                                   It is only enforced once 1MB has been decompressed. */
+    Stat *aborted_stat_; /**< An optional Stat incremented each time a transformation is aborted by a limit. */
+    Options() : max_output_bytes_(0), max_expansion_ratio_(0), aborted_stat_(NULL) { };
+  };
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of the transformation.
+   * @param options the limits to apply to the decompressed content.
+   */
+  BrotliDecodeTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                             const Options &options = Options());
+
+  /**
+   * Decompresses data.
+   *
+   * @param data the input data to decompress
+   */
+  void consume(const std::string &data);
+
+  /**
+   * Completes the output, or aborts it if the brotli stream was truncated.
+   */
+  void handleInputComplete();
+
+  /**
+   * @return True if decompression was stopped because the content exceeded a limit in Options, could not
+   *  be decompressed, was truncated or was followed by trailing data.
+   */
+  bool isAborted() const;
+
+  virtual ~BrotliDecodeTransformation();
+private:
+  BrotliDecodeTransformationState *state_; /** Internal state for Brotli Decode Transformations */
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_BROTLIDECODETRANSFORMATION_H_ */
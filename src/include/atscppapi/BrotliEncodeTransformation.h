@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BrotliEncodeTransformation.h
+ * @brief Brotli Encode Transformation can be used to compress content with brotli.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_BROTLIENCODETRANSFORMATION_H_
+#define ATSCPPAPI_BROTLIENCODETRANSFORMATION_H_
+
+#include <string>
+#include "atscppapi/TransformationPlugin.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for Brotli Encode Transformations
+ * @private
+ */
+class BrotliEncodeTransformationState;
+
+/**
+ * @brief A TransformationPlugin to easily add brotli compression to your TransformationPlugin chain.
+ *
+ * The BrotliEncodeTransformation works exactly like the GzipDeflateTransformation, it is only
+ * available when libatscppapi was built with brotli, which configure detects automatically.
+ *
+ * @note BrotliEncodeTransformation DOES NOT set Content-Encoding headers, it is the
+ * users responsibility to set any applicable headers and to check that the client accepts br.
+ *
+ * @see BrotliDecodeTransformation
+ * @see GzipDeflateTransformation
+ */
+class BrotliEncodeTransformation : public TransformationPlugin {
+public:
+  /**
+   * @brief The compression parameters of a BrotliEncodeTransformation.
+   *
+   * As with GzipDeflateTransformation the output is only flushed once flush_bytes_ of input
+   * have been compressed unless latency_sensitive_ is set.
+   */
+  struct Options {
+    int quality_; /**< The compression quality from 0 (fastest) to 11 (best), the default is 5. */
+    int window_bits_; /**< The base two logarithm of the window size from 10 to 24, the default is 22. */
+    bool text_; /**< Tune the compressor for UTF-8 text, the default is false. */
+    size_t flush_bytes_; /**< The input bytes compressed before the output is flushed, the default is 64KB. */
+    bool latency_sensitive_; /**< Flush the output on every consume(), the default is false. */
+    Options() : quality_(5), window_bits_(22), text_(false), flush_bytes_(64 * 1024), latency_sensitive_(false) { };
+  };
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of the transformation.
+   * @param options the compression parameters to use.
+   */
+  BrotliEncodeTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                             const Options &options = Options());
+
+  /**
+   * Compresses data with brotli.
+   *
+   * @param data the input data to compress
+   */
+  void consume(const std::string &data);
+
+  /**
+   * Finishes the brotli stream and completes the output.
+   */
+  void handleInputComplete();
+
+  virtual ~BrotliEncodeTransformation();
+private:
+  void encode(const char *data, size_t length, int operation);
+  BrotliEncodeTransformationState *state_; /** Internal state for Brotli Encode Transformations */
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_BROTLIENCODETRANSFORMATION_H_ */
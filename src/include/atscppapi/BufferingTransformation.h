@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BufferingTransformation.h
+ * @brief A TransformationPlugin that buffers the whole body with bounded memory use.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_BUFFERINGTRANSFORMATION_H_
+#define ATSCPPAPI_BUFFERINGTRANSFORMATION_H_
+
+#include <string>
+#include <stdint.h>
+#include <atscppapi/TransformationPlugin.h>
+
+namespace atscppapi {
+
+class BufferingTransformationState;
+
+/**
+ * @brief A base class for transformations that need the complete body before acting on it.
+ *
+ * A BufferingTransformation keeps the body in memory until it grows past a configurable
+ * limit, at which point the body is moved to an unlinked temporary file and the rest of the body is
+ * appended to that file. Once the input is complete handleBufferedInput() is called with a view of the whole
+ * body, when the body was spilled to disk that view is a read-only mmap of the temporary file. If part of the
+ * body can't be written to the temporary file, or the file can't be created or mapped, the transformation is
+ * aborted with TransformationPlugin::abortOutput() and handleBufferedInput() is never called, a partial body is
+ * never passed on.
+ *
+ * \code
+ * class PostBufferTransformation : public BufferingTransformation {
+ * public:
+ *   PostBufferTransformation(Transaction &transaction)
+ *     : BufferingTransformation(transaction, REQUEST_TRANSFORMATION, 64 * 1024) { }
+ *
+ *   void handleBufferedInput(const char *data, size_t length) {
+ *     if (isValid(data, length)) {
+ *       produceBufferedInput(); // passes the body on unchanged and completes the output.
+ *     } else {
+ *       abortOutput();
+ *     }
+ *   }
+ * };
+ * \endcode
+ *
+ * The number of bytes buffered in memory and on disk by all BufferingTransformations can be exported
+ * as Stats with initStats(). A full example is available in examples/post_buffer/.
+ *
+ * @see TransformationPlugin
+ */
+class BufferingTransformation : public TransformationPlugin {
+public:
+  /**
+   * This method will be called once the whole body has been buffered, you must call setOutputComplete()
+   * when you're done producing output, or produceBufferedInput() to pass the body on unchanged. A large body
+   * should not be passed to a single produce() call, that copies all of it into memory at once.
+   *
+   * @param data the buffered body, it is only valid for the duration of this call.
+   * @param length the length of the buffered body.
+   */
+  virtual void handleBufferedInput(const char *data, size_t length) = 0;
+
+  /**
+   * BufferingTransformation implements consume() to buffer the body.
+   */
+  void consume(const std::string &data);
+
+  /**
+   * BufferingTransformation implements handleInputComplete() to dispatch handleBufferedInput().
+   */
+  void handleInputComplete();
+
+  /**
+   * BufferingTransformation implements handleOutputDrained() to continue produceBufferedInput().
+   */
+  void handleOutputDrained();
+
+  /**
+   * @return The number of bytes of body buffered so far.
+   */
+  int64_t getBufferedBytes() const;
+
+  /**
+   * @return True if the body grew past the memory limit and was moved to a temporary file.
+   */
+  bool isSpilledToDisk() const;
+
+  /**
+   * Creates the Stats name_prefix.memory_bytes and name_prefix.disk_bytes which track the number of bytes
+   * currently buffered in memory and on disk by all BufferingTransformations.
+   *
+   * @param name_prefix the prefix for the stat names.
+   * @return True if both stats were created.
+   */
+  static bool initStats(const std::string &name_prefix);
+
+  virtual ~BufferingTransformation();
+protected:
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of the transformation.
+   * @param max_memory_bytes the number of bytes that will be buffered in memory before the body is
+   *  moved to a temporary file. The default value is 1MB.
+   * @param spill_directory the directory in which temporary files are created, the default is /tmp.
+   */
+  BufferingTransformation(Transaction &transaction, TransformationPlugin::Type type,
+      size_t max_memory_bytes = 1024 * 1024, const std::string &spill_directory = "/tmp");
+
+  /**
+   * Passes the buffered body on unchanged and then completes the output, call this from handleBufferedInput().
+   * The body is written in small pieces as the downstream reads it, using the output watermarks of the
+   * TransformationPlugin, so a body that was spilled to disk is never copied into memory all at once.
+   */
+  void produceBufferedInput();
+private:
+  void forwardBufferedInput();
+  BufferingTransformationState *state_; /** Internal state for a BufferingTransformation */
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_BUFFERINGTRANSFORMATION_H_ */
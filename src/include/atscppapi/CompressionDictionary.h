@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file CompressionDictionary.h
+ * @brief A preset dictionary shared by the compression transformations.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_COMPRESSIONDICTIONARY_H_
+#define ATSCPPAPI_COMPRESSIONDICTIONARY_H_
+
+#include <stdint.h>
+#include <string>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * @brief A preset dictionary primes a compressor with content that is likely to appear in the
+ * data being compressed, which makes a large difference for small bodies such as JSON API responses.
+ *
+ * A dictionary is loaded once, usually in TSPluginInit(), and passed by pointer in the Options of
+ * GzipDeflateTransformation, GzipInflateTransformation, ZstdEncodeTransformation and
+ * ZstdDecodeTransformation, so it must outlive every transformation using it. A dictionary can be
+ * built from sample bodies with tools/dictionary_trainer/.
+ *
+ * Raw content dictionaries work with both deflate and zstd, a dictionary in the zstd dictionary
+ * format can only be used with zstd.
+ *
+ * @note Only clients that have the same dictionary can decode the output, it is the users
+ * responsibility to only use a dictionary with clients that are known to have it.
+ */
+class CompressionDictionary : noncopyable {
+public:
+  /**
+   * @param data the dictionary content.
+   */
+  CompressionDictionary(const std::string &data);
+
+  /**
+   * Loads a dictionary from a file.
+   *
+   * @param path the file to read.
+   * @return the dictionary or NULL if the file could not be read or is empty, the caller owns the dictionary.
+   */
+  static CompressionDictionary *load(const std::string &path);
+
+  /**
+   * @return the dictionary content.
+   */
+  const std::string &getData() const;
+
+  /**
+   * @return the Adler-32 checksum of the dictionary, this is the dictionary id deflate writes in the zlib header.
+   */
+  uint32_t getId() const;
+
+  ~CompressionDictionary();
+private:
+  std::string data_;
+  uint32_t id_;
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_COMPRESSIONDICTIONARY_H_ */
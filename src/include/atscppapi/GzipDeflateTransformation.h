@@ -23,6 +23,7 @@
 
 #include <string>
 #include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/CompressionDictionary.h"
 
 namespace atscppapi {
 
@@ -48,6 +49,42 @@ class GzipDeflateTransformationState;
  */
 class GzipDeflateTransformation : public TransformationPlugin {
 public:
+  /**
+   * @brief The compression parameters of a GzipDeflateTransformation, the defaults are the zlib defaults.
+   *
+   * When adaptive_ is set the compression level is chosen when the transformation is created based on
+   * how late the Traffic Server event loop is running: up to adaptive_low_lag_ms_ of lag level_ is used,
+   * from adaptive_high_lag_ms_ of lag adaptive_min_level_ is used and in between the level is scaled linearly.
+   * This lets a busy server trade compression ratio for CPU, see getEventLoopLagMs().
+   *
+   * Input is compressed without flushing the deflate stream until flush_bytes_ of input have been
+   * compressed or flush_interval_ms_ have passed since the last flush, this avoids emitting short fragments
+   * and empty blocks for small chunks. A timer flushes held back output when no more input arrives within
+   * flush_interval_ms_, so a stalled origin can't hold compressed bytes back for longer than that. Streaming responses such as
+   * server-sent events should set latency_sensitive_ so every chunk is flushed as soon as it arrives.
+   *
+   * When dictionary_ is set the deflate stream is primed with the dictionary and, because the gzip format
+   * cannot signal a preset dictionary, the zlib format is written instead: the output must be labelled
+   * Content-Encoding: deflate and can only be decoded by clients that have the dictionary.
+   */
+  struct Options {
+    int level_; /**< The compression level from 0 (none) to 9 (best), -1 is the zlib default (6). */
+    int strategy_; /**< The zlib strategy: 0 default, 1 filtered, 2 huffman only, 3 rle or 4 fixed. */
+    int mem_level_; /**< How much memory zlib uses for its compression state from 1 to 9, the default is 8. */
+    int window_bits_; /**< The base two logarithm of the window size from 9 to 15, the default is 15. */
+    bool adaptive_; /**< Lower the level as the event loop lag grows, the default is false. */
+    int adaptive_min_level_; /**< The level used when the lag is at least adaptive_high_lag_ms_, the default is 1. */
+    int adaptive_low_lag_ms_; /**< The lag at which the level starts to be lowered, the default is 5ms. */
+    int adaptive_high_lag_ms_; /**< The lag at which adaptive_min_level_ is used, the default is 50ms. */
+    size_t flush_bytes_; /**< The input bytes compressed before the output is flushed, the default is 64KB. */
+    int flush_interval_ms_; /**< The time after which the output is flushed, 0 disables it, the default is 100ms. */
+    bool latency_sensitive_; /**< Flush the output on every consume(), the default is false. */
+    const CompressionDictionary *dictionary_; /**< An optional preset dictionary, the default is NULL. */
+    Options() : level_(-1), strategy_(0), mem_level_(8), window_bits_(15), adaptive_(false), adaptive_min_level_(1),
+                adaptive_low_lag_ms_(5), adaptive_high_lag_ms_(50), flush_bytes_(64 * 1024), flush_interval_ms_(100),
+                latency_sensitive_(false), dictionary_(NULL) { };
+  };
+
   /**
    * A full example of how to use GzipDeflateTransformation and GzipInflateTransformation is available
    * in examples/gzip_tranformation/
@@ -60,6 +97,16 @@ public:
    */
   GzipDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type);
 
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of the transformation.
+   * @param options the compression parameters to use, for example a lower level for content types
+   *  that compress poorly.
+   *
+   * @see Options
+   */
+  GzipDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type, const Options &options);
+
   /**
    * Any TransformationPlugin must implement consume(), this method will take content
    * from the transformation chain and gzip compress it.
@@ -74,8 +121,25 @@ public:
    */
   void handleInputComplete();
 
+  /**
+   * Flushes compressed output that was held back for flush_interval_ms_ without new input.
+   */
+  void handleWakeup();
+
+  /**
+   * @return The compression level used by this transformation, when adaptive this is the level that was chosen.
+   */
+  int getCompressionLevel() const;
+
+  /**
+   * @return The smoothed number of milliseconds by which the event loop is running late, or -1 if no adaptive
+   *  GzipDeflateTransformation has been created yet since the lag is only measured once one has.
+   */
+  static int getEventLoopLagMs();
+
   virtual ~GzipDeflateTransformation();
 private:
+  void deflateAndProduce(const char *data, size_t length, bool sync_flush);
   GzipDeflateTransformationState *state_; /** Internal state for Gzip Deflate Transformations */
 };
 
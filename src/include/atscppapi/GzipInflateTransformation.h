@@ -22,7 +22,10 @@
 #define ATSCPPAPI_GZIPINFLATETRANSFORMATION_H_
 
 #include <string>
+#include <stdint.h>
 #include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/Stat.h"
+#include "atscppapi/CompressionDictionary.h"
 
 namespace atscppapi {
 
@@ -46,10 +49,32 @@ class GzipInflateTransformationState;
  * gzipped by checking the Content-Encoding header before creating a GzipInflateTransformation,
  * see examples/gzip_transformation/ for a full example.
  *
+ * Content is inflated through a fixed size buffer so memory use does not depend on the size of the
+ * input chunks. To protect against compression bombs the inflated size can be limited, either absolutely
+ * or as a ratio of the compressed size, see Options. When a limit is reached, or the input is corrupt, the
+ * transformation stops producing output and aborts it with TransformationPlugin::abortOutput(), so the truncated
+ * body is never completed or cached as if it were the whole object.
+ *
  * @see GzipDeflateTransformation
  */
 class GzipInflateTransformation : public TransformationPlugin {
 public:
+  /**
+   * @brief The limits of a GzipInflateTransformation, by default there are no limits.
+   *
+   * When dictionary_ is set both the zlib and gzip formats are accepted and the dictionary is used
+   * for zlib streams that were compressed with a preset dictionary, see GzipDeflateTransformation::Options.
+   */
+  struct Options {
+    int64_t max_output_bytes_; /**< The maximum number of inflated bytes, 0 means no limit. */
+    int max_expansion_ratio_; /**< The maximum ratio of inflated bytes to compressed bytes, 0 means no limit.
+                                   It is only enforced once 1MB has been inflated so small bodies that compress
+                                   very well are not rejected. */
+    Stat *aborted_stat_; /**< An optional Stat incremented each time a transformation is aborted by a limit. */
+    const CompressionDictionary *dictionary_; /**< An optional preset dictionary, the default is NULL. */
+    Options() : max_output_bytes_(0), max_expansion_ratio_(0), aborted_stat_(NULL), dictionary_(NULL) { };
+  };
+
   /**
    * A full example of how to use GzipInflateTransformation and GzipDeflateTransformation is available
    * in examples/gzip_tranformation/
@@ -62,6 +87,15 @@ public:
    */
   GzipInflateTransformation(Transaction &transaction, TransformationPlugin::Type type);
 
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of the transformation.
+   * @param options the limits to apply to the inflated content.
+   *
+   * @see Options
+   */
+  GzipInflateTransformation(Transaction &transaction, TransformationPlugin::Type type, const Options &options);
+
   /**
    * Any TransformationPlugin must implement consume(), this method will take content
    * from the transformation chain and gzip decompress it.
@@ -72,10 +106,16 @@ public:
 
   /**
    * Any TransformationPlugin must implement handleInputComplete(), this method will
-   * finalize the gzip decompression.
+   * finalize the gzip decompression, or abort the output if the gzip stream was truncated.
    */
   void handleInputComplete();
 
+  /**
+   * @return True if inflating was stopped because the content exceeded a limit in Options, could not be inflated
+   *  or was truncated.
+   */
+  bool isAborted() const;
+
   virtual ~GzipInflateTransformation();
 private:
   GzipInflateTransformationState *state_; /** Internal state for Gzip Deflate Transformations */
@@ -222,6 +222,46 @@ public:
   /** Deletes a cookie */
   bool deleteCookie(const std::string &name);
 
+  /**
+   * @brief A content coding from an "Accept-Encoding" header and its quality value.
+   */
+  struct AcceptEncoding {
+    std::string coding_; /**< The content coding in lower case, x-gzip is reported as gzip. */
+    float q_; /**< The quality value from 0 (not acceptable) to 1 (the default). */
+    AcceptEncoding() : q_(1.0f) { };
+  };
+
+  typedef std::list<AcceptEncoding> AcceptEncodingList;
+
+  /**
+   * The "Accept-Encoding" headers of a request object are parsed once and the result is cached
+   * until the header is changed through this object.
+   *
+   * @return The content codings in the "Accept-Encoding" headers ordered by quality value, codings
+   *  with the same quality value keep the order in which the client listed them.
+   */
+  const AcceptEncodingList &getAcceptEncoding() const;
+
+  /**
+   * Picks the content coding to use for a response to this request following the rules of RFC 7231,
+   * the wildcard "*" and the implicit acceptability of identity are both taken into account.
+   *
+   * \code
+   * std::list<std::string> supported;
+   * supported.push_back("br");
+   * supported.push_back("gzip");
+   * if (transaction.getClientRequest().getHeaders().negotiateAcceptEncoding(supported) == "gzip") {
+   *   ...
+   * }
+   * \endcode
+   *
+   * @param supported the content codings the caller can produce in order of preference, the coding with the
+   *  highest quality value is chosen and ties are broken by this order.
+   * @return The chosen coding, "identity" if none of the supported codings are acceptable but identity is,
+   *  or an empty string if nothing is acceptable.
+   */
+  std::string negotiateAcceptEncoding(const std::list<std::string> &supported) const;
+
   ~Headers();
 private:
   HeadersState *state_;
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Histogram.h
+ * @brief A distribution of values, such as latencies, exported as percentile stats.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_HISTOGRAM_H_
+#define ATSCPPAPI_HISTOGRAM_H_
+
+#include <string>
+#include <stdint.h>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+class HistogramState;
+
+/**
+ * @brief Records values into log-linear buckets and exports their percentiles as stats.
+ *
+ * Values are counted in buckets in the style of HdrHistogram: values below 64 get a bucket each and
+ * every power of two above that is split into 32 buckets, so a percentile is reported to within about 3%
+ * of the recorded value. Each thread records into its own buckets without locks or atomic operations,
+ * and an AsyncTimer merges them periodically.
+ *
+ * On each export the following stats are set from the values recorded since the previous export, and
+ * all of them are 0 if nothing was recorded:
+ *  - name.p50, name.p90, name.p99 and name.p999: the 50th, 90th, 99th and 99.9th percentiles.
+ *  - name.max: the largest value.
+ *  - name.count: how many values were recorded.
+ *
+ * \code
+ * Histogram fetch_latency_us;
+ * fetch_latency_us.init("my_plugin.fetch_latency_us");
+ * ...
+ * fetch_latency_us.record(elapsed_us);
+ * // traffic_line -r my_plugin.fetch_latency_us.p99
+ * \endcode
+ */
+class Histogram : noncopyable {
+public:
+  Histogram();
+  ~Histogram();
+
+  /**
+   * You must initialize your Histogram with a call to this init() method.
+   *
+   * @param name The prefix of the percentile stats, they will be visible via traffic_line -r.
+   * @param export_interval_ms How often the percentiles are exported, the default is 10 seconds.
+   * @return True if the stats were created and false otherwise.
+   */
+  bool init(const std::string &name, int export_interval_ms = 10000);
+
+  /**
+   * Records a value, negative values are recorded as 0.
+   */
+  void record(int64_t value);
+
+  /**
+   * @param percentile a percentile between 0 and 100, such as 99.9.
+   * @return the value at the percentile of everything recorded since init(), or 0 if nothing was recorded.
+   */
+  int64_t getPercentile(double percentile) const;
+private:
+  HistogramState *state_; /**< Internal state for the Histogram */
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_HISTOGRAM_H_ */
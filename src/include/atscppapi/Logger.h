@@ -27,6 +27,8 @@
 #define ATSCPPAPI_LOGGER_H_
 
 #include <string>
+#include <cstddef>
+#include <stdint.h>
 #include <atscppapi/noncopyable.h>
 
 #if !defined(ATSCPPAPI_PRINTFLIKE)
@@ -76,6 +78,66 @@
     (log).logError("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
   } while (false)
 
+/**
+ * @private
+ */
+#define ATSCPPAPI_LOG_LIMITED(log, method, check, fmt, ...) \
+  do { \
+    static atscppapi::LogCallSite atscppapi_log_call_site = ATSCPPAPI_LOG_CALL_SITE_INITIALIZER; \
+    if (atscppapi_log_call_site.check) { \
+      uint64_t atscppapi_log_suppressed = atscppapi_log_call_site.takeSuppressedCount(); \
+      if (atscppapi_log_suppressed) { \
+        (log).method("[%s:%d, %s()] Suppressed %llu messages from this call site", __FILE__, __LINE__, \
+                     __FUNCTION__, static_cast<unsigned long long>(atscppapi_log_suppressed)); \
+      } \
+      (log).method("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
+    } \
+  } while (false)
+
+/**
+ * Like LOG_DEBUG but only one in every n messages from this call site is logged, the others are dropped
+ * before their arguments are formatted. The number of dropped messages is logged at most every 10 seconds
+ * along with the next message that is kept.
+ * \code
+ *  LOG_DEBUG_EVERY_N(logger, 1000, "Cache lookup for %s", url.c_str());
+ * \endcode
+ */
+#define LOG_DEBUG_EVERY_N(log, n, fmt, ...) ATSCPPAPI_LOG_LIMITED(log, logDebug, sample(n), fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_INFO but only one in every n messages from this call site is logged, see LOG_DEBUG_EVERY_N.
+ */
+#define LOG_INFO_EVERY_N(log, n, fmt, ...) ATSCPPAPI_LOG_LIMITED(log, logInfo, sample(n), fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_ERROR but only one in every n messages from this call site is logged, see LOG_DEBUG_EVERY_N.
+ */
+#define LOG_ERROR_EVERY_N(log, n, fmt, ...) ATSCPPAPI_LOG_LIMITED(log, logError, sample(n), fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_DEBUG but at most per_second messages a second are logged from this call site, the others are
+ * dropped before their arguments are formatted. The limit is a bucket of per_second tokens which is refilled
+ * once a second, so a burst of up to per_second messages is logged in full. The number of dropped messages
+ * is logged at most every 10 seconds along with the next message that is kept.
+ * \code
+ *  LOG_ERROR_RATE_LIMITED(logger, 10, "Origin %s failed: %d", host.c_str(), status);
+ * \endcode
+ */
+#define LOG_DEBUG_RATE_LIMITED(log, per_second, fmt, ...) \
+  ATSCPPAPI_LOG_LIMITED(log, logDebug, admit(per_second), fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_INFO but at most per_second messages a second are logged from this call site, see LOG_DEBUG_RATE_LIMITED.
+ */
+#define LOG_INFO_RATE_LIMITED(log, per_second, fmt, ...) \
+  ATSCPPAPI_LOG_LIMITED(log, logInfo, admit(per_second), fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_ERROR but at most per_second messages a second are logged from this call site, see LOG_DEBUG_RATE_LIMITED.
+ */
+#define LOG_ERROR_RATE_LIMITED(log, per_second, fmt, ...) \
+  ATSCPPAPI_LOG_LIMITED(log, logError, admit(per_second), fmt, ## __VA_ARGS__)
+
 /**
  * We forward declare this because if we didn't we end up writing our
  * own version to do the vsnprintf just to call TSDebug and have it do
@@ -146,6 +208,10 @@ class LoggerState;
  * LOG_INFO(log, "Hello World with more info from: %s", argv[0]);
  * \endcode
  *
+ * By default each message is written to the log object on the calling thread, which takes the log object's
+ * lock. With enableAsync() messages are instead copied into a ring buffer owned by the calling thread and a
+ * background thread writes them to the log, see AsyncOptions.
+ *
  * @warning Log rolling doesn't work correctly in 3.2.x see:
  *   https://issues.apache.org/jira/browse/TS-1813
  *   Apply the patch in TS-1813 to correct log rolling in 3.2.x
@@ -164,6 +230,32 @@ public:
     LOG_LEVEL_ERROR = 4 /**< This log level is used for ERROR level logging (ERROR ONLY) */
   };
 
+  /**
+   * What an asynchronous Logger does with a message when the calling thread's ring buffer is full.
+   */
+  enum OverflowPolicy {
+    OVERFLOW_BLOCK = 0, /**< Wait for the background thread to make space, this stalls the calling thread */
+    OVERFLOW_DROP, /**< Drop the message */
+    OVERFLOW_SAMPLE /**< Wait for space for one in every sample_rate_ messages and drop the others */
+  };
+
+  /**
+   * @brief The parameters of an asynchronous Logger, see enableAsync().
+   *
+   * Each thread that logs gets its own ring buffer of ring_bytes_ so writers never contend with each
+   * other or with the background thread. Messages that are dropped are counted, see getDroppedMessageCount(),
+   * and the background thread writes a line to the log reporting how many were dropped. A message larger
+   * than half of ring_bytes_ is dropped whatever the overflow policy.
+   */
+  struct AsyncOptions {
+    size_t ring_bytes_; /**< The size of each thread's ring buffer, rounded up to a power of two, the default is 256KB. */
+    OverflowPolicy overflow_policy_; /**< What to do when a ring buffer is full, the default is OVERFLOW_DROP. */
+    int sample_rate_; /**< One in sample_rate_ messages is kept while a ring is full with OVERFLOW_SAMPLE, the default is 100. */
+    int drain_interval_ms_; /**< How long the background thread sleeps when there's nothing to write, the default is 10ms. */
+    AsyncOptions() : ring_bytes_(256 * 1024), overflow_policy_(OVERFLOW_DROP), sample_rate_(100),
+                     drain_interval_ms_(10) { };
+  };
+
   Logger();
   ~Logger();
 
@@ -184,6 +276,23 @@ public:
   bool init(const std::string &file, bool add_timestamp = true, bool rename_file = true,
       LogLevel level = LOG_LEVEL_INFO, bool rolling_enabled = true, int rolling_interval_seconds = 3600);
 
+  /**
+   * Switches the Logger to asynchronous writes, this must be called after init() and can't be undone.
+   *
+   * Messages are formatted on the calling thread and written by a background thread, so the timestamp
+   * added by the log object can be up to drain_interval_ms_ later than the call that logged the message.
+   *
+   * @param options the ring buffer size, overflow policy and drain interval.
+   * @return true if the background thread was started.
+   * @see AsyncOptions
+   */
+  bool enableAsync(const AsyncOptions &options = AsyncOptions());
+
+  /**
+   * @return The number of messages an asynchronous Logger has dropped because a ring buffer was full.
+   */
+  uint64_t getDroppedMessageCount() const;
+
   /**
    * Allows you to change the rolling interval in seconds
    * @param seconds the number of seconds between rolls
@@ -221,7 +330,8 @@ public:
   Logger::LogLevel getLogLevel() const;
 
   /**
-   * This method allows you to flush any log lines that might have been buffered.
+   * This method allows you to flush any log lines that might have been buffered. For an asynchronous
+   * Logger the flush happens on the background thread after it has written the buffered messages.
    * @warning This method can cause serious performance degredation so you should only
    * use it when absolutely necessary.
    */
@@ -230,7 +340,9 @@ public:
   /**
    * This method writes a DEBUG level message to the log file, the LOG_DEBUG
    * macro in Logger.h should be used in favor of these when possible because it
-   * will produce a much more rich debug message.
+   * will produce a much more rich debug message. Messages of any size are formatted, the
+   * formatting buffer grows as needed, but Traffic Server's text log truncates an entry at 16KB
+   * so a longer message is written as several consecutive lines of up to 16KB each.
    *
    * Sample usage:
    * \code
@@ -252,10 +364,65 @@ public:
    * will produce a much more rich error message.
    */
   void logError(const char *fmt, ...) ATSCPPAPI_PRINTFLIKE(2,3);
+
+  /**
+   * This method writes a line that is already formatted, as is and without a level prefix, such as
+   * the lines of an AccessLog. It's written at any log level except LOG_LEVEL_NO_LOG.
+   *
+   * @param data the line, it doesn't have to be null terminated.
+   * @param length the length of the line.
+   */
+  void logRaw(const char *data, size_t length);
 private:
   LoggerState *state_; /**< Internal state for the Logger */
 };
 
+/**
+ * The sampling state of one LOG_*_EVERY_N or LOG_*_RATE_LIMITED call site. It's a POD so the static
+ * instance in each call site is initialized without a guard, and the check that drops a message is a
+ * couple of atomic operations on it.
+ *
+ * @private
+ */
+struct LogCallSite {
+  volatile uint32_t calls_;
+  volatile int32_t tokens_;
+  volatile int64_t refill_time_ms_;
+  volatile int64_t summary_time_ms_;
+  volatile uint64_t suppressed_;
+
+  bool sample(uint32_t n) {
+    if (n <= 1 || __sync_fetch_and_add(&calls_, 1) % n == 0) {
+      return true;
+    }
+    __sync_fetch_and_add(&suppressed_, 1);
+    return false;
+  }
+
+  bool admit(int32_t per_second) {
+    if (tokens_ > 0 && __sync_fetch_and_sub(&tokens_, 1) > 0) {
+      return true;
+    }
+    return refill(per_second);
+  }
+
+  /**
+   * Refills the bucket if a second has passed since the last refill and takes a token from it, otherwise
+   * counts the message as suppressed.
+   */
+  bool refill(int32_t per_second);
+
+  /**
+   * @return the number of messages suppressed since the last summary if it's time for another one, otherwise 0.
+   */
+  uint64_t takeSuppressedCount();
+};
+
+/**
+ * @private
+ */
+#define ATSCPPAPI_LOG_CALL_SITE_INITIALIZER { 0, 0, 0, 0, 0 }
+
 } /* atscppapi */
 
 
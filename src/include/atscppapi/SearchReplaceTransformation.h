@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file SearchReplaceTransformation.h
+ * @brief Search and Replace Transformation can be used to rewrite literal strings in content.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_SEARCHREPLACETRANSFORMATION_H_
+#define ATSCPPAPI_SEARCHREPLACETRANSFORMATION_H_
+
+#include <map>
+#include <string>
+#include "atscppapi/noncopyable.h"
+#include "atscppapi/shared_ptr.h"
+#include "atscppapi/TransformationPlugin.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for SearchReplacePatterns
+ * @private
+ */
+class SearchReplacePatternsState;
+
+/**
+ * Internal state for Search and Replace Transformations
+ * @private
+ */
+class SearchReplaceTransformationState;
+
+/**
+ * @brief A compiled set of literal patterns and their replacements.
+ *
+ * The patterns are compiled into an Aho-Corasick automaton once, usually in TSPluginInit(), and the
+ * compiled SearchReplacePatterns can then be shared by any number of SearchReplaceTransformations
+ * on any thread since it is never modified after construction.
+ */
+class SearchReplacePatterns : noncopyable {
+public:
+  /**
+   * @param replacements a map from each literal pattern to the string that should replace it,
+   *  empty patterns are ignored.
+   */
+  SearchReplacePatterns(const std::map<std::string, std::string> &replacements);
+
+  /**
+   * @return The length of the longest pattern.
+   */
+  size_t getMaxPatternLength() const;
+
+  ~SearchReplacePatterns();
+private:
+  SearchReplacePatternsState *state_;
+  friend class SearchReplaceTransformation;
+};
+
+/**
+ * @brief A TransformationPlugin that replaces every occurrence of a set of literal patterns.
+ *
+ * The SearchReplaceTransformation streams its input through a compiled SearchReplacePatterns
+ * automaton, matches that span consume() calls are found without buffering the body: only the bytes
+ * that could still be the start of a match, at most the length of the longest pattern, are carried
+ * over between calls.
+ *
+ * A replacement is made as soon as a pattern is complete, when several patterns end at the same
+ * position the longest one is replaced. Scanning resumes after the replaced pattern so replacements are
+ * never rescanned.
+ *
+ * \code
+ * std::map<string, string> replacements;
+ * replacements["origin.example.com"] = "cdn.example.com";
+ * shared_ptr<SearchReplacePatterns> patterns(new SearchReplacePatterns(replacements));
+ * ...
+ * transaction.addPlugin(new SearchReplaceTransformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION, patterns));
+ * \endcode
+ *
+ * @note SearchReplaceTransformation works on the bytes it is given, compressed content must first be
+ * inflated, see GzipInflateTransformation. It does not change any headers.
+ */
+class SearchReplaceTransformation : public TransformationPlugin {
+public:
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of the transformation.
+   * @param patterns the compiled patterns and replacements to apply.
+   */
+  SearchReplaceTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                              shared_ptr<SearchReplacePatterns> patterns);
+
+  /**
+   * Scans data for patterns and produces the data with all complete matches replaced.
+   *
+   * @param data the input data to scan
+   */
+  void consume(const std::string &data);
+
+  /**
+   * Flushes the carried over bytes, which can no longer be part of a match, and completes the output.
+   */
+  void handleInputComplete();
+
+  /**
+   * @return The number of replacements made so far.
+   */
+  int64_t getReplacementCount() const;
+
+  virtual ~SearchReplaceTransformation();
+private:
+  SearchReplaceTransformationState *state_; /** Internal state for Search and Replace Transformations */
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_SEARCHREPLACETRANSFORMATION_H_ */
@@ -26,6 +26,8 @@
 
 namespace atscppapi {
 
+class Transaction;
+
 /**
  * @brief A Stat is an atomic variable that can be used to store counters, averages, time averages, or summations.
  *
@@ -71,6 +73,21 @@ public:
    */
   bool init(std::string name, Stat::SyncType type = SYNC_COUNT, bool persistent = false);
 
+  /**
+   * Initializes a SYNC_SUM Stat that is backed by per-thread shards, use this for counters that every
+   * transaction updates, such as request and byte counts.
+   *
+   * increment() and decrement() only add to a counter owned by the calling thread, so threads never contend
+   * on the same cache line. The shards are added into the Traffic Server stat once a second and whenever
+   * get() is called, so traffic_line -r can lag by up to a second. Incrementing a sharded stat by 1 for
+   * each event counts events the way a SYNC_COUNT Stat does.
+   *
+   * @param name The string name of the stat, this will be visbible via traffic_line -r, or through http stats.
+   * @param persistent This determines if your Stats will persist, the default value is false.
+   * @return True if the stat was successfully created and false otherwise.
+   */
+  bool initSharded(std::string name, bool persistent = false);
+
   /**
    * This method allows you to increment a stat by a certain amount.
    * @param amount the amount to increment the stat by the default value is 1.
@@ -84,7 +101,7 @@ public:
   void decrement(int64_t amount = 1);
 
   /**
-   * This method returns the current value of the stat.
+   * This method returns the current value of the stat, for a sharded Stat this first adds up the shards.
    * @return The value of the stat.
    */
   int64_t get() const;
@@ -93,8 +110,21 @@ public:
    * @param value the value to set the stat to.
    */
   void set(int64_t value);
+
+  /**
+   * @return The SyncType this Stat was initialized with.
+   */
+  Stat::SyncType getSyncType() const;
 private:
   int stat_id_; /**< The internal stat ID */
+  Stat::SyncType sync_type_; /**< The SyncType passed to init() */
+  int shard_slot_; /**< The index of this Stat in each thread's shard, -1 if it isn't sharded */
+
+  /**
+   * Moves an initialized SYNC_SUM Stat onto the per-thread shards, only initSharded() calls this.
+   * @return True if the Stat is sharded.
+   */
+  bool shard();
 };
 
 } /* atscppapi */
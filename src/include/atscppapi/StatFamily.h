@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StatFamily.h
+ * @brief A family of Stats distinguished by label values.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_STATFAMILY_H_
+#define ATSCPPAPI_STATFAMILY_H_
+
+#include <string>
+#include <vector>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/Stat.h>
+
+namespace atscppapi {
+
+class StatFamilyState;
+
+/**
+ * @brief A metric with labels, such as responses by origin and status class, with one Stat per combination
+ * of label values and a bound on how many combinations are created.
+ *
+ * The Stat for a combination of label values is created the first time it's used and found again through
+ * a hash table that is read without locks and without building the stat name. Once max_cardinality
+ * combinations exist every new combination is counted in a single overflow Stat, so a label with
+ * unbounded values, such as a host name taken from a request, can't create an unbounded number of stats.
+ *
+ * The Stat of a combination is named after the family and the label values, each separated by a dot.
+ * Dots, underscores, percent signs and bytes that aren't printable ASCII are percent-encoded in a value,
+ * so the name can be decoded back to the values and two combinations never share a name. The overflow
+ * Stat is name.overflow, a value of "overflow" is written as %6Fverflow so it can't collide with it.
+ *
+ * \code
+ * StatFamily responses;
+ * std::vector<std::string> labels;
+ * labels.push_back("origin");
+ * labels.push_back("status_class");
+ * responses.init("my_plugin.responses", labels, 500);
+ * ...
+ * // Increments my_plugin.responses.origin%2Eexample%2Ecom.2xx
+ * responses.get("origin.example.com", "2xx").increment();
+ * \endcode
+ */
+class StatFamily : noncopyable {
+public:
+  StatFamily();
+  ~StatFamily();
+
+  /**
+   * You must initialize your StatFamily with a call to this init() method.
+   *
+   * @param name The prefix of the names of the family's stats.
+   * @param label_names The names of the labels, every get() must pass one value for each of them.
+   * @param max_cardinality The maximum number of combinations of label values that get their own Stat.
+   * @param type The SyncType of every Stat in the family, the default is SYNC_SUM.
+   * @return True if the overflow stat was created and false otherwise.
+   */
+  bool init(const std::string &name, const std::vector<std::string> &label_names, size_t max_cardinality = 100,
+            Stat::SyncType type = Stat::SYNC_SUM);
+
+  /**
+   * @return The Stat of a family with one label.
+   */
+  Stat &get(const std::string &value);
+
+  /**
+   * @return The Stat of a family with two labels.
+   */
+  Stat &get(const std::string &value1, const std::string &value2);
+
+  /**
+   * @return The Stat of a family with three labels.
+   */
+  Stat &get(const std::string &value1, const std::string &value2, const std::string &value3);
+
+  /**
+   * @return The Stat of a family with any number of labels.
+   */
+  Stat &get(const std::vector<std::string> &values);
+
+  /**
+   * @return The number of combinations of label values that have their own Stat.
+   */
+  size_t getCardinality() const;
+private:
+  Stat &resolve(const std::string *const *values, size_t count);
+  StatFamilyState *state_; /**< Internal state for the StatFamily */
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_STATFAMILY_H_ */
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StructuredLogger.h
+ * @brief A logger that writes compact binary records instead of formatted text.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_STRUCTUREDLOGGER_H_
+#define ATSCPPAPI_STRUCTUREDLOGGER_H_
+
+#include <string>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+class StructuredLoggerState;
+
+/**
+ * @brief Write high rate logs as binary records which are turned into text offline.
+ *
+ * Formatting a message is the most expensive part of a Logger call. A StructuredLogger moves that work
+ * out of Traffic Server: each printf style format is registered once and every log() call only records
+ * the format id, a timestamp and the raw arguments. tools/structured_log_decoder/ turns a log file back
+ * into text using the formats, which are written to the file when they are registered.
+ *
+ * Each thread appends records to its own buffer, a buffer is handed to a task thread once it holds
+ * 64KB and every buffer is written when the periodic flush runs, so records from different threads can
+ * be out of order. log() never writes to the file itself. If the disk can't keep up, or a write fails,
+ * whole buffers are dropped so the file only ever holds complete records.
+ *
+ * \code
+ * StructuredLogger log;
+ * log.init("/var/log/trafficserver/requests.bin");
+ * int request_format = log.registerFormat("%s %s -> %d in %.3fms");
+ * ...
+ * log.log(request_format, method.c_str(), url.c_str(), status, elapsed_ms);
+ * \endcode
+ *
+ * Formats support flags, a width, a precision and the hh, h, l, ll and z length modifiers with the
+ * d, i, c, o, u, x, X, e, E, f, F, g, G, a, A, s and p conversions. '*' widths are not supported.
+ */
+class StructuredLogger : noncopyable {
+public:
+  StructuredLogger();
+  ~StructuredLogger();
+
+  /**
+   * @param path the file to append to, it is created if it doesn't exist.
+   * @param flush_interval_ms how often the buffered records of every thread are written, the default is 1000ms.
+   * @return true if the file could be opened.
+   */
+  bool init(const std::string &path, int flush_interval_ms = 1000);
+
+  /**
+   * Registers a printf style format, this should be done once, usually in TSPluginInit().
+   *
+   * @return the format id to pass to log() or -1 if the format isn't supported.
+   */
+  int registerFormat(const std::string &format);
+
+  /**
+   * Records an event, the arguments must match the registered format exactly as they would for printf.
+   */
+  void log(int format_id, ...);
+
+  /**
+   * Writes the records every thread has buffered.
+   */
+  void flush();
+private:
+  StructuredLoggerState *state_; /**< Internal state for the StructuredLogger */
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_STRUCTUREDLOGGER_H_ */
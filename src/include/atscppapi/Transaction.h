@@ -33,6 +33,7 @@ namespace atscppapi {
 // forward declarations
 class TransactionPlugin;
 class TransactionState;
+class Stat;
 namespace utils { class internal; }
 
 /**
@@ -227,6 +228,40 @@ public:
    */
   bool setCacheUrl(const std::string &);
 
+  /**
+   * The possible results of the cache lookup of a Transaction.
+   */
+  enum CacheStatus {
+    CACHE_LOOKUP_NONE = 0, /**< The cache lookup has not completed or the status is unavailable */
+    CACHE_LOOKUP_MISS, /**< The object was not in cache */
+    CACHE_LOOKUP_HIT_STALE, /**< The object was in cache but it was stale */
+    CACHE_LOOKUP_HIT_FRESH, /**< The object was served from cache */
+    CACHE_LOOKUP_SKIPPED /**< The cache lookup was skipped */
+  };
+
+  /**
+   * @return The result of the cache lookup, this is only available once the lookup has completed,
+   *  for example from HOOK_SEND_RESPONSE_HEADERS.
+   * @see CacheStatus
+   */
+  CacheStatus getCacheStatus() const;
+
+  /**
+   * Controls whether the output of the response TransformationPlugins is written to cache, by default it isn't.
+   * Combined with setCacheUrl() this can be used to cache a transformed variant of an object, such as
+   * a compressed one, so that later cache hits are served without running the transformation again.
+   *
+   * @param cached true to write the transformed response to cache.
+   */
+  void setTransformedResponseCached(bool cached);
+
+  /**
+   * Controls whether the response from the origin is written to cache before it is transformed, by default it is.
+   *
+   * @param cached true to write the untransformed response to cache.
+   */
+  void setUntransformedResponseCached(bool cached);
+
   /**
    * The available types of timeouts you can set on a Transaction.
    */
@@ -261,6 +296,22 @@ public:
    */
   void addPlugin(TransactionPlugin *);
 
+  /**
+   * Increments a Stat when this Transaction closes rather than right away. Increments of the same Stat
+   * are added together, so a Stat that is bumped many times per transaction (bytes per body chunk,
+   * cache lookups, retries) only touches the Traffic Server stat once.
+   *
+   * Only SYNC_SUM Stats are buffered; any other SyncType depends on each individual call and is
+   * incremented immediately. When the transaction closes the buffered increments are added with
+   * Stat::increment(), so a Stat initialized with Stat::initSharded() is updated by the periodic shard
+   * flush and any other Stat once per transaction; the Stat is never sharded behind its owner's back.
+   * The Stat must outlive the Transaction.
+   *
+   * @param stat the Stat to increment.
+   * @param amount the amount to increment the stat by, the default value is 1.
+   */
+  void incrementStat(Stat &stat, int64_t amount = 1);
+
 private:
   TransactionState *state_; //!< The internal TransactionState object tied to the current Transaction
   friend class TransactionPlugin; //!< TransactionPlugin is a friend so it can call addPlugin()
@@ -303,6 +354,11 @@ private:
    */
   const std::list<TransactionPlugin *> &getPlugins() const;
 
+  /**
+   * Applies the increments buffered by incrementStat(), called when the transaction closes.
+   */
+  void flushStats();
+
   friend class utils::internal;
 };
 
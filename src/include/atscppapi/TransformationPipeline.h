@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransformationPipeline.h
+ * @brief Run several transformation stages inside a single transformation.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_TRANSFORMATIONPIPELINE_H_
+#define ATSCPPAPI_TRANSFORMATIONPIPELINE_H_
+
+#include <string>
+#include <stdint.h>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/TransformationPlugin.h>
+
+namespace atscppapi {
+
+class TransformationPipelineState;
+
+/**
+ * @brief A TransformationPlugin that runs several stages inside a single transform VConn.
+ *
+ * Every TransformationPlugin creates its own transform VConn, so stacking several of them
+ * costs an IOBuffer copy and a round of continuation events between each pair. A TransformationPipeline
+ * instead feeds the output of each Stage directly into the consume() of the next Stage in memory, only
+ * the output of the last Stage is written to Traffic Server.
+ *
+ * A Stage is written just like a TransformationPlugin:
+ *
+ * \code
+ * class UpperCaseStage : public TransformationPipeline::Stage {
+ * public:
+ *   void consume(const string &data) {
+ *     string upper(data);
+ *     std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+ *     produce(upper);
+ *   }
+ *   void handleInputComplete() {
+ *     setOutputComplete();
+ *   }
+ * };
+ *
+ * TransformationPipeline *pipeline = new TransformationPipeline(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION);
+ * pipeline->addStage(new FilterStage());
+ * pipeline->addStage(new UpperCaseStage());
+ * transaction.addPlugin(pipeline);
+ * \endcode
+ *
+ * The transformations that come with atscppapi, and any other TransformationPlugin, can be stages too: create
+ * them with the type TransformationPlugin::PIPELINE_STAGE and pass them to addStage() instead of adding them
+ * to the transaction, for example to inflate, rewrite and compress a response in one transformation:
+ *
+ * \code
+ * pipeline->addStage(new GzipInflateTransformation(transaction, TransformationPlugin::PIPELINE_STAGE));
+ * pipeline->addStage(new SearchReplaceTransformation(transaction, TransformationPlugin::PIPELINE_STAGE, patterns));
+ * pipeline->addStage(new GzipDeflateTransformation(transaction, TransformationPlugin::PIPELINE_STAGE));
+ * \endcode
+ *
+ * A full example is available in examples/transformation_pipeline/.
+ *
+ * @see TransformationPlugin
+ */
+class TransformationPipeline : public TransformationPlugin {
+public:
+  /**
+   * @brief A single step of a TransformationPipeline.
+   *
+   * Stages receive data through consume() and handleInputComplete() and hand their output
+   * to the next Stage with produce() and setOutputComplete().
+   */
+  class Stage : atscppapi::noncopyable {
+  public:
+    /**
+     * This method will be fired whenever the previous Stage (or the upstream transformation for
+     * the first Stage) has produced output.
+     */
+    virtual void consume(const std::string &data) = 0;
+
+    /**
+     * This method will be fired when the previous Stage (or the upstream transformation for the first Stage)
+     * has completed writing data.
+     */
+    virtual void handleInputComplete() = 0;
+
+    /**
+     * This method will be fired once the delay passed to scheduleWakeup() has passed, the default
+     * implementation does nothing.
+     *
+     * @see TransformationPlugin::handleWakeup()
+     */
+    virtual void handleWakeup();
+
+    /**
+     * This method will be fired when the output of the pipeline has drained to its low watermark, the
+     * default implementation does nothing.
+     *
+     * @see TransformationPlugin::handleOutputDrained()
+     */
+    virtual void handleOutputDrained();
+
+    virtual ~Stage();
+  protected:
+    Stage();
+
+    /**
+     * Hands output to the next Stage, the output of the last Stage is written to
+     * the downstream transformation.
+     */
+    size_t produce(const std::string &data);
+
+    /**
+     * This is the method that you must call when the Stage is done producing output.
+     *
+     * @return The total number of bytes this Stage produced.
+     */
+    size_t setOutputComplete();
+
+    /**
+     * Aborts the output of the whole pipeline, see TransformationPlugin::abortOutput().
+     */
+    void abortOutput();
+
+    /**
+     * Requests a call to handleWakeup() after delay_ms, see TransformationPlugin::scheduleWakeup().
+     *
+     * @param delay_ms the number of milliseconds to wait.
+     */
+    void scheduleWakeup(int delay_ms);
+  private:
+    Stage *next_;
+    TransformationPipeline *pipeline_;
+    int64_t bytes_produced_;
+    bool wakeup_requested_;
+    friend class TransformationPipeline;
+    friend class TransformationPlugin; // a PIPELINE_STAGE TransformationPlugin produces through its Stage.
+  };
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of the transformation.
+   * @see TransformationPlugin::Type
+   */
+  TransformationPipeline(Transaction &transaction, TransformationPlugin::Type type);
+
+  /**
+   * Appends a Stage to the pipeline, the pipeline takes ownership of the Stage. All stages
+   * must be added before the transformation receives any data.
+   *
+   * @param stage the Stage to append.
+   */
+  void addStage(Stage *stage);
+
+  /**
+   * Appends a TransformationPlugin to the pipeline, the pipeline takes ownership of it. The TransformationPlugin
+   * must have been created with the type TransformationPlugin::PIPELINE_STAGE and must not be added to the
+   * transaction. A pipeline stage can't offload to the task thread pool or set its output length or watermarks,
+   * those belong to the TransformationPipeline.
+   *
+   * @param transformation_plugin the TransformationPlugin to append.
+   */
+  void addStage(TransformationPlugin *transformation_plugin);
+
+  void consume(const std::string &data);
+  void handleInputComplete();
+  void handleWakeup();
+  void handleOutputDrained();
+
+  virtual ~TransformationPipeline();
+private:
+  TransformationPipelineState *state_; /** Internal state for a TransformationPipeline */
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_TRANSFORMATIONPIPELINE_H_ */
@@ -21,6 +21,7 @@
 #define ATSCPPAPI_TRANSFORMATIONPLUGIN_H_
 
 #include <string>
+#include <stdint.h>
 #include <atscppapi/Transaction.h>
 #include <atscppapi/TransactionPlugin.h>
 
@@ -38,6 +39,15 @@ class TransformationPluginState;
  * in the chain by calling produce() and when the transformation has no data left to send
  * it will fire a setOutputCompete().
  *
+ * Output is flow controlled: once the bytes produced by a TransformationPlugin that have not yet
+ * been read downstream exceed a high watermark the TransformationPlugin will stop reading from its input
+ * and it will resume once the downstream consumer has drained the output below a low watermark,
+ * see setOutputWatermarks().
+ *
+ * A TransformationPlugin that does CPU intensive work, such as compression at a high level, can call
+ * enableThreadPoolOffload() so that consume() and handleInputComplete() run on the Traffic Server task
+ * thread pool instead of stalling the network thread that delivered the data, see enableThreadPoolOffload().
+ *
  * Since a TransformationPlugin is a type of TransactionPlugin you can call registerHook() and
  * establish any hook for a Transaction also; however, remember that you must implement
  * the appropriate callback for any hooks you register.
@@ -81,7 +91,8 @@ public:
    */
   enum Type {
     REQUEST_TRANSFORMATION = 0, /**< Transform the Request body content */
-    RESPONSE_TRANSFORMATION /**< Transform the Response body content */
+    RESPONSE_TRANSFORMATION, /**< Transform the Response body content */
+    PIPELINE_STAGE /**< Run as a stage of a TransformationPipeline, see TransformationPipeline::addStage() */
   };
 
   /**
@@ -96,9 +107,86 @@ public:
    */
   virtual void handleInputComplete() = 0;
 
+  /**
+   * This method will be fired when the output waiting to be read downstream has dropped to the low
+   * watermark, see setOutputWatermarks(). A TransformationPlugin that has a lot of output to write without
+   * new input, for example a body it buffered, can write it a piece at a time from here instead of all at once.
+   * The default implementation does nothing.
+   */
+  virtual void handleOutputDrained();
+
+  /**
+   * This method will be fired once the delay passed to scheduleWakeup() has passed. Like consume() it is
+   * never called at the same time as any other method of this TransformationPlugin, so it can be used to
+   * flush output that is being held back when no new input arrives. The default implementation does nothing.
+   */
+  virtual void handleWakeup();
+
+  /**
+   * @return The number of bytes this TransformationPlugin has produced that have not yet been
+   *  read by the downstream consumer.
+   */
+  int64_t getBufferedOutputBytes() const;
+
+  /**
+   * @return The largest number of produced bytes that were waiting to be read by the downstream
+   *  consumer at any point during this transformation, this can be used to size the output watermarks.
+   */
+  int64_t getPeakBufferedOutputBytes() const;
+
+  /**
+   * @return The number of times this TransformationPlugin stopped reading its input because
+   *  the output passed the high watermark.
+   */
+  int getInputPauseCount() const;
+
+  /**
+   * @return True if abortOutput() was called.
+   */
+  bool isOutputAborted() const;
+
   virtual ~TransformationPlugin(); /**< Destructor for a TransformationPlugin */
 protected:
 
+  /**
+   * Declare how many bytes this TransformationPlugin is going to produce in total, this must be called
+   * before the first call to produce(). When the output length is known Traffic Server will send the
+   * transformed content with a Content-Length rather than chunked, which also allows it to be cached as a
+   * complete object and served to HTTP/1.0 clients. A TransformationPlugin that declares an output length
+   * must produce exactly that many bytes, the output is aborted as with abortOutput() when a call to
+   * produce() would exceed the length or the output is completed short of it.
+   *
+   * @param length the total number of bytes that will be produced.
+   * @return true if the output length was set, false if output has already started or length is negative.
+   */
+  bool setOutputLength(int64_t length);
+
+  /**
+   * Change the output watermarks of this TransformationPlugin. When the bytes produced but not yet
+   * read downstream reach high_watermark the TransformationPlugin stops consuming input, and it will resume
+   * once the downstream consumer has reduced the buffered output to low_watermark or less.
+   *
+   * @param high_watermark the number of buffered output bytes at which input is paused, a value of 0
+   *  disables flow control. The default value is 256KB.
+   * @param low_watermark the number of buffered output bytes at which input is resumed, this must be
+   *  less than high_watermark. The default value is 64KB.
+   */
+  void setOutputWatermarks(int64_t high_watermark, int64_t low_watermark);
+
+  /**
+   * Run consume() and handleInputComplete() on the task thread pool (TS_THREAD_POOL_TASK) rather than
+   * on the network thread, this should be called from the constructor of your TransformationPlugin.
+   * Calls are still made one at a time and in order while holding the TransactionPlugin mutex, and anything
+   * passed to produce() or setOutputComplete() from these calls is handed back to the network thread and
+   * written in the order it was produced. When offloading you should only call produce() and setOutputComplete()
+   * from consume() or handleInputComplete().
+   *
+   * @param max_in_flight_chunks the number of input chunks that can be waiting on or being processed
+   *  by the task thread before the TransformationPlugin stops reading its input, this bounds the memory used
+   *  by a slow transformation. The default value is 4.
+   */
+  void enableThreadPoolOffload(int max_in_flight_chunks = 4);
+
   /**
    * This method is how a TransformationPlugin will produce output for the downstream
    * transformation plugin, if you need to produce binary data this can still be
@@ -107,16 +195,49 @@ protected:
    */
   size_t produce(const std::string &);
 
+  /**
+   * This method behaves exactly like produce(const std::string &) but it avoids constructing
+   * a string when the output already lives in a buffer.
+   *
+   * @param data the output to write
+   * @param length the number of bytes of data to write
+   */
+  size_t produce(const char *data, size_t length);
+
   /**
    * This is the method that you must call when you're done producing output for
    * the downstream TranformationPlugin.
    */
   size_t setOutputComplete();
 
+  /**
+   * Requests a call to handleWakeup() after delay_ms, this should be called from consume(). Only one wakeup
+   * can be pending at a time, when one already is this does nothing. No wakeup is delivered once the output
+   * is complete or aborted.
+   *
+   * @param delay_ms the number of milliseconds to wait.
+   */
+  void scheduleWakeup(int delay_ms);
+
+  /**
+   * Call this instead of setOutputComplete() when the transformation cannot produce the whole body, for
+   * example when the input is corrupt or a limit was hit part way through. The response is marked as not
+   * cacheable and the output is aborted rather than completed, so downstream never receives a partial body
+   * that looks complete. Any output produced afterwards is dropped and the rest of the input is read but
+   * not passed to consume() or handleInputComplete().
+   *
+   * The response is only marked as not cacheable when this is called, by then the response headers may
+   * already have been sent downstream and the cache write started. A TransformationPlugin that may abort
+   * should call Transaction::setTransformedResponseCached(false) before its first produce() if the
+   * transformed response must never reach the cache.
+   */
+  void abortOutput();
+
   /** a TransformationPlugin must implement this interface, it cannot be constructed directly */
   TransformationPlugin(Transaction &transaction, Type type);
 private:
   TransformationPluginState *state_; /** Internal state for a TransformationPlugin */
+  friend class TransformationPipeline; // so it can connect the output of a PIPELINE_STAGE to the next stage.
 };
 
 } /* atscppapi */
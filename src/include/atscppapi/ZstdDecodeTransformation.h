@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ZstdDecodeTransformation.h
+ * @brief Zstd Decode Transformation can be used to decompress zstd content.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ZSTDDECODETRANSFORMATION_H_
+#define ATSCPPAPI_ZSTDDECODETRANSFORMATION_H_
+
+#include <string>
+#include <stdint.h>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/Stat.h"
+#include "atscppapi/CompressionDictionary.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for Zstd Decode Transformations
+ * @private
+ */
+class ZstdDecodeTransformationState;
+
+/**
+ * @brief A TransformationPlugin to easily add zstd decompression to your TransformationPlugin chain.
+ *
+ * The ZstdDecodeTransformation works exactly like the GzipInflateTransformation, including its
+ * limits on the decompressed size. It is only available when libatscppapi was built with zstd.
+ *
+ * @note ZstdDecodeTransformation DOES NOT set or check Content-Encoding headers.
+ *
+ * @see ZstdEncodeTransformation
+ * @see GzipInflateTransformation
+ */
+class ZstdDecodeTransformation : public TransformationPlugin {
+public:
+  /**
+   * @brief The limits of a ZstdDecodeTransformation, by default only the window size is limited.
+   */
+  struct Options {
+    int64_t max_output_bytes_; /**< The maximum number of decompressed bytes, 0 means no limit. */
+    int max_expansion_ratio_; /**< The maximum ratio of decompressed bytes to compressed bytes, 0 means no limit.
+                                   It is only enforced once 1MB has been decompressed. */
+    Stat *aborted_stat_; /**< An optional Stat incremented each time a transformation is aborted by a limit. */
+    const CompressionDictionary *dictionary_; /**< The dictionary the content was compressed with, if any. */
+    int max_window_log_; /**< The base two logarithm of the largest window a frame may ask for, the window is
+                              allocated before any output so this bounds the memory of each stream. Frames
+                              needing a larger window are aborted. The default is 23 (8MB), 0 uses zstd's
+                              own limit of 27 (128MB). */
+    Options() : max_output_bytes_(0), max_expansion_ratio_(0), aborted_stat_(NULL), dictionary_(NULL),
+                max_window_log_(23) { };
+  };
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of the transformation.
+   * @param options the limits to apply to the decompressed content.
+   */
+  ZstdDecodeTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                             const Options &options = Options());
+
+  /**
+   * Decompresses data.
+   *
+   * @param data the input data to decompress
+   */
+  void consume(const std::string &data);
+
+  /**
+   * Completes the output, or aborts it if the zstd stream was truncated.
+   */
+  void handleInputComplete();
+
+  /**
+   * @return True if decompression was stopped because the content exceeded a limit in Options, could not
+   *  be decompressed or was truncated.
+   */
+  bool isAborted() const;
+
+  virtual ~ZstdDecodeTransformation();
+private:
+  ZstdDecodeTransformationState *state_; /** Internal state for Zstd Decode Transformations */
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_ZSTDDECODETRANSFORMATION_H_ */
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ZstdEncodeTransformation.h
+ * @brief Zstd Encode Transformation can be used to compress content with zstd.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ZSTDENCODETRANSFORMATION_H_
+#define ATSCPPAPI_ZSTDENCODETRANSFORMATION_H_
+
+#include <string>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/CompressionDictionary.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for Zstd Encode Transformations
+ * @private
+ */
+class ZstdEncodeTransformationState;
+
+/**
+ * @brief A TransformationPlugin to easily add zstd compression to your TransformationPlugin chain.
+ *
+ * The ZstdEncodeTransformation works exactly like the GzipDeflateTransformation, it is only
+ * available when libatscppapi was built with zstd, which configure detects automatically.
+ *
+ * @note ZstdEncodeTransformation DOES NOT set Content-Encoding headers, it is the
+ * users responsibility to set any applicable headers and to check that the client accepts zstd.
+ *
+ * @see ZstdDecodeTransformation
+ * @see GzipDeflateTransformation
+ */
+class ZstdEncodeTransformation : public TransformationPlugin {
+public:
+  /**
+   * @brief The compression parameters of a ZstdEncodeTransformation.
+   *
+   * As with GzipDeflateTransformation the output is only flushed once flush_bytes_ of input
+   * have been compressed unless latency_sensitive_ is set.
+   *
+   * When dictionary_ is set the frames are compressed with it and can only be decompressed with the
+   * same dictionary. The dictionary is digested once per compression level and shared by all transformations.
+   */
+  struct Options {
+    int level_; /**< The compression level from 1 (fastest) to 19 (best), the default is 3. */
+    int window_log_; /**< The base two logarithm of the window size from 10 to 27, 0 uses the default for the level. */
+    bool checksum_; /**< Add a checksum of the content to the end of the frame, the default is false. */
+    size_t flush_bytes_; /**< The input bytes compressed before the output is flushed, the default is 64KB. */
+    bool latency_sensitive_; /**< Flush the output on every consume(), the default is false. */
+    const CompressionDictionary *dictionary_; /**< An optional dictionary, the default is NULL. */
+    Options() : level_(3), window_log_(0), checksum_(false), flush_bytes_(64 * 1024), latency_sensitive_(false),
+                dictionary_(NULL) { };
+  };
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of the transformation.
+   * @param options the compression parameters to use.
+   */
+  ZstdEncodeTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                             const Options &options = Options());
+
+  /**
+   * Compresses data with zstd.
+   *
+   * @param data the input data to compress
+   */
+  void consume(const std::string &data);
+
+  /**
+   * Finishes the zstd frame and completes the output.
+   */
+  void handleInputComplete();
+
+  virtual ~ZstdEncodeTransformation();
+private:
+  void encode(const char *data, size_t length, int operation);
+  ZstdEncodeTransformationState *state_; /** Internal state for Zstd Encode Transformations */
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_ZSTDENCODETRANSFORMATION_H_ */
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file deflate_backend_internal.h
+ *
+ * @brief internal interface to the deflate implementations used by the gzip transformations
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_DEFLATE_BACKEND_INTERNAL_H_
+#define ATSCPPAPI_DEFLATE_BACKEND_INTERNAL_H_
+
+#include <cstddef>
+#include <cstring>
+#include "atscppapi/noncopyable.h"
+#include "logging_internal.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * A deflate or inflate stream, this mirrors the parts of the zlib z_stream interface that the gzip
+ * transformations use so that different deflate implementations can be used interchangeably.
+ *
+ * The backend is chosen at configure time, zlib is always available and zlib-ng is used when configure
+ * finds it. When several are compiled in the ATSCPPAPI_DEFLATE_BACKEND environment variable can be set to
+ * "zlib" or "zlib-ng" to choose one at runtime. The backends do their own CPU feature detection.
+ */
+class DeflateStream : noncopyable {
+public:
+  enum Flush {
+    FLUSH_NONE = 0,
+    FLUSH_SYNC,
+    FLUSH_FINISH
+  };
+
+  enum Status {
+    STATUS_OK = 0, /**< progress was made */
+    STATUS_STREAM_END, /**< the end of the stream was written or read */
+    STATUS_BUF_ERROR, /**< no progress was possible, this isn't fatal */
+    STATUS_ERROR /**< the stream is corrupt or the stream state is invalid */
+  };
+
+  /**
+   * Compresses or decompresses as much of the input into the output as possible.
+   *
+   * @param flush ignored by inflate streams.
+   * @return the Status, error_code is set to the backend specific error code.
+   */
+  virtual Status process(Flush flush, int &error_code) = 0;
+
+  virtual void setInput(const char *data, size_t length) = 0;
+  virtual size_t getAvailableInput() const = 0;
+  virtual void setOutput(char *buffer, size_t length) = 0;
+  virtual size_t getAvailableOutput() const = 0;
+
+  virtual ~DeflateStream() { }
+};
+
+/**
+ * A DeflateStream for implementations with a zlib style interface, Api provides the stream type,
+ * the functions and the constants of one implementation.
+ */
+template <typename Api>
+class ZlibStyleDeflateStream : public DeflateStream {
+public:
+  ZlibStyleDeflateStream() : deflate_(false), initialized_(false), dictionary_(NULL), dictionary_length_(0) {
+    memset(&stream_, 0, sizeof(stream_));
+  }
+
+  bool initDeflate(int level, int window_bits, int mem_level, int strategy, const char *dictionary,
+                   size_t dictionary_length, int &error_code) {
+    deflate_ = true;
+    error_code = Api::initDeflate(&stream_, level, window_bits, mem_level, strategy);
+    initialized_ = (error_code == Api::OK);
+    if (initialized_ && dictionary) {
+      error_code = Api::setDeflateDictionary(&stream_, reinterpret_cast<typename Api::InputPointer>(
+                                               const_cast<char *>(dictionary)), dictionary_length);
+    }
+    return error_code == Api::OK;
+  }
+
+  /**
+   * The dictionary must outlive the stream, it's only handed to the implementation once the
+   * stream header asks for it.
+   */
+  bool initInflate(int window_bits, const char *dictionary, size_t dictionary_length, int &error_code) {
+    deflate_ = false;
+    dictionary_ = dictionary;
+    dictionary_length_ = dictionary_length;
+    error_code = Api::initInflate(&stream_, window_bits);
+    initialized_ = (error_code == Api::OK);
+    return initialized_;
+  }
+
+  Status process(Flush flush, int &error_code) {
+    if (deflate_) {
+      int zflush = (flush == FLUSH_FINISH) ? Api::FINISH : ((flush == FLUSH_SYNC) ? Api::SYNC_FLUSH : Api::NO_FLUSH);
+      error_code = Api::runDeflate(&stream_, zflush);
+    } else {
+      error_code = Api::runInflate(&stream_, Api::SYNC_FLUSH);
+      if (error_code == Api::NEED_DICT && dictionary_) {
+        error_code = Api::setInflateDictionary(&stream_, reinterpret_cast<typename Api::InputPointer>(
+                                                 const_cast<char *>(dictionary_)), dictionary_length_);
+        if (error_code == Api::OK) {
+          error_code = Api::runInflate(&stream_, Api::SYNC_FLUSH);
+        }
+      }
+    }
+
+    if (error_code == Api::OK) {
+      return STATUS_OK;
+    } else if (error_code == Api::STREAM_END) {
+      return STATUS_STREAM_END;
+    } else if (error_code == Api::BUF_ERROR) {
+      return STATUS_BUF_ERROR;
+    }
+    return STATUS_ERROR;
+  }
+
+  void setInput(const char *data, size_t length) {
+    stream_.next_in = reinterpret_cast<typename Api::InputPointer>(const_cast<char *>(data));
+    stream_.avail_in = length;
+  }
+
+  size_t getAvailableInput() const {
+    return stream_.avail_in;
+  }
+
+  void setOutput(char *buffer, size_t length) {
+    stream_.next_out = reinterpret_cast<typename Api::OutputPointer>(buffer);
+    stream_.avail_out = length;
+  }
+
+  size_t getAvailableOutput() const {
+    return stream_.avail_out;
+  }
+
+  ~ZlibStyleDeflateStream() {
+    if (initialized_) {
+      if (deflate_) {
+        Api::endDeflate(&stream_);
+      } else {
+        Api::endInflate(&stream_);
+      }
+    }
+  }
+private:
+  typename Api::Stream stream_;
+  bool deflate_;
+  bool initialized_;
+  const char *dictionary_;
+  size_t dictionary_length_;
+};
+
+template <typename Api>
+DeflateStream *createZlibStyleDeflateStream(const char *name, int level, int window_bits, int mem_level,
+                                            int strategy, const char *dictionary, size_t dictionary_length) {
+  ZlibStyleDeflateStream<Api> *stream = new ZlibStyleDeflateStream<Api>();
+  int err;
+  if (!stream->initDeflate(level, window_bits, mem_level, strategy, dictionary, dictionary_length, err)) {
+    LOG_ERROR("Unable to initialize %s deflate stream, error code '%d'.", name, err);
+    delete stream;
+    return NULL;
+  }
+  return stream;
+}
+
+template <typename Api>
+DeflateStream *createZlibStyleInflateStream(const char *name, int window_bits, const char *dictionary,
+                                            size_t dictionary_length) {
+  ZlibStyleDeflateStream<Api> *stream = new ZlibStyleDeflateStream<Api>();
+  int err;
+  if (!stream->initInflate(window_bits, dictionary, dictionary_length, err)) {
+    LOG_ERROR("Unable to initialize %s inflate stream, error code '%d'.", name, err);
+    delete stream;
+    return NULL;
+  }
+  return stream;
+}
+
+/**
+ * @return A new deflate stream writing the gzip format, or NULL if it could not be initialized.
+ */
+DeflateStream *createGzipDeflateStream(int level, int window_bits, int mem_level, int strategy);
+
+/**
+ * @return A new inflate stream reading the gzip format, or NULL if it could not be initialized.
+ */
+DeflateStream *createGzipInflateStream();
+
+/**
+ * The gzip format has no way to tell the reader that a preset dictionary was used, so streams
+ * primed with a dictionary write the zlib format (the HTTP "deflate" content coding) instead.
+ *
+ * @return A new deflate stream writing the zlib format, or NULL if it could not be initialized.
+ */
+DeflateStream *createZlibDeflateStream(int level, int window_bits, int mem_level, int strategy,
+                                       const char *dictionary, size_t dictionary_length);
+
+/**
+ * @return A new inflate stream reading the zlib or gzip format which supplies the dictionary, which
+ * must outlive the stream, when the zlib header asks for one. NULL if it could not be initialized.
+ */
+DeflateStream *createZlibInflateStream(const char *dictionary, size_t dictionary_length);
+
+/**
+ * @return The name of the deflate backend in use.
+ */
+const char *getDeflateBackendName();
+
+#ifdef ATSCPPAPI_HAVE_ZLIB_NG
+// window_bits select the format exactly as they do for zlib.
+DeflateStream *createZlibNgDeflateStream(int level, int window_bits, int mem_level, int strategy,
+                                         const char *dictionary, size_t dictionary_length);
+DeflateStream *createZlibNgInflateStream(int window_bits, const char *dictionary, size_t dictionary_length);
+#endif
+
+}
+
+}
+
+#endif /* ATSCPPAPI_DEFLATE_BACKEND_INTERNAL_H_ */
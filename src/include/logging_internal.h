@@ -34,7 +34,47 @@
 #undef LOG_ERROR
 #endif
 
-#define LOG_DEBUG(fmt, ...) TS_DEBUG("atscppapi", fmt, ## __VA_ARGS__)
+namespace atscppapi {
+
+/**
+ * Whether the debug tag of one LOG_DEBUG call site is enabled. TSIsDebugTagSet() matches the tag against
+ * every enabled tag expression, so the answer is cached and only asked for again once a second.
+ *
+ * @private
+ */
+struct DebugTagCache {
+  volatile int enabled_;
+  volatile int64_t check_time_ms_;
+
+  bool isEnabled(const char *tag);
+};
+
+}
+
+#define ATSCPPAPI_DEBUG_TAG_CACHE_INITIALIZER { 0, 0 }
+
+/*
+ * Internal debug messages are only formatted, and their arguments only evaluated, when the call site's
+ * tag is enabled. Building with ATSCPPAPI_DISABLE_INTERNAL_DEBUG (configure --disable-internal-debug)
+ * compiles them out entirely, the arguments are still type checked.
+ */
+#ifdef ATSCPPAPI_DISABLE_INTERNAL_DEBUG
+#define LOG_DEBUG(fmt, ...) \
+  do { \
+    if (false) { \
+      TSDebug("atscppapi", fmt, ## __VA_ARGS__); \
+    } \
+  } while (false)
+#else
+#define LOG_DEBUG(fmt, ...) \
+  do { \
+    static atscppapi::DebugTagCache atscppapi_debug_tag_cache = ATSCPPAPI_DEBUG_TAG_CACHE_INITIALIZER; \
+    if (atscppapi_debug_tag_cache.isEnabled("atscppapi." __FILE__ ":" LINE_NO)) { \
+      TS_DEBUG("atscppapi", fmt, ## __VA_ARGS__); \
+    } \
+  } while (false)
+#endif
+
 #define LOG_ERROR(fmt, ...) TS_ERROR("atscppapi", fmt, ## __VA_ARGS__)
 
 #endif /* ATSCPPAPI_LOGGING_INTERNAL_H_ */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file structured_log_internal.h
+ *
+ * @brief the binary record format shared by StructuredLogger and tools/structured_log_decoder/.
+ *
+ * A file starts with STRUCTURED_LOG_MAGIC followed by records, each starting with a tag byte:
+ *  - RECORD_FORMAT: varint format id, varint length, the printf format.
+ *  - RECORD_EVENT: varint format id, varint microseconds since the epoch, then one value per conversion
+ *    in the format: signed integers are zigzag varints, unsigned integers and pointers are varints,
+ *    doubles are their 8 bytes in host order and strings are a varint length followed by the bytes.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_STRUCTURED_LOG_INTERNAL_H_
+#define ATSCPPAPI_STRUCTURED_LOG_INTERNAL_H_
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace atscppapi {
+
+namespace structured_log {
+
+const char STRUCTURED_LOG_MAGIC[] = "ATSCPPSL1";
+const size_t STRUCTURED_LOG_MAGIC_LENGTH = sizeof(STRUCTURED_LOG_MAGIC) - 1;
+const unsigned char RECORD_FORMAT = 'F';
+const unsigned char RECORD_EVENT = 'E';
+const size_t MAX_VARINT_LENGTH = 10;
+
+/**
+ * The C type a conversion reads from the argument list, which decides how its value is encoded.
+ */
+enum ArgumentType {
+  ARG_INT = 0,
+  ARG_LONG,
+  ARG_LONG_LONG,
+  ARG_UNSIGNED,
+  ARG_UNSIGNED_LONG,
+  ARG_UNSIGNED_LONG_LONG,
+  ARG_SIZE,
+  ARG_DOUBLE,
+  ARG_STRING,
+  ARG_POINTER
+};
+
+/**
+ * A piece of a format, either literal text (a conversion with the type of the literal is never read)
+ * or a single conversion specification such as "%-8.3f".
+ */
+struct FormatPiece {
+  bool literal_;
+  std::string text_;
+  ArgumentType type_;
+};
+
+inline bool isSigned(ArgumentType type) {
+  return type == ARG_INT || type == ARG_LONG || type == ARG_LONG_LONG;
+}
+
+/**
+ * Splits a printf format into literal text and conversions. Flags, a width, a precision and the
+ * hh, h, l, ll and z length modifiers are supported; '*' widths and long doubles are not.
+ *
+ * @return false if the format has a conversion that isn't supported.
+ */
+inline bool parseFormat(const std::string &format, std::vector<FormatPiece> &pieces) {
+  pieces.clear();
+  std::string literal;
+  size_t i = 0;
+  while (i < format.length()) {
+    if (format[i] != '%') {
+      literal += format[i++];
+      continue;
+    }
+    if (i + 1 < format.length() && format[i + 1] == '%') {
+      literal += '%';
+      i += 2;
+      continue;
+    }
+
+    size_t start = i++;
+    while (i < format.length() && strchr("-+ #0", format[i])) {
+      ++i;
+    }
+    while (i < format.length() && ((format[i] >= '0' && format[i] <= '9') || format[i] == '.')) {
+      ++i;
+    }
+    int longs = 0;
+    bool size = false;
+    while (i < format.length() && strchr("hlzj", format[i])) {
+      longs += (format[i] == 'l') ? 1 : 0;
+      size = size || format[i] == 'z' || format[i] == 'j';
+      ++i;
+    }
+    if (i >= format.length()) {
+      return false;
+    }
+
+    FormatPiece piece;
+    piece.literal_ = false;
+    char conversion = format[i++];
+    if (strchr("dic", conversion)) {
+      piece.type_ = size ? ARG_LONG : ((longs == 0) ? ARG_INT : ((longs == 1) ? ARG_LONG : ARG_LONG_LONG));
+    } else if (strchr("ouxX", conversion)) {
+      piece.type_ = size ? ARG_SIZE : ((longs == 0) ? ARG_UNSIGNED :
+                                       ((longs == 1) ? ARG_UNSIGNED_LONG : ARG_UNSIGNED_LONG_LONG));
+    } else if (strchr("eEfFgGaA", conversion)) {
+      piece.type_ = ARG_DOUBLE;
+    } else if (conversion == 's') {
+      piece.type_ = ARG_STRING;
+    } else if (conversion == 'p') {
+      piece.type_ = ARG_POINTER;
+    } else {
+      return false;
+    }
+
+    if (!literal.empty()) {
+      FormatPiece text = { true, literal, ARG_INT };
+      pieces.push_back(text);
+      literal.clear();
+    }
+    piece.text_ = format.substr(start, i - start);
+    pieces.push_back(piece);
+  }
+
+  if (!literal.empty()) {
+    FormatPiece text = { true, literal, ARG_INT };
+    pieces.push_back(text);
+  }
+  return true;
+}
+
+/**
+ * @return the number of bytes written to buffer, which must have room for MAX_VARINT_LENGTH bytes.
+ */
+inline size_t encodeVarint(uint64_t value, char *buffer) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    buffer[length++] = static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  buffer[length++] = static_cast<char>(value);
+  return length;
+}
+
+/**
+ * @return false if the varint runs past end.
+ */
+inline bool decodeVarint(const char *&data, const char *end, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; data < end && shift < 64; shift += 7) {
+    unsigned char byte = static_cast<unsigned char>(*data++);
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline uint64_t zigzagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+}
+
+}
+
+#endif /* ATSCPPAPI_STRUCTURED_LOG_INTERNAL_H_ */
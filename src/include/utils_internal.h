@@ -76,6 +76,10 @@ public:
   static const std::list<TransactionPlugin *> &getTransactionPlugins(const Transaction &transaction) {
     return transaction.getPlugins();
   }
+
+  static void flushTransactionStats(Transaction &transaction) {
+    transaction.flushStats();
+  }
 }; /* internal */
 
 } /* utils */
@@ -73,6 +73,8 @@ int handleTransactionEvents(TSCont cont, TSEvent event, void *edata) {
         delete *iter;
         trans_mutex->unlock();
       }
+      // plugins may record stats as they're destroyed, so flush only once they're all gone
+      utils::internal::flushTransactionStats(transaction);
       delete &transaction;
     }
     break;
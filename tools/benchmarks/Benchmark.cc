@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file Benchmark.cc
+ */
+
+#include <cstdio>
+#include <string>
+#include "atscppapi/TransformationPlugin.h"
+#include "Benchmark.h"
+
+using atscppapi::TransformationPlugin;
+using std::string;
+using std::vector;
+
+namespace {
+
+const char *WORDS[] = { "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit", "sed", "do",
+                        "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore", "magna", "aliqua" };
+const int WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+const int HOST_COUNT = 100;
+
+uint32_t next(uint32_t &seed) {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+void appendHost(string &body, uint32_t &seed) {
+  char host[32];
+  snprintf(host, sizeof(host), "origin%u.example.com", next(seed) % HOST_COUNT);
+  body += host;
+}
+
+void appendWords(string &body, uint32_t &seed, int count) {
+  for (int i = 0; i < count; ++i) {
+    if (i) {
+      body += ' ';
+    }
+    body += WORDS[next(seed) % WORD_COUNT];
+  }
+}
+
+void appendHtml(string &body, uint32_t &seed) {
+  body += "<li class=\"item\"><a href=\"http://";
+  appendHost(body, seed);
+  char path[32];
+  snprintf(path, sizeof(path), "/item/%u\">", next(seed) % 100000);
+  body += path;
+  appendWords(body, seed, 2 + next(seed) % 4);
+  body += "</a><p>";
+  appendWords(body, seed, 8 + next(seed) % 16);
+  body += "</p></li>\n";
+}
+
+void appendJson(string &body, uint32_t &seed) {
+  char fields[64];
+  snprintf(fields, sizeof(fields), "{\"id\":%u,\"score\":%u.%02u,\"name\":\"", next(seed) % 1000000,
+           next(seed) % 100, next(seed) % 100);
+  body += fields;
+  appendWords(body, seed, 2);
+  body += "\",\"url\":\"https://";
+  appendHost(body, seed);
+  body += "/api/v1/items\",\"tags\":[\"";
+  appendWords(body, seed, 1);
+  body += "\",\"";
+  appendWords(body, seed, 1);
+  body += "\"],\"active\":";
+  body += (next(seed) % 2) ? "true" : "false";
+  body += "},";
+}
+
+void appendJs(string &body, uint32_t &seed) {
+  char code[128];
+  uint32_t a = next(seed) % 26, b = next(seed) % 26, n = next(seed) % 1000;
+  snprintf(code, sizeof(code), "function %c%c(e,t){var n=e.%c||%u;return t?n+t.length:n*%u}", 'a' + a, 'a' + b,
+           'a' + b, n, n % 7 + 2);
+  body += code;
+  body += "var ";
+  body += static_cast<char>('a' + a);
+  body += "=\"//";
+  appendHost(body, seed);
+  body += "/static/js/\"+";
+  snprintf(code, sizeof(code), "%u;if(%c.length>%u){%c%c(%c,\"", n, 'a' + a, n % 64, 'a' + a, 'a' + b, 'a' + a);
+  body += code;
+  appendWords(body, seed, 1);
+  body += "\")}";
+}
+
+}
+
+const char *benchmark::BODY_TYPE_NAMES[] = { "html", "json", "js" };
+
+string benchmark::createBody(BodyType body_type, size_t length) {
+  string body;
+  body.reserve(length + 256);
+  uint32_t seed = 42;
+  if (body_type == BODY_JSON) {
+    body += '[';
+  }
+  while (body.length() < length) {
+    switch (body_type) {
+    case BODY_HTML:
+      appendHtml(body, seed);
+      break;
+    case BODY_JSON:
+      appendJson(body, seed);
+      break;
+    case BODY_JS:
+      appendJs(body, seed);
+      break;
+    }
+  }
+  if (body_type == BODY_JSON) {
+    body[body.length() - 1] = ']';
+  }
+  return body;
+}
+
+vector<string> benchmark::splitBody(const string &body, size_t chunk_length) {
+  vector<string> chunks;
+  for (size_t offset = 0; offset < body.length(); offset += chunk_length) {
+    chunks.push_back(body.substr(offset, chunk_length));
+  }
+  return chunks;
+}
+
+double benchmark::runTransformation(TransformationPlugin &transformation_plugin, const vector<string> &chunks) {
+  double begin = getTimeSeconds();
+  for (vector<string>::const_iterator iter = chunks.begin(), end = chunks.end(); iter != end; ++iter) {
+    transformation_plugin.consume(*iter);
+  }
+  transformation_plugin.handleInputComplete();
+  return getTimeSeconds() - begin;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Benchmark.h
+ * @brief Helpers shared by the benchmarks, see TrafficServerStubs.cc for the Traffic Server API they run against.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_BENCHMARK_H_
+#define ATSCPPAPI_BENCHMARK_H_
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+
+namespace atscppapi {
+class Transaction;
+class TransformationPlugin;
+}
+
+namespace benchmark {
+
+/**
+ * How many text log entries were written and the number of bytes they held after the 16KB entry limit.
+ */
+extern volatile uint64_t text_log_entries;
+extern volatile uint64_t text_log_bytes;
+
+/**
+ * Everything TransformationPlugins wrote to their output VConn since it was last cleared, and the number of
+ * times a TransformationPlugin aborted its output.
+ */
+extern std::string transformation_output;
+extern int transformation_aborts;
+
+/**
+ * The shapes of body that the transformation benchmarks run on, all of them mention the hostnames
+ * origin0.example.com up to origin99.example.com.
+ */
+enum BodyType {
+  BODY_HTML = 0,
+  BODY_JSON,
+  BODY_JS
+};
+
+extern const char *BODY_TYPE_NAMES[];
+
+/**
+ * @return a body of body_type of about length bytes, the same body is returned on every call.
+ */
+std::string createBody(BodyType body_type, size_t length);
+
+/**
+ * @return a Transaction for creating TransformationPlugins, only what they use of it works (see TransactionStubs.cc).
+ */
+atscppapi::Transaction &getTransaction();
+
+/**
+ * @return body split into chunks of chunk_length bytes, the last one may be shorter.
+ */
+std::vector<std::string> splitBody(const std::string &body, size_t chunk_length);
+
+/**
+ * Passes each chunk to consume() and then calls handleInputComplete(), as the transform VConn would.
+ *
+ * @return the seconds it took.
+ */
+double runTransformation(atscppapi::TransformationPlugin &transformation_plugin,
+                         const std::vector<std::string> &chunks);
+
+inline double getTimeSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * @return the numeric argument at index, or default_value if it wasn't given.
+ */
+inline int getIntArgument(int argc, char *argv[], int index, int default_value) {
+  return (argc > index) ? atoi(argv[index]) : default_value;
+}
+
+} /* benchmark */
+
+#endif /* ATSCPPAPI_BENCHMARK_H_ */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file CompressionBenchmark.cc
+ *
+ * Compares gzip with brotli and zstd at their default Options on HTML, JSON and minified JS bodies: the
+ * compression ratio, the encode and decode throughput of the transformations, and whether decoding gives
+ * back the body. Brotli and zstd are only measured when configure found them:
+ *
+ *   compression_benchmark [megabytes] [chunk_bytes]
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "atscppapi/GzipDeflateTransformation.h"
+#include "atscppapi/GzipInflateTransformation.h"
+#ifdef ATSCPPAPI_HAVE_BROTLI
+#include "atscppapi/BrotliEncodeTransformation.h"
+#include "atscppapi/BrotliDecodeTransformation.h"
+#endif
+#ifdef ATSCPPAPI_HAVE_ZSTD
+#include "atscppapi/ZstdEncodeTransformation.h"
+#include "atscppapi/ZstdDecodeTransformation.h"
+#endif
+#include "Benchmark.h"
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int ROUNDS = 3;
+
+/**
+ * @return the best time of ROUNDS runs of a new Transformation over chunks, its output is left in output.
+ */
+template <typename Transformation>
+double measure(const vector<string> &chunks, string &output) {
+  double best_seconds = 1e9;
+  for (int i = 0; i < ROUNDS; ++i) {
+    benchmark::transformation_output.clear();
+    Transformation transformation(benchmark::getTransaction(), TransformationPlugin::RESPONSE_TRANSFORMATION);
+    double seconds = benchmark::runTransformation(transformation, chunks);
+    best_seconds = (seconds < best_seconds) ? seconds : best_seconds;
+  }
+  output.swap(benchmark::transformation_output);
+  return best_seconds;
+}
+
+template <typename Encoder, typename Decoder>
+void compare(const char *name, benchmark::BodyType body_type, const string &body, size_t chunk_length) {
+  string encoded, decoded;
+  double encode_seconds = measure<Encoder>(benchmark::splitBody(body, chunk_length), encoded);
+  double decode_seconds = measure<Decoder>(benchmark::splitBody(encoded, chunk_length), decoded);
+
+  double megabytes = static_cast<double>(body.length()) / (1024 * 1024);
+  printf("%-6s  %-4s  %5.3f  %11.1f  %11.1f  %10s\n", name, benchmark::BODY_TYPE_NAMES[body_type],
+         static_cast<double>(encoded.length()) / body.length(), megabytes / encode_seconds,
+         megabytes / decode_seconds, (decoded == body) ? "ok" : "FAILED");
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 1, 10)) * 1024 * 1024;
+  size_t chunk_length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 2, 16 * 1024));
+
+  printf("%luMB bodies in %luB chunks, best of %d, MB/s are of the uncompressed body\n",
+         static_cast<unsigned long>(length / (1024 * 1024)), static_cast<unsigned long>(chunk_length), ROUNDS);
+  printf("codec   body  ratio  encode MB/s  decode MB/s  round trip\n");
+  benchmark::BodyType body_types[] = { benchmark::BODY_HTML, benchmark::BODY_JSON, benchmark::BODY_JS };
+  for (size_t i = 0; i < sizeof(body_types) / sizeof(body_types[0]); ++i) {
+    string body = benchmark::createBody(body_types[i], length);
+    compare<GzipDeflateTransformation, GzipInflateTransformation>("gzip", body_types[i], body, chunk_length);
+#ifdef ATSCPPAPI_HAVE_BROTLI
+    compare<BrotliEncodeTransformation, BrotliDecodeTransformation>("brotli", body_types[i], body, chunk_length);
+#endif
+#ifdef ATSCPPAPI_HAVE_ZSTD
+    compare<ZstdEncodeTransformation, ZstdDecodeTransformation>("zstd", body_types[i], body, chunk_length);
+#endif
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file DeflateBackendBenchmark.cc
+ *
+ * Compares the deflate backends compiled in, zlib and zlib-ng when configure found it, by running
+ * GzipDeflateTransformation and GzipInflateTransformation on HTML, JSON and minified JS bodies with each.
+ * The backend is chosen once per process, so every backend is measured in a child process started with
+ * ATSCPPAPI_DEFLATE_BACKEND set to it:
+ *
+ *   deflate_backend_benchmark [megabytes] [chunk_bytes]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "atscppapi/GzipDeflateTransformation.h"
+#include "atscppapi/GzipInflateTransformation.h"
+#include "deflate_backend_internal.h"
+#include "Benchmark.h"
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int ROUNDS = 3;
+
+const char *BACKENDS[] = {
+  "zlib",
+#ifdef ATSCPPAPI_HAVE_ZLIB_NG
+  "zlib-ng",
+#endif
+};
+
+template <typename Transformation>
+double measure(const vector<string> &chunks, string &output) {
+  double best_seconds = 1e9;
+  for (int i = 0; i < ROUNDS; ++i) {
+    benchmark::transformation_output.clear();
+    Transformation transformation(benchmark::getTransaction(), TransformationPlugin::RESPONSE_TRANSFORMATION);
+    double seconds = benchmark::runTransformation(transformation, chunks);
+    best_seconds = (seconds < best_seconds) ? seconds : best_seconds;
+  }
+  output.swap(benchmark::transformation_output);
+  return best_seconds;
+}
+
+void runBackend(const char *backend, size_t length, size_t chunk_length) {
+  if (strcmp(getDeflateBackendName(), backend) != 0) {
+    fprintf(stderr, "The %s backend was requested but %s is in use\n", backend, getDeflateBackendName());
+    return;
+  }
+
+  benchmark::BodyType body_types[] = { benchmark::BODY_HTML, benchmark::BODY_JSON, benchmark::BODY_JS };
+  for (size_t i = 0; i < sizeof(body_types) / sizeof(body_types[0]); ++i) {
+    string body = benchmark::createBody(body_types[i], length), compressed, inflated;
+    double deflate_seconds = measure<GzipDeflateTransformation>(benchmark::splitBody(body, chunk_length), compressed);
+    double inflate_seconds = measure<GzipInflateTransformation>(benchmark::splitBody(compressed, chunk_length),
+                                                                inflated);
+    double megabytes = static_cast<double>(body.length()) / (1024 * 1024);
+    printf("%-8s  %-4s  %5.3f  %12.1f  %12.1f  %10s\n", backend, benchmark::BODY_TYPE_NAMES[body_types[i]],
+           static_cast<double>(compressed.length()) / body.length(), megabytes / deflate_seconds,
+           megabytes / inflate_seconds, (inflated == body) ? "ok" : "FAILED");
+  }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 1, 10)) * 1024 * 1024;
+  size_t chunk_length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 2, 16 * 1024));
+
+  printf("%luMB bodies in %luB chunks, best of %d, MB/s are of the uncompressed body\n",
+         static_cast<unsigned long>(length / (1024 * 1024)), static_cast<unsigned long>(chunk_length), ROUNDS);
+  printf("backend   body  ratio  deflate MB/s  inflate MB/s  round trip\n");
+  fflush(stdout);
+  for (size_t i = 0; i < sizeof(BACKENDS) / sizeof(BACKENDS[0]); ++i) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      return 1;
+    }
+    if (pid == 0) {
+      setenv("ATSCPPAPI_DEFLATE_BACKEND", BACKENDS[i], 1);
+      runBackend(BACKENDS[i], length, chunk_length);
+      fflush(stdout);
+      _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file DeflateBufferBenchmark.cc
+ *
+ * Measures GzipDeflateTransformation on an HTML body passed in small chunks, counting the heap allocations
+ * it makes per chunk, and checks that GzipInflateTransformation gives back the same body:
+ *
+ *   deflate_buffer_benchmark [megabytes] [chunk_bytes]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "atscppapi/GzipDeflateTransformation.h"
+#include "atscppapi/GzipInflateTransformation.h"
+#include "Benchmark.h"
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int ROUNDS = 5;
+
+volatile uint64_t allocations = 0;
+
+}
+
+void *operator new(size_t size) {
+  ++allocations;
+  void *pointer = malloc(size ? size : 1);
+  if (!pointer) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void *pointer) throw() {
+  free(pointer);
+}
+
+int main(int argc, char *argv[]) {
+  size_t length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 1, 10)) * 1024 * 1024;
+  size_t chunk_length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 2, 4 * 1024));
+
+  string body = benchmark::createBody(benchmark::BODY_HTML, length);
+  vector<string> chunks = benchmark::splitBody(body, chunk_length);
+  Transaction &transaction = benchmark::getTransaction();
+
+  double best_seconds = 1e9;
+  uint64_t round_allocations = 0;
+  string compressed;
+  for (int i = 0; i < ROUNDS; ++i) {
+    benchmark::transformation_output.clear();
+    benchmark::transformation_output.reserve(body.length()); // so only the transformation's own allocations count.
+    GzipDeflateTransformation transformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION);
+    uint64_t before = allocations;
+    double seconds = benchmark::runTransformation(transformation, chunks);
+    round_allocations = allocations - before;
+    best_seconds = (seconds < best_seconds) ? seconds : best_seconds;
+    compressed.swap(benchmark::transformation_output);
+  }
+
+  benchmark::transformation_output.clear();
+  GzipInflateTransformation inflate(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION);
+  benchmark::runTransformation(inflate, benchmark::splitBody(compressed, 16 * 1024));
+
+  double megabytes = static_cast<double>(body.length()) / (1024 * 1024);
+  printf("gzip of %.0fMB in %lu chunks of %luB, best of %d\n", megabytes, static_cast<unsigned long>(chunks.size()),
+         static_cast<unsigned long>(chunk_length), ROUNDS);
+  printf("throughput            %10.1f MB/s\n", megabytes / best_seconds);
+  printf("allocations           %10llu\n", static_cast<unsigned long long>(round_allocations));
+  printf("allocations per chunk %10.2f\n", static_cast<double>(round_allocations) / chunks.size());
+  printf("compressed            %10lu bytes, round trip %s\n", static_cast<unsigned long>(compressed.length()),
+         (benchmark::transformation_output == body) ? "ok" : "FAILED");
+  return 0;
+}
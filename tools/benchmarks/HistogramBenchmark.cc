@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file HistogramBenchmark.cc
+ *
+ * Compares the percentiles a Histogram reports against the exact percentiles of a log-uniform sample,
+ * then measures the cost of Histogram::record() with 1 up to max_threads threads recording at once:
+ *
+ *   histogram_benchmark [max_threads] [records_per_thread]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <pthread.h>
+#include "atscppapi/Histogram.h"
+#include "Benchmark.h"
+
+using atscppapi::Histogram;
+using std::vector;
+
+namespace {
+
+const int ACCURACY_SAMPLES = 200000;
+const double PERCENTILES[] = { 50, 90, 99, 99.9 };
+
+struct Run {
+  Histogram *histogram_;
+  int records_;
+};
+
+void *runRecords(void *data) {
+  Run *run = static_cast<Run *>(data);
+  uint32_t seed = 1;
+  for (int i = 0; i < run->records_; ++i) {
+    seed = seed * 1103515245 + 12345;
+    run->histogram_->record((seed >> 8) % 100000);
+  }
+  return NULL;
+}
+
+void checkAccuracy() {
+  Histogram histogram;
+  histogram.init("benchmark.accuracy");
+  vector<int64_t> values;
+  srand(7);
+  for (int i = 0; i < ACCURACY_SAMPLES; ++i) {
+    int64_t value = static_cast<int64_t>(exp(rand() / static_cast<double>(RAND_MAX) * 14));
+    values.push_back(value);
+    histogram.record(value);
+  }
+  std::sort(values.begin(), values.end());
+
+  printf("percentile    exact  histogram  error\n");
+  for (size_t i = 0; i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]); ++i) {
+    int64_t exact = values[static_cast<size_t>(ceil(values.size() * PERCENTILES[i] / 100)) - 1];
+    int64_t reported = histogram.getPercentile(PERCENTILES[i]);
+    printf("%10g  %7lld  %9lld  %4.1f%%\n", PERCENTILES[i], static_cast<long long>(exact),
+           static_cast<long long>(reported), exact ? 100.0 * (reported - exact) / exact : 0.0);
+  }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  int max_threads = benchmark::getIntArgument(argc, argv, 1, 8);
+  int records = benchmark::getIntArgument(argc, argv, 2, 5000000);
+
+  checkAccuracy();
+
+  Histogram histogram;
+  histogram.init("benchmark.latency");
+  printf("\nthreads  ns/record\n");
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    Run run = { &histogram, records };
+    vector<pthread_t> ids(threads);
+    double begin = benchmark::getTimeSeconds();
+    for (int i = 0; i < threads; ++i) {
+      pthread_create(&ids[i], NULL, runRecords, &run);
+    }
+    for (int i = 0; i < threads; ++i) {
+      pthread_join(ids[i], NULL);
+    }
+    double elapsed = benchmark::getTimeSeconds() - begin;
+    printf("%7d  %9.2f\n", threads, elapsed / (static_cast<double>(threads) * records) * 1e9);
+  }
+  return 0;
+}
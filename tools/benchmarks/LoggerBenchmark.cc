@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file LoggerBenchmark.cc
+ *
+ * Measures the cost of Logger::logInfo() for messages of 64B up to 64KB, written synchronously into a
+ * text log stub that formats every entry into a 16KB buffer like Traffic Server does. It also reports
+ * how many entries each message took and whether every byte of it was written:
+ *
+ *   logger_benchmark [total_megabytes_per_size]
+ */
+
+#include <cstdio>
+#include <string>
+#include "atscppapi/Logger.h"
+#include "Benchmark.h"
+
+using atscppapi::Logger;
+using std::string;
+
+namespace {
+
+const char FORMAT_PREFIX[] = "[INFO] [file.cc:42, handle()] request 0: ";
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t total_bytes = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 1, 20)) * 1024 * 1024;
+
+  Logger log;
+  if (!log.init("benchmark")) {
+    fprintf(stderr, "Unable to initialize the log\n");
+    return 1;
+  }
+
+  printf("message  ns/message  entries/message  complete\n");
+  for (size_t size = 64; size <= 64 * 1024; size *= 4) {
+    string argument(size - (sizeof(FORMAT_PREFIX) - 1), 'x');
+    int messages = total_bytes / size + 1000;
+
+    benchmark::text_log_entries = 0;
+    benchmark::text_log_bytes = 0;
+    double begin = benchmark::getTimeSeconds();
+    for (int i = 0; i < messages; ++i) {
+      log.logInfo("[%s:%d, %s()] request %d: %s", "file.cc", 42, "handle", 0, argument.c_str());
+    }
+    double elapsed = benchmark::getTimeSeconds() - begin;
+
+    printf("%6luB  %10.0f  %15.1f  %8s\n", static_cast<unsigned long>(size), elapsed / messages * 1e9,
+           static_cast<double>(benchmark::text_log_entries) / messages,
+           (benchmark::text_log_bytes == static_cast<uint64_t>(size) * messages) ? "yes" : "no");
+  }
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file PipelineBenchmark.cc
+ *
+ * Rewrites hostnames and then gzips an HTML body, once with a TransformationPipeline holding both stages and
+ * once with two chained TransformationPlugins. Between chained transformations every chunk is copied into
+ * the IOBuffer of the first and read back out of it for the second, that is all the stubs charge for the
+ * hop, the continuation events Traffic Server adds per chunk and per VConn come on top of it:
+ *
+ *   pipeline_benchmark [megabytes] [chunk_bytes]
+ */
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "atscppapi/GzipDeflateTransformation.h"
+#include "atscppapi/SearchReplaceTransformation.h"
+#include "atscppapi/TransformationPipeline.h"
+#include "Benchmark.h"
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int ROUNDS = 5;
+
+shared_ptr<SearchReplacePatterns> createPatterns() {
+  std::map<string, string> replacements;
+  for (int i = 0; i < 100; ++i) {
+    char origin[32], cdn[32];
+    snprintf(origin, sizeof(origin), "origin%d.example.com", i);
+    snprintf(cdn, sizeof(cdn), "cdn%d.example.net", i);
+    replacements[origin] = cdn;
+  }
+  return shared_ptr<SearchReplacePatterns>(new SearchReplacePatterns(replacements));
+}
+
+double runPipeline(const vector<string> &chunks, const shared_ptr<SearchReplacePatterns> &patterns, string &output) {
+  Transaction &transaction = benchmark::getTransaction();
+  benchmark::transformation_output.clear();
+  TransformationPipeline pipeline(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION);
+  pipeline.addStage(new SearchReplaceTransformation(transaction, TransformationPlugin::PIPELINE_STAGE, patterns));
+  pipeline.addStage(new GzipDeflateTransformation(transaction, TransformationPlugin::PIPELINE_STAGE));
+  double seconds = benchmark::runTransformation(pipeline, chunks);
+  output.swap(benchmark::transformation_output);
+  return seconds;
+}
+
+/**
+ * Hands whatever the first transformation wrote on to the second, as the VConn between them would.
+ */
+void forward(TransformationPlugin &next, string &hop, string &output) {
+  hop.assign(benchmark::transformation_output);
+  benchmark::transformation_output.clear();
+  if (!hop.empty()) {
+    next.consume(hop);
+  }
+  output.append(benchmark::transformation_output);
+  benchmark::transformation_output.clear();
+}
+
+double runChained(const vector<string> &chunks, const shared_ptr<SearchReplacePatterns> &patterns, string &output) {
+  Transaction &transaction = benchmark::getTransaction();
+  benchmark::transformation_output.clear();
+  output.clear();
+  SearchReplaceTransformation rewrite(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION, patterns);
+  GzipDeflateTransformation compress(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION);
+  string hop;
+
+  double begin = benchmark::getTimeSeconds();
+  for (vector<string>::const_iterator iter = chunks.begin(), end = chunks.end(); iter != end; ++iter) {
+    rewrite.consume(*iter);
+    forward(compress, hop, output);
+  }
+  rewrite.handleInputComplete();
+  forward(compress, hop, output);
+  compress.handleInputComplete();
+  output.append(benchmark::transformation_output);
+  return benchmark::getTimeSeconds() - begin;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 1, 10)) * 1024 * 1024;
+  size_t chunk_length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 2, 16 * 1024));
+
+  vector<string> chunks = benchmark::splitBody(benchmark::createBody(benchmark::BODY_HTML, length), chunk_length);
+  shared_ptr<SearchReplacePatterns> patterns = createPatterns();
+  string pipeline_output, chained_output;
+  double pipeline_seconds = 1e9, chained_seconds = 1e9;
+  for (int i = 0; i < ROUNDS; ++i) {
+    double seconds = runPipeline(chunks, patterns, pipeline_output);
+    pipeline_seconds = (seconds < pipeline_seconds) ? seconds : pipeline_seconds;
+    seconds = runChained(chunks, patterns, chained_output);
+    chained_seconds = (seconds < chained_seconds) ? seconds : chained_seconds;
+  }
+
+  double megabytes = static_cast<double>(length) / (1024 * 1024);
+  printf("search/replace + gzip of %.0fMB in %luB chunks, best of %d\n", megabytes,
+         static_cast<unsigned long>(chunk_length), ROUNDS);
+  printf("pipeline  %8.1f MB/s\n", megabytes / pipeline_seconds);
+  printf("chained   %8.1f MB/s\n", megabytes / chained_seconds);
+  printf("the outputs are %s, %lu bytes\n", (pipeline_output == chained_output) ? "identical" : "DIFFERENT",
+         static_cast<unsigned long>(pipeline_output.length()));
+  return 0;
+}
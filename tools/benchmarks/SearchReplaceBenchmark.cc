@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file SearchReplaceBenchmark.cc
+ *
+ * Measures SearchReplaceTransformation on an HTML body with 1 up to 1000 hostname patterns, against buffering
+ * the whole body and replacing each pattern with a std::string::find() loop, and checks that both give the
+ * same body:
+ *
+ *   search_replace_benchmark [megabytes] [chunk_bytes]
+ */
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "atscppapi/SearchReplaceTransformation.h"
+#include "Benchmark.h"
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int PATTERN_COUNTS[] = { 1, 10, 100, 1000 };
+
+map<string, string> createReplacements(int count) {
+  map<string, string> replacements;
+  for (int i = 0; i < count; ++i) {
+    char origin[32], cdn[32];
+    snprintf(origin, sizeof(origin), "origin%d.example.com", i);
+    snprintf(cdn, sizeof(cdn), "cdn%d.example.net", i);
+    replacements[origin] = cdn;
+  }
+  return replacements;
+}
+
+string replaceWithFind(const string &body, const map<string, string> &replacements) {
+  string result(body);
+  for (map<string, string>::const_iterator iter = replacements.begin(); iter != replacements.end(); ++iter) {
+    string replaced;
+    replaced.reserve(result.length());
+    size_t start = 0, found;
+    while ((found = result.find(iter->first, start)) != string::npos) {
+      replaced.append(result, start, found - start);
+      replaced += iter->second;
+      start = found + iter->first.length();
+    }
+    replaced.append(result, start, string::npos);
+    result.swap(replaced);
+  }
+  return result;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 1, 10)) * 1024 * 1024;
+  size_t chunk_length = static_cast<size_t>(benchmark::getIntArgument(argc, argv, 2, 16 * 1024));
+
+  string body = benchmark::createBody(benchmark::BODY_HTML, length);
+  vector<string> chunks = benchmark::splitBody(body, chunk_length);
+  double megabytes = static_cast<double>(body.length()) / (1024 * 1024);
+
+  printf("%.0fMB HTML body in %luB chunks\n", megabytes, static_cast<unsigned long>(chunk_length));
+  printf("patterns  replacements  transformation MB/s  find() loop MB/s  same\n");
+  for (size_t i = 0; i < sizeof(PATTERN_COUNTS) / sizeof(PATTERN_COUNTS[0]); ++i) {
+    map<string, string> replacements = createReplacements(PATTERN_COUNTS[i]);
+    shared_ptr<SearchReplacePatterns> patterns(new SearchReplacePatterns(replacements));
+
+    benchmark::transformation_output.clear();
+    SearchReplaceTransformation transformation(benchmark::getTransaction(), TransformationPlugin::RESPONSE_TRANSFORMATION,
+                                               patterns);
+    double transformation_seconds = benchmark::runTransformation(transformation, chunks);
+
+    double begin = benchmark::getTimeSeconds();
+    string expected = replaceWithFind(body, replacements);
+    double find_seconds = benchmark::getTimeSeconds() - begin;
+
+    printf("%8d  %12lld  %19.1f  %16.1f  %4s\n", PATTERN_COUNTS[i],
+           static_cast<long long>(transformation.getReplacementCount()), megabytes / transformation_seconds,
+           megabytes / find_seconds, (benchmark::transformation_output == expected) ? "yes" : "NO");
+  }
+  return 0;
+}
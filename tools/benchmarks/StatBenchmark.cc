@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StatBenchmark.cc
+ *
+ * Measures increments per second of a SYNC_SUM Stat and of a Stat::initSharded() Stat with 1 up to
+ * max_threads threads incrementing the same Stat, and checks that no increment was lost:
+ *
+ *   stat_benchmark [max_threads] [increments_per_thread]
+ */
+
+#include <cstdio>
+#include <vector>
+#include <pthread.h>
+#include "atscppapi/Stat.h"
+#include "Benchmark.h"
+
+using atscppapi::Stat;
+using std::vector;
+
+namespace {
+
+struct Run {
+  Stat *stat_;
+  int increments_;
+  volatile bool *start_;
+};
+
+void *runIncrements(void *data) {
+  Run *run = static_cast<Run *>(data);
+  while (!*run->start_) {
+  }
+  for (int i = 0; i < run->increments_; ++i) {
+    run->stat_->increment();
+  }
+  return NULL;
+}
+
+/**
+ * @return the increments per second.
+ */
+double measure(Stat &stat, int threads, int increments) {
+  stat.set(0);
+  volatile bool start = false;
+  Run run = { &stat, increments, &start };
+  vector<pthread_t> ids(threads);
+  for (int i = 0; i < threads; ++i) {
+    pthread_create(&ids[i], NULL, runIncrements, &run);
+  }
+  double begin = benchmark::getTimeSeconds();
+  start = true;
+  for (int i = 0; i < threads; ++i) {
+    pthread_join(ids[i], NULL);
+  }
+  double elapsed = benchmark::getTimeSeconds() - begin;
+
+  int64_t expected = static_cast<int64_t>(threads) * increments;
+  if (stat.get() != expected) {
+    fprintf(stderr, "Lost increments: the stat is %lld, expected %lld\n", static_cast<long long>(stat.get()),
+            static_cast<long long>(expected));
+  }
+  return expected / elapsed;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  int max_threads = benchmark::getIntArgument(argc, argv, 1, 64);
+  int increments = benchmark::getIntArgument(argc, argv, 2, 2000000);
+
+  Stat plain;
+  Stat sharded;
+  if (!plain.init("benchmark.plain", Stat::SYNC_SUM) || !sharded.initSharded("benchmark.sharded")) {
+    fprintf(stderr, "Unable to create the stats\n");
+    return 1;
+  }
+
+  printf("threads  SYNC_SUM increments/s  initSharded increments/s\n");
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    double plain_rate = measure(plain, threads, increments);
+    double sharded_rate = measure(sharded, threads, increments);
+    printf("%7d  %19.1fM  %22.1fM\n", threads, plain_rate / 1e6, sharded_rate / 1e6);
+  }
+  return 0;
+}
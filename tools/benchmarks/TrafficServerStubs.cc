@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TrafficServerStubs.cc
+ *
+ * Just enough of the Traffic Server API for the benchmarks to run the library code outside of
+ * traffic_server. The stubs cost about what the real calls do where it matters to the numbers:
+ * a stat is a single atomic counter shared by every thread and a text log entry is formatted into
+ * a fixed 16KB buffer. Scheduled continuations never run, the benchmarks call what they need directly.
+ * Transform VConns append their output to benchmark::transformation_output, which costs the copy into
+ * the IOBuffer, and downstream never falls behind so the output watermarks are never reached.
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <pthread.h>
+#include <ts/ts.h>
+#include "Benchmark.h"
+
+namespace {
+
+const int MAX_STATS = 4096;
+const size_t TEXT_LOG_ENTRY_BYTES = 16 * 1024;
+
+volatile int64_t stat_values[MAX_STATS];
+volatile int stat_count = 0;
+
+struct StubCont {
+  TSEventFunc func_;
+  void *data_;
+};
+
+char scheduled_action;
+char output_vconn;
+char output_vio;
+char io_buffer;
+char io_buffer_reader;
+
+}
+
+volatile uint64_t benchmark::text_log_entries = 0;
+volatile uint64_t benchmark::text_log_bytes = 0;
+std::string benchmark::transformation_output;
+int benchmark::transformation_aborts = 0;
+
+void TSDebug(const char *tag, const char *fmt, ...) {
+}
+
+void TSError(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+
+int TSIsDebugTagSet(const char *t) {
+  return 0;
+}
+
+int TSStatCreate(const char *name, TSRecordDataType type, TSStatPersistence persistence, TSStatSync sync) {
+  int id = __sync_fetch_and_add(&stat_count, 1);
+  return (id < MAX_STATS) ? id : TS_ERROR;
+}
+
+void TSStatIntIncrement(int id, int64_t amount) {
+  __sync_fetch_and_add(&stat_values[id], amount);
+}
+
+void TSStatIntDecrement(int id, int64_t amount) {
+  __sync_fetch_and_sub(&stat_values[id], amount);
+}
+
+int64_t TSStatIntGet(int id) {
+  return stat_values[id];
+}
+
+void TSStatIntSet(int id, int64_t value) {
+  stat_values[id] = value;
+}
+
+TSMutex TSMutexCreate(void) {
+  return NULL;
+}
+
+TSCont TSContCreate(TSEventFunc func, TSMutex mutex) {
+  StubCont *cont = new StubCont();
+  cont->func_ = func;
+  cont->data_ = NULL;
+  return reinterpret_cast<TSCont>(cont);
+}
+
+void TSContDestroy(TSCont cont) {
+  delete reinterpret_cast<StubCont *>(cont);
+}
+
+void TSContDataSet(TSCont cont, void *data) {
+  reinterpret_cast<StubCont *>(cont)->data_ = data;
+}
+
+void *TSContDataGet(TSCont cont) {
+  return reinterpret_cast<StubCont *>(cont)->data_;
+}
+
+TSAction TSContSchedule(TSCont cont, int64_t timeout, TSThreadPool tp) {
+  return reinterpret_cast<TSAction>(&scheduled_action);
+}
+
+TSAction TSContScheduleEvery(TSCont cont, int64_t every, TSThreadPool tp) {
+  return reinterpret_cast<TSAction>(&scheduled_action);
+}
+
+void TSActionCancel(TSAction action) {
+}
+
+TSReturnCode TSTextLogObjectCreate(const char *filename, int mode, TSTextLogObject *new_log_obj) {
+  *new_log_obj = reinterpret_cast<TSTextLogObject>(&scheduled_action);
+  return TS_SUCCESS;
+}
+
+TSReturnCode TSTextLogObjectWrite(TSTextLogObject the_object, char *format, ...) {
+  char entry[TEXT_LOG_ENTRY_BYTES];
+  va_list ap;
+  va_start(ap, format);
+  int n = vsnprintf(entry, sizeof(entry), format, ap);
+  va_end(ap);
+  if (n < 0) {
+    return TS_ERROR;
+  }
+  __sync_fetch_and_add(&benchmark::text_log_entries, 1);
+  __sync_fetch_and_add(&benchmark::text_log_bytes, (static_cast<size_t>(n) < sizeof(entry)) ? n : sizeof(entry) - 1);
+  return TS_SUCCESS;
+}
+
+void TSTextLogObjectFlush(TSTextLogObject the_object) {
+}
+
+TSReturnCode TSTextLogObjectDestroy(TSTextLogObject the_object) {
+  return TS_SUCCESS;
+}
+
+void TSTextLogObjectRollingEnabledSet(TSTextLogObject the_object, int rolling_enabled) {
+}
+
+void TSTextLogObjectRollingIntervalSecSet(TSTextLogObject the_object, int rolling_interval_sec) {
+}
+
+TSThread TSThreadCreate(TSThreadFunc func, void *data) {
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, func, data) != 0) {
+    return NULL;
+  }
+  pthread_detach(thread);
+  return reinterpret_cast<TSThread>(&scheduled_action);
+}
+
+int TSContCall(TSCont contp, TSEvent event, void *edata) {
+  StubCont *cont = reinterpret_cast<StubCont *>(contp);
+  return cont->func_(contp, event, edata);
+}
+
+TSVConn TSTransformCreate(TSEventFunc event_funcp, TSHttpTxn txnp) {
+  return reinterpret_cast<TSVConn>(TSContCreate(event_funcp, NULL));
+}
+
+TSVConn TSTransformOutputVConnGet(TSVConn connp) {
+  return reinterpret_cast<TSVConn>(&output_vconn);
+}
+
+void TSHttpTxnHookAdd(TSHttpTxn txnp, TSHttpHookID id, TSCont contp) {
+}
+
+TSReturnCode TSHttpTxnServerRespNoStoreSet(TSHttpTxn txnp, int flag) {
+  return TS_SUCCESS;
+}
+
+void TSHttpTxnTransformedRespCache(TSHttpTxn txnp, int on) {
+}
+
+TSIOBuffer TSIOBufferCreate(void) {
+  return reinterpret_cast<TSIOBuffer>(&io_buffer);
+}
+
+void TSIOBufferDestroy(TSIOBuffer bufp) {
+}
+
+TSIOBufferReader TSIOBufferReaderAlloc(TSIOBuffer bufp) {
+  return reinterpret_cast<TSIOBufferReader>(&io_buffer_reader);
+}
+
+void TSIOBufferReaderFree(TSIOBufferReader readerp) {
+}
+
+int64_t TSIOBufferWrite(TSIOBuffer bufp, const void *buf, int64_t length) {
+  benchmark::transformation_output.append(static_cast<const char *>(buf), length);
+  return length;
+}
+
+int64_t TSIOBufferCopy(TSIOBuffer bufp, TSIOBufferReader readerp, int64_t length, int64_t offset) {
+  return 0;
+}
+
+int64_t TSIOBufferReaderAvail(TSIOBufferReader readerp) {
+  return 0;
+}
+
+void TSIOBufferReaderConsume(TSIOBufferReader readerp, int64_t nbytes) {
+}
+
+TSVIO TSVConnWrite(TSVConn connp, TSCont contp, TSIOBufferReader readerp, int64_t nbytes) {
+  return reinterpret_cast<TSVIO>(&output_vio);
+}
+
+TSVIO TSVConnWriteVIOGet(TSVConn connp) {
+  return NULL;
+}
+
+int TSVConnClosedGet(TSVConn connp) {
+  return 0;
+}
+
+void TSVConnShutdown(TSVConn connp, int read, int write) {
+}
+
+void TSVConnAbort(TSVConn connp, int error) {
+  ++benchmark::transformation_aborts;
+}
+
+void TSVIOReenable(TSVIO viop) {
+}
+
+TSCont TSVIOContGet(TSVIO viop) {
+  return NULL;
+}
+
+TSIOBufferReader TSVIOReaderGet(TSVIO viop) {
+  return NULL;
+}
+
+int64_t TSVIONDoneGet(TSVIO viop) {
+  return 0;
+}
+
+void TSVIONDoneSet(TSVIO viop, int64_t ndone) {
+}
+
+int64_t TSVIONTodoGet(TSVIO viop) {
+  return 0;
+}
+
+void TSVIONBytesSet(TSVIO viop, int64_t nbytes) {
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file TransactionStubs.cc
+ *
+ * The parts of Transaction, TransactionPlugin and utils::internal that TransformationPlugin uses, so the
+ * transformation benchmarks can build the real TransformationPlugin.cc without the rest of the library.
+ * There is a single Transaction and it has no Traffic Server transaction behind it.
+ */
+
+#include <string>
+#include <ts/ts.h>
+#include "atscppapi/Transaction.h"
+#include "atscppapi/TransactionPlugin.h"
+#include "utils_internal.h"
+#include "Benchmark.h"
+
+using namespace atscppapi;
+using std::string;
+
+Transaction::Transaction(void *raw_txn) : state_(NULL) {
+}
+
+Transaction::~Transaction() {
+}
+
+void *Transaction::getAtsHandle() const {
+  return NULL;
+}
+
+void Transaction::resume() {
+}
+
+void Transaction::addPlugin(TransactionPlugin *transaction_plugin) {
+}
+
+TransactionPlugin::TransactionPlugin(Transaction &transaction) : state_(NULL) {
+}
+
+TransactionPlugin::~TransactionPlugin() {
+}
+
+Transaction &utils::internal::getTransaction(TSHttpTxn ats_txn_handle) {
+  static Transaction transaction(ats_txn_handle);
+  return transaction;
+}
+
+TSHttpHookID utils::internal::convertInternalTransformationTypeToTsHook(TransformationPlugin::Type type) {
+  return (type == TransformationPlugin::REQUEST_TRANSFORMATION) ? TS_HTTP_REQUEST_TRANSFORM_HOOK :
+      TS_HTTP_RESPONSE_TRANSFORM_HOOK;
+}
+
+shared_ptr<Mutex> utils::internal::getTransactionPluginMutex(TransactionPlugin &transaction_plugin) {
+  return shared_ptr<Mutex>(new Mutex(Mutex::TYPE_RECURSIVE));
+}
+
+string utils::internal::consumeFromTSIOBufferReader(TSIOBufferReader reader) {
+  return string();
+}
+
+Transaction &benchmark::getTransaction() {
+  return utils::internal::getTransaction(NULL);
+}
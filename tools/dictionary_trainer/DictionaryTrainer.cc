@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file DictionaryTrainer.cc
+ *
+ * Builds a preset dictionary for CompressionDictionary from sample bodies, for example a few thousand
+ * captured JSON API responses with one response per file:
+ *
+ *   dictionary_trainer -o api.dict $(find samples -type f)
+ *
+ * The dictionary is made of the segments of the samples that contain the most substrings shared by
+ * many samples, which for JSON are the keys and the common values. Every tenth sample is held out of
+ * training and used to benchmark compressing each held out sample on its own with and without the
+ * dictionary. The output is raw content so it works for both deflate and zstd.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef ATSCPPAPI_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using std::map;
+using std::priority_queue;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+const size_t KMER_LENGTH = 8; // substrings shorter than this are cheap to encode without a dictionary.
+const size_t SEGMENT_LENGTH = 64;
+const size_t SEGMENT_STEP = 8;
+const size_t DEFAULT_DICTIONARY_SIZE = 16 * 1024;
+const int HOLD_OUT_EVERY = 10;
+const int BENCHMARK_ROUNDS = 50;
+
+struct Segment {
+  size_t sample_;
+  size_t offset_;
+  int64_t score_;
+  bool operator<(const Segment &other) const { return score_ < other.score_; }
+};
+
+uint64_t hashKmer(const char *data) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < KMER_LENGTH; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * The score of a segment is the number of samples containing each of its distinct k-mers that
+ * aren't already covered by the dictionary.
+ */
+int64_t scoreSegment(const string &sample, size_t offset, const map<uint64_t, int> &frequencies,
+                     const set<uint64_t> &covered) {
+  set<uint64_t> seen;
+  int64_t score = 0;
+  size_t end = std::min(sample.length(), offset + SEGMENT_LENGTH);
+  for (size_t i = offset; i + KMER_LENGTH <= end; ++i) {
+    uint64_t hash = hashKmer(sample.data() + i);
+    if (covered.count(hash) || !seen.insert(hash).second) {
+      continue;
+    }
+    map<uint64_t, int>::const_iterator iter = frequencies.find(hash);
+    if (iter != frequencies.end() && iter->second > 1) {
+      score += iter->second;
+    }
+  }
+  return score;
+}
+
+string train(const vector<string> &samples, size_t dictionary_size) {
+  map<uint64_t, int> frequencies; // the number of samples containing each k-mer.
+  for (size_t s = 0; s < samples.size(); ++s) {
+    set<uint64_t> kmers;
+    for (size_t i = 0; i + KMER_LENGTH <= samples[s].length(); ++i) {
+      kmers.insert(hashKmer(samples[s].data() + i));
+    }
+    for (set<uint64_t>::iterator iter = kmers.begin(); iter != kmers.end(); ++iter) {
+      ++frequencies[*iter];
+    }
+  }
+
+  set<uint64_t> covered;
+  priority_queue<Segment> candidates;
+  for (size_t s = 0; s < samples.size(); ++s) {
+    for (size_t offset = 0; offset + KMER_LENGTH <= samples[s].length(); offset += SEGMENT_STEP) {
+      Segment segment = { s, offset, scoreSegment(samples[s], offset, frequencies, covered) };
+      if (segment.score_ > 0) {
+        candidates.push(segment);
+      }
+    }
+  }
+
+  // Lazy greedy selection: a segment's score only drops as the dictionary grows so a segment whose
+  // rescored value still beats the next candidate is the best remaining one.
+  vector<string> chosen;
+  size_t size = 0;
+  while (!candidates.empty() && size < dictionary_size) {
+    Segment segment = candidates.top();
+    candidates.pop();
+    segment.score_ = scoreSegment(samples[segment.sample_], segment.offset_, frequencies, covered);
+    if (segment.score_ <= 0) {
+      continue;
+    }
+    if (!candidates.empty() && segment.score_ < candidates.top().score_) {
+      candidates.push(segment);
+      continue;
+    }
+
+    string content = samples[segment.sample_].substr(segment.offset_, SEGMENT_LENGTH);
+    content = content.substr(0, std::min(content.length(), dictionary_size - size));
+    for (size_t i = 0; i + KMER_LENGTH <= content.length(); ++i) {
+      covered.insert(hashKmer(content.data() + i));
+    }
+    chosen.push_back(content);
+    size += content.length();
+  }
+
+  // Matches close to the end of the dictionary are the cheapest to encode so the best segments go last.
+  string dictionary;
+  for (vector<string>::reverse_iterator iter = chosen.rbegin(); iter != chosen.rend(); ++iter) {
+    dictionary.append(*iter);
+  }
+  return dictionary;
+}
+
+double getTimeSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Compresses sample on its own, in the gzip format without a dictionary and in the zlib format with one.
+ * @return the compressed size or 0 on error.
+ */
+size_t deflateSample(const string &sample, const string &dictionary, int level, string &output) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  int window_bits = dictionary.empty() ? 15 + 16 : 15;
+  if (deflateInit2(&stream, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return 0;
+  }
+  if (!dictionary.empty()) {
+    deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dictionary.data()), dictionary.length());
+  }
+  output.resize(deflateBound(&stream, sample.length()) + 32);
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(sample.data()));
+  stream.avail_in = sample.length();
+  stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+  stream.avail_out = output.length();
+  int err = deflate(&stream, Z_FINISH);
+  size_t length = stream.total_out;
+  deflateEnd(&stream);
+  return (err == Z_STREAM_END) ? length : 0;
+}
+
+bool inflateSample(const string &compressed, const string &dictionary, const string &expected) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+    return false;
+  }
+  string output(expected.length() + 1, '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+  stream.avail_in = compressed.length();
+  stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+  stream.avail_out = output.length();
+  int err = inflate(&stream, Z_FINISH);
+  if (err == Z_NEED_DICT) {
+    inflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dictionary.data()), dictionary.length());
+    err = inflate(&stream, Z_FINISH);
+  }
+  size_t length = stream.total_out;
+  inflateEnd(&stream);
+  return err == Z_STREAM_END && output.compare(0, length, expected) == 0 && length == expected.length();
+}
+
+void report(const char *name, size_t input_bytes, size_t output_bytes, double seconds) {
+  printf("  %-24s %10zu bytes  ratio %.3f  %8.1f MB/s\n", name, output_bytes,
+         input_bytes ? static_cast<double>(output_bytes) / input_bytes : 0.0,
+         seconds > 0 ? input_bytes * BENCHMARK_ROUNDS / seconds / (1024 * 1024) : 0.0);
+}
+
+void benchmarkDeflate(const vector<string> &samples, const string &dictionary, int level, size_t input_bytes) {
+  const char *names[] = { "gzip", "deflate+dictionary" };
+  const string no_dictionary;
+  string output;
+  for (int with_dictionary = 0; with_dictionary <= 1; ++with_dictionary) {
+    const string &dict = with_dictionary ? dictionary : no_dictionary;
+    size_t output_bytes = 0;
+    bool ok = true;
+    for (size_t i = 0; i < samples.size(); ++i) {
+      size_t length = deflateSample(samples[i], dict, level, output);
+      output.resize(length);
+      output_bytes += length;
+      ok = ok && inflateSample(output, dict, samples[i]);
+    }
+    double start = getTimeSeconds();
+    for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+      for (size_t i = 0; i < samples.size(); ++i) {
+        deflateSample(samples[i], dict, level, output);
+      }
+    }
+    report(names[with_dictionary], input_bytes, output_bytes, getTimeSeconds() - start);
+    if (!ok) {
+      printf("  %s round trip FAILED\n", names[with_dictionary]);
+    }
+  }
+}
+
+#ifdef ATSCPPAPI_HAVE_ZSTD
+void benchmarkZstd(const vector<string> &samples, const string &dictionary, size_t input_bytes) {
+  const char *names[] = { "zstd", "zstd+dictionary" };
+  const int level = 3;
+  ZSTD_CCtx *cctx = ZSTD_createCCtx();
+  ZSTD_CDict *cdict = ZSTD_createCDict(dictionary.data(), dictionary.length(), level);
+  string output;
+  for (int with_dictionary = 0; with_dictionary <= 1; ++with_dictionary) {
+    size_t output_bytes = 0;
+    double start = 0;
+    for (int round = 0; round <= BENCHMARK_ROUNDS; ++round) {
+      if (round == 1) {
+        start = getTimeSeconds();
+      }
+      for (size_t i = 0; i < samples.size(); ++i) {
+        output.resize(ZSTD_compressBound(samples[i].length()));
+        size_t length = with_dictionary ?
+          ZSTD_compress_usingCDict(cctx, &output[0], output.length(), samples[i].data(), samples[i].length(), cdict) :
+          ZSTD_compressCCtx(cctx, &output[0], output.length(), samples[i].data(), samples[i].length(), level);
+        if (round == 0 && !ZSTD_isError(length)) {
+          output_bytes += length;
+        }
+      }
+    }
+    report(names[with_dictionary], input_bytes, output_bytes, getTimeSeconds() - start);
+  }
+  ZSTD_freeCDict(cdict);
+  ZSTD_freeCCtx(cctx);
+}
+#endif
+
+bool readFile(const char *path, string &data) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  data = contents.str();
+  return !file.bad();
+}
+
+void usage(const char *program) {
+  fprintf(stderr, "usage: %s [-s dictionary_size] [-l level] -o dictionary_file sample_file...\n", program);
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t dictionary_size = DEFAULT_DICTIONARY_SIZE;
+  int level = 6;
+  const char *output_path = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:l:o:h")) != -1) {
+    switch (opt) {
+    case 's':
+      dictionary_size = strtoul(optarg, NULL, 10);
+      break;
+    case 'l':
+      level = atoi(optarg);
+      break;
+    case 'o':
+      output_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!output_path || optind >= argc || dictionary_size == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  vector<string> training;
+  vector<string> held_out;
+  size_t held_out_bytes = 0;
+  for (int i = optind; i < argc; ++i) {
+    string sample;
+    if (!readFile(argv[i], sample)) {
+      fprintf(stderr, "Unable to read sample '%s'\n", argv[i]);
+      return 1;
+    }
+    if ((i - optind) % HOLD_OUT_EVERY == HOLD_OUT_EVERY - 1) {
+      held_out.push_back(sample);
+      held_out_bytes += sample.length();
+    } else {
+      training.push_back(sample);
+    }
+  }
+
+  double start = getTimeSeconds();
+  string dictionary = train(training, dictionary_size);
+  printf("Trained a %zu byte dictionary from %zu samples in %.2fs\n", dictionary.length(), training.size(),
+         getTimeSeconds() - start);
+
+  std::ofstream output(output_path, std::ios::out | std::ios::binary | std::ios::trunc);
+  output.write(dictionary.data(), dictionary.length());
+  if (!output) {
+    fprintf(stderr, "Unable to write dictionary '%s'\n", output_path);
+    return 1;
+  }
+
+  if (held_out.empty()) {
+    printf("Not enough samples to benchmark, at least %d are needed\n", HOLD_OUT_EVERY);
+    return 0;
+  }
+  printf("Compressing %zu held out samples (%zu bytes) one at a time, level %d:\n", held_out.size(),
+         held_out_bytes, level);
+  benchmarkDeflate(held_out, dictionary, level, held_out_bytes);
+#ifdef ATSCPPAPI_HAVE_ZSTD
+  benchmarkZstd(held_out, dictionary, held_out_bytes);
+#endif
+  return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StructuredLogDecoder.cc
+ *
+ * Turns the binary files written by atscppapi::StructuredLogger back into text, one line per event
+ * prefixed with its UTC timestamp:
+ *
+ *   structured_log_decoder requests.bin > requests.log
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+#include "structured_log_internal.h"
+
+using namespace atscppapi::structured_log;
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+/**
+ * Formats one conversion with the value read from the record.
+ * @return false if the record ended early.
+ */
+bool formatArgument(const FormatPiece &piece, const char *&data, const char *end, string &line) {
+  char output[512];
+  int n = 0;
+  uint64_t value = 0;
+  if (piece.type_ == ARG_DOUBLE) {
+    double number;
+    if (end - data < static_cast<ptrdiff_t>(sizeof(number))) {
+      return false;
+    }
+    memcpy(&number, data, sizeof(number));
+    data += sizeof(number);
+    n = snprintf(output, sizeof(output), piece.text_.c_str(), number);
+  } else if (!decodeVarint(data, end, value)) {
+    return false;
+  } else if (piece.type_ == ARG_STRING) {
+    if (static_cast<uint64_t>(end - data) < value) {
+      return false;
+    }
+    string text(data, value);
+    data += value;
+    vector<char> formatted(text.length() + 512);
+    n = snprintf(&formatted[0], formatted.size(), piece.text_.c_str(), text.c_str());
+    line.append(&formatted[0], (n < 0) ? 0 : std::min(static_cast<size_t>(n), formatted.size() - 1));
+    return true;
+  } else {
+    int64_t number = zigzagDecode(value);
+    switch (piece.type_) {
+    case ARG_INT:
+      n = snprintf(output, sizeof(output), piece.text_.c_str(), static_cast<int>(number));
+      break;
+    case ARG_LONG:
+      n = snprintf(output, sizeof(output), piece.text_.c_str(), static_cast<long>(number));
+      break;
+    case ARG_LONG_LONG:
+      n = snprintf(output, sizeof(output), piece.text_.c_str(), static_cast<long long>(number));
+      break;
+    case ARG_UNSIGNED:
+      n = snprintf(output, sizeof(output), piece.text_.c_str(), static_cast<unsigned int>(value));
+      break;
+    case ARG_UNSIGNED_LONG:
+      n = snprintf(output, sizeof(output), piece.text_.c_str(), static_cast<unsigned long>(value));
+      break;
+    case ARG_UNSIGNED_LONG_LONG:
+      n = snprintf(output, sizeof(output), piece.text_.c_str(), static_cast<unsigned long long>(value));
+      break;
+    case ARG_SIZE:
+      n = snprintf(output, sizeof(output), piece.text_.c_str(), static_cast<size_t>(value));
+      break;
+    case ARG_POINTER:
+      n = snprintf(output, sizeof(output), piece.text_.c_str(), reinterpret_cast<void *>(value));
+      break;
+    default:
+      break;
+    }
+  }
+  line.append(output, (n < 0) ? 0 : std::min(static_cast<size_t>(n), sizeof(output) - 1));
+  return true;
+}
+
+void appendTimestamp(uint64_t timestamp_us, string &line) {
+  time_t seconds = timestamp_us / 1000000;
+  struct tm tm;
+  gmtime_r(&seconds, &tm);
+  char output[64];
+  size_t length = strftime(output, sizeof(output), "%Y-%m-%dT%H:%M:%S", &tm);
+  snprintf(output + length, sizeof(output) - length, ".%06uZ ", static_cast<unsigned>(timestamp_us % 1000000));
+  line.append(output);
+}
+
+int decode(const string &contents, FILE *out) {
+  if (contents.compare(0, STRUCTURED_LOG_MAGIC_LENGTH, STRUCTURED_LOG_MAGIC) != 0) {
+    fprintf(stderr, "Not a structured log file\n");
+    return 1;
+  }
+
+  map<uint64_t, vector<FormatPiece> > formats;
+  const char *data = contents.data();
+  const char *end = data + contents.length();
+  string line;
+  while (data < end) {
+    const char *record = data;
+    unsigned char tag = static_cast<unsigned char>(*data++);
+    uint64_t id, value;
+    if (tag == STRUCTURED_LOG_MAGIC[0] && static_cast<size_t>(end - record) >= STRUCTURED_LOG_MAGIC_LENGTH &&
+        memcmp(record, STRUCTURED_LOG_MAGIC, STRUCTURED_LOG_MAGIC_LENGTH) == 0) {
+      // The file was appended to by another run, its format ids start over.
+      formats.clear();
+      data = record + STRUCTURED_LOG_MAGIC_LENGTH;
+    } else if (tag == RECORD_FORMAT && decodeVarint(data, end, id) && decodeVarint(data, end, value) &&
+               static_cast<uint64_t>(end - data) >= value) {
+      if (!parseFormat(string(data, value), formats[id])) {
+        fprintf(stderr, "Unsupported format %llu at offset %ld\n", static_cast<unsigned long long>(id),
+                static_cast<long>(record - contents.data()));
+        return 1;
+      }
+      data += value;
+    } else if (tag == RECORD_EVENT && decodeVarint(data, end, id) && decodeVarint(data, end, value)) {
+      map<uint64_t, vector<FormatPiece> >::const_iterator format = formats.find(id);
+      if (format == formats.end()) {
+        fprintf(stderr, "Unknown format %llu at offset %ld\n", static_cast<unsigned long long>(id),
+                static_cast<long>(record - contents.data()));
+        return 1;
+      }
+      line.clear();
+      appendTimestamp(value, line);
+      for (vector<FormatPiece>::const_iterator piece = format->second.begin(); piece != format->second.end();
+           ++piece) {
+        if (piece->literal_) {
+          line.append(piece->text_);
+        } else if (!formatArgument(*piece, data, end, line)) {
+          fprintf(stderr, "Truncated record at offset %ld\n", static_cast<long>(record - contents.data()));
+          return 1;
+        }
+      }
+      line += '\n';
+      fwrite(line.data(), 1, line.length(), out);
+    } else {
+      fprintf(stderr, "Corrupt record at offset %ld\n", static_cast<long>(record - contents.data()));
+      return 1;
+    }
+  }
+  return 0;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s structured_log_file\n", argv[0]);
+    return 1;
+  }
+
+  std::ifstream file(argv[1], std::ios::in | std::ios::binary);
+  if (!file) {
+    fprintf(stderr, "Unable to open '%s'\n", argv[1]);
+    return 1;
+  }
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return decode(contents.str(), stdout);
+}